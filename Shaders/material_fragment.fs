@@ -18,9 +18,12 @@ in VS_OUT {
 in vec3 Normal;
 in vec3 FragPos;
 
-// Light and camera positions in world space
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+// Camera matrices and position, shared with the vertex shader (FrameBlock in util/UniformBlocks.h)
+layout (std140) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;       // Camera position in world space
+};
 
 // Spotlight structure definition
 struct SpotLight {
@@ -35,7 +38,10 @@ struct SpotLight {
     float linear;       // Linear distance attenuation factor
     float quadratic;    // Quadratic distance attenuation factor
 };
-uniform SpotLight spotLight;
+// Written once per frame (SpotLightBlock in util/UniformBlocks.h)
+layout (std140) uniform LightBlock {
+    SpotLight spotLight;
+};
 
 // Material properties structure
 struct Material {
@@ -44,7 +50,10 @@ struct Material {
     vec3 specular;      // Specular reflection color
     float shininess;    // Shininess exponent (higher = more focused highlights)
 };
-uniform Material material;
+// Rebound for every material (MaterialBlock in util/UniformBlocks.h)
+layout (std140) uniform MaterialBlock {
+    Material material;
+};
 
 // Function to calculate spotlight contribution using Phong lighting model
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -17,12 +17,14 @@ out VS_OUT {
 out vec3 Normal;
 out vec3 FragPos; 
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 uniform mat4 model;
 
 uniform vec3 lightPos;
-uniform vec3 viewPos;
 
 void main()
 {
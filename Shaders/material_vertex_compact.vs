@@ -0,0 +1,63 @@
+#version 330 core
+// same as material_vertex.vs, but for meshes uploaded with VertexLayout::Compact
+layout (location = 0) in vec4 aPos;      // xyz position, w bitangent sign
+layout (location = 1) in vec2 aNormal;   // octahedral encoded
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec2 aTangent;  // octahedral encoded
+
+
+out VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    vec3 TangentLightPos;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+} vs_out;
+
+out vec3 Normal;
+out vec3 FragPos;
+
+layout (std140) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+uniform mat4 model;
+
+uniform vec3 lightPos;
+
+// inverse of VertexPacking::octahedralEncode
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    vec3 position = aPos.xyz;
+    vec3 normal = octahedralDecode(aNormal);
+    vec3 tangent = octahedralDecode(aTangent);
+
+    vs_out.FragPos = vec3(model * vec4(position, 1.0));
+    vs_out.TexCoords = aTexCoords;
+
+    mat3 normalMatrix = transpose(inverse(mat3(model)));
+    vec3 T = normalize(normalMatrix * tangent);
+    vec3 N = normalize(normalMatrix * normal);
+    T = normalize(T - dot(T, N) * N);
+    vec3 B = cross(N, T) * aPos.w;
+
+    mat3 TBN = transpose(mat3(T, B, N));
+    vs_out.TangentLightPos = TBN * lightPos;
+    vs_out.TangentViewPos  = TBN * viewPos;
+    vs_out.TangentFragPos  = TBN * vs_out.FragPos;
+
+    Normal = mat3(transpose(inverse(model))) * normal;
+    FragPos = vec3(model * vec4(position, 1.0));
+
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
@@ -0,0 +1,51 @@
+#version 330 core
+// same as material_vertex.vs, but the model matrix comes per instance (Model::DrawInstanced)
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+layout (location = 7) in mat4 aInstanceModel; // INSTANCE_MATRIX_LOCATION, takes 7 to 10
+
+
+out VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    vec3 TangentLightPos;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+} vs_out;
+
+out vec3 Normal;
+out vec3 FragPos; 
+
+layout (std140) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+uniform vec3 lightPos;
+
+void main()
+{
+    mat4 model = aInstanceModel;
+    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));   
+    vs_out.TexCoords = aTexCoords;
+    
+    mat3 normalMatrix = transpose(inverse(mat3(model)));
+    vec3 T = normalize(normalMatrix * aTangent);
+    vec3 N = normalize(normalMatrix * aNormal);
+    T = normalize(T - dot(T, N) * N);
+    vec3 B = cross(N, T);
+    
+    mat3 TBN = transpose(mat3(T, B, N));    
+    vs_out.TangentLightPos = TBN * lightPos;
+    vs_out.TangentViewPos  = TBN * viewPos;
+    vs_out.TangentFragPos  = TBN * vs_out.FragPos;
+    
+    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    FragPos = vec3(model * vec4(aPos, 1.0));
+
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+// Minimp3 header-only library for MP3 support
+#define MINIMP3_IMPLEMENTATION
+#include "minimp3.h"
+#include "AudioDecoder.h"
+#include "BeatTracker.h"
+
+// runs a track through the same onset detector and beat tracker MusicPlayer uses while
+// playing and prints tempo, beats and speed. Given a label file (one beat per line, time
+// in seconds in the first column, as most beat datasets ship them) it also prints
+// precision, recall and F-measure with the usual +-70 ms tolerance
+// build: g++ -O2 beat_eval.cpp -I../util -o beat_eval -lsndfile
+// usage: ./beat_eval track [labels.txt] [--rate framesPerSecond]
+
+// every labeled beat can be matched by one detected beat at most
+static size_t matchBeats(const std::vector<double> &detected, const std::vector<double> &labels, double tolerance)
+{
+    size_t matched = 0, d = 0;
+    for (double label : labels)
+    {
+        while (d < detected.size() && detected[d] < label - tolerance)
+            d++;
+        if (d < detected.size() && detected[d] <= label + tolerance)
+        {
+            matched++;
+            d++;
+        }
+    }
+    return matched;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string trackPath, labelPath;
+    double rate = 100.0;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--rate" && i + 1 < argc)
+            rate = std::atof(argv[++i]);
+        else if (trackPath.empty())
+            trackPath = argument;
+        else
+            labelPath = argument;
+    }
+    if (trackPath.empty())
+    {
+        std::cout << "usage: " << argv[0] << " track [labels.txt] [--rate framesPerSecond]" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<AudioDecoder> decoder = openAudioDecoder(trackPath);
+    if (!decoder)
+        return 1;
+    int sampleRate = decoder->getSampleRate();
+    std::vector<float> mono;
+    decodeMono(*decoder, mono);
+    double duration = (double)mono.size() / sampleRate;
+
+    auto begin = std::chrono::steady_clock::now();
+    BeatAnalysis analysis = BeatTracker::analyzeTrack(mono.data(), mono.size(), sampleRate, rate);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << trackPath << ": " << std::fixed << std::setprecision(1) << analysis.bpm << " BPM, "
+              << analysis.beats.size() << " beats, " << analysis.onsets.size() << " onsets in "
+              << std::setprecision(1) << duration << " s, analyzed in " << std::setprecision(3) << seconds
+              << " s (" << std::setprecision(0) << duration / seconds << "x real time)" << std::endl;
+
+    if (labelPath.empty())
+    {
+        for (double beat : analysis.beats)
+            std::cout << std::setprecision(3) << beat << std::endl;
+        return 0;
+    }
+
+    std::ifstream labelFile(labelPath);
+    if (!labelFile.is_open())
+    {
+        std::cerr << "Error: Could not open label file: " << labelPath << std::endl;
+        return 1;
+    }
+    std::vector<double> labels;
+    std::string line;
+    while (std::getline(labelFile, line))
+    {
+        std::istringstream fields(line);
+        double time;
+        if (fields >> time)
+            labels.push_back(time);
+    }
+    std::sort(labels.begin(), labels.end());
+
+    size_t matched = matchBeats(analysis.beats, labels, 0.07);
+    double precision = analysis.beats.empty() ? 0.0 : (double)matched / analysis.beats.size();
+    double recall = labels.empty() ? 0.0 : (double)matched / labels.size();
+    double fMeasure = precision + recall > 0.0 ? 2.0 * precision * recall / (precision + recall) : 0.0;
+    std::cout << labels.size() << " labeled beats, " << matched << " matched within 70 ms: precision "
+              << std::setprecision(3) << precision << ", recall " << recall << ", F-measure " << fMeasure << std::endl;
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <cmath>
+#include <complex>
+#include <random>
+#include "SimpleFFT.h"
+
+// times the old recursive SimpleFFT::fft against the planned iterative FFTPlan
+// (double and float) and the real input RealFFTPlan<float> from 512 to 1M points,
+// and checks they give the same spectrum
+// build: g++ -O2 fft_benchmark.cpp -I../util -o fft_benchmark
+
+// the recursive version SimpleFFT::fft used to be, kept here as the reference
+void recursiveFFT(std::vector<std::complex<double>>& data) {
+    int n = data.size();
+    if (n <= 1) return;
+
+    std::vector<std::complex<double>> even, odd;
+    for (int i = 0; i < n; i++) {
+        if (i % 2 == 0) even.push_back(data[i]);
+        else odd.push_back(data[i]);
+    }
+
+    recursiveFFT(even);
+    recursiveFFT(odd);
+
+    for (int i = 0; i < n/2; i++) {
+        std::complex<double> t = std::polar(1.0, -2 * M_PI * i / n) * odd[i];
+        data[i] = even[i] + t;
+        data[i + n/2] = even[i] - t;
+    }
+}
+
+// average milliseconds of one call of transform on a fresh copy of input
+template <typename Data, typename Transform>
+double timeTransform(const Data& input, int repeats, Transform transform, Data& output) {
+    double total = 0.0;
+    for (int r = 0; r < repeats; r++) {
+        output = input;
+        auto start = std::chrono::high_resolution_clock::now();
+        transform(output);
+        auto end = std::chrono::high_resolution_clock::now();
+        total += std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    return total / repeats;
+}
+
+int main() {
+    std::cout << "float kernels: " << AudioSimd::kernels().name << std::endl;
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> sample(-1.0, 1.0);
+
+    std::cout << std::setw(9) << "size" << std::setw(14) << "recursive ms" << std::setw(14) << "plan<double>"
+              << std::setw(14) << "plan<float>" << std::setw(14) << "real<float>" << std::setw(10) << "speedup"
+              << std::setw(14) << "max error" << std::setw(14) << "real error" << std::endl;
+
+    for (size_t n = 512; n <= (1 << 20); n *= 2) {
+        std::vector<std::complex<double>> input(n);
+        std::vector<std::complex<float>> inputFloat(n);
+        std::vector<float> inputReal(n);
+        for (size_t i = 0; i < n; i++) {
+            input[i] = std::complex<double>(sample(random), 0.0);
+            inputFloat[i] = std::complex<float>((float)input[i].real(), 0.0f);
+            inputReal[i] = (float)input[i].real();
+        }
+        // about the same amount of work for every size
+        int repeats = std::max(3, (int)((1 << 22) / n));
+
+        std::vector<std::complex<double>> reference, planned;
+        std::vector<std::complex<float>> plannedFloat;
+        double recursiveMs = timeTransform(input, repeats, recursiveFFT, reference);
+
+        // building the plan is paid once, not per transform
+        FFTPlanDouble plan(n);
+        FFTPlanFloat planFloat(n);
+        RealFFTPlanFloat planReal(n);
+        std::vector<std::complex<float>> realBins(planReal.bins());
+        double planMs = timeTransform(input, repeats, [&](std::vector<std::complex<double>>& data) { plan.forward(data); }, planned);
+        double planFloatMs = timeTransform(inputFloat, repeats, [&](std::vector<std::complex<float>>& data) { planFloat.forward(data); }, plannedFloat);
+        std::vector<float> unusedReal;
+        double realMs = timeTransform(inputReal, repeats, [&](std::vector<float>& data) { planReal.forward(data.data(), realBins.data()); }, unusedReal);
+
+        double maxError = 0.0;
+        for (size_t i = 0; i < n; i++) maxError = std::max(maxError, std::abs(reference[i] - planned[i]));
+        // float precision, so relative to the biggest bin
+        double realError = 0.0, largest = 0.0;
+        for (size_t i = 0; i < planReal.bins(); i++) {
+            std::complex<double> bin(realBins[i].real(), realBins[i].imag());
+            realError = std::max(realError, std::abs(reference[i] - bin));
+            largest = std::max(largest, std::abs(reference[i]));
+        }
+        realError /= largest;
+
+        std::cout << std::setw(9) << n << std::fixed << std::setprecision(4)
+                  << std::setw(14) << recursiveMs << std::setw(14) << planMs << std::setw(14) << planFloatMs << std::setw(14) << realMs
+                  << std::setw(9) << std::setprecision(1) << recursiveMs / planMs << "x"
+                  << std::setw(14) << std::scientific << std::setprecision(2) << maxError << std::setw(14) << realError << std::defaultfloat << std::endl;
+    }
+    return 0;
+}
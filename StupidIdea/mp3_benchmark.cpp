@@ -0,0 +1,96 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <random>
+
+// Minimp3 header-only library for MP3 support
+#define MINIMP3_IMPLEMENTATION
+#include "minimp3.h"
+#include "AudioDecoder.h"
+
+// times the frame index scan, a sequential decode, the parallel chunk decode and
+// random seeks through Mp3StreamDecoder on MP3 files, and checks that the parallel
+// decode and every seek give exactly the samples of the sequential decode.
+// Pass an MPEG-1 file and an MPEG-2/2.5 (LSF, 24 kHz and below) one: LSF frames hold
+// a single granule and need more warm-up, e.g. lame --resample 22.05 -b 64 song.wav lsf.mp3
+// build: g++ -O2 mp3_benchmark.cpp -I../util -o mp3_benchmark -lsndfile -lpthread
+// usage: ./mp3_benchmark song.mp3 [lsf.mp3 ...], exits with 1 if any file differs
+
+template <typename Work>
+double milliseconds(Work work)
+{
+    auto begin = std::chrono::steady_clock::now();
+    work();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// prints the timings of one file, false if a decode differed or it could not be read
+bool benchmark(const char *path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    Mp3FrameIndex index;
+    bool found = false;
+    double scanMs = milliseconds([&]
+                                 { found = index.build(data.data(), data.size()); });
+    if (!found)
+    {
+        std::cerr << "Error: No audio data decoded from MP3 file " << path << std::endl;
+        return false;
+    }
+    int channels = index.getChannels();
+    double seconds = (double)index.getTotalSamples() / index.getSampleRate();
+
+    std::vector<short> sequential(index.getTotalSamples() * channels);
+    double sequentialMs = milliseconds([&]
+                                       { index.decodeRange(data.data(), 0, index.getFrameCount(), sequential.data()); });
+    std::vector<short> parallel;
+    double parallelMs = milliseconds([&]
+                                     { index.decodeParallel(data.data(), parallel); });
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << path << ": " << index.getFrameCount() << " frames of " << index.getSamplesPerFrame() << " samples, "
+              << seconds << " s at " << index.getSampleRate() << " Hz" << std::endl;
+    std::cout << "index scan:        " << std::setw(9) << scanMs << " ms" << std::endl;
+    std::cout << "sequential decode: " << std::setw(9) << sequentialMs << " ms" << std::endl;
+    std::cout << "parallel decode:   " << std::setw(9) << parallelMs << " ms on " << ThreadPool::shared().size()
+              << " threads (" << (parallel == sequential ? "identical" : "DIFFERENT") << ")" << std::endl;
+
+    Mp3StreamDecoder decoder;
+    if (!decoder.open(path))
+        return false;
+    std::mt19937 random(1);
+    const size_t readFrames = 4096;
+    std::vector<short> block(readFrames * channels);
+    int seeks = 200, wrong = 0;
+    double seekMs = milliseconds([&]
+                                 {
+                                     for (int i = 0; i < seeks; i++)
+                                     {
+                                         size_t position = random() % decoder.getTotalFrames();
+                                         size_t got = decoder.seek(position) ? decoder.read(block.data(), readFrames) : 0;
+                                         size_t expected = std::min(readFrames, decoder.getTotalFrames() - position);
+                                         if (got != expected || !std::equal(block.begin(), block.begin() + got * channels,
+                                                                            sequential.begin() + position * channels))
+                                             wrong++;
+                                     } });
+    std::cout << "seek + read " << readFrames << ": " << std::setw(7) << seekMs / seeks << " ms, "
+              << wrong << " of " << seeks << " wrong" << std::endl;
+    return parallel == sequential && wrong == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: " << argv[0] << " song.mp3 [lsf.mp3 ...]" << std::endl;
+        return 1;
+    }
+    bool identical = true;
+    for (int i = 1; i < argc; i++)
+        identical = benchmark(argv[i]) && identical;
+    return identical ? 0 : 1;
+}
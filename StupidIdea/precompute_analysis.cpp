@@ -0,0 +1,101 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+
+// Minimp3 header-only library for MP3 support
+#define MINIMP3_IMPLEMENTATION
+#include "minimp3.h"
+#include "AnalysisCache.h"
+
+// writes the analysis sidecar (<file>.analysis) of every file given, on all cores,
+// with the settings MusicPlayer uses by default (2048 point Hann frames, 60 hops/s,
+// 10 log spaced bands from 20 Hz to 20 kHz)
+// build: g++ -O2 precompute_analysis.cpp -I../util -o precompute_analysis -lsndfile -lpthread
+// usage: ./precompute_analysis [--rate hopsPerSecond] [--frame size] [--blackman]
+//                              [--bands linear|log|third|mel] [--count bands] [--range minHz maxHz] files...
+int main(int argc, char *argv[])
+{
+    double rate = 60.0;
+    size_t frameSize = 2048;
+    WindowFunction window = WindowFunction::Hann;
+    FilterbankConfig bands;
+
+    int analyzed = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--rate" && i + 1 < argc)
+        {
+            rate = std::atof(argv[++i]);
+            continue;
+        }
+        if (argument == "--frame" && i + 1 < argc)
+        {
+            frameSize = (size_t)std::atol(argv[++i]);
+            continue;
+        }
+        if (argument == "--blackman")
+        {
+            window = WindowFunction::Blackman;
+            continue;
+        }
+        if (argument == "--bands" && i + 1 < argc)
+        {
+            std::string scale = argv[++i];
+            bands.scale = scale == "linear" ? BandScale::Linear : scale == "third" ? BandScale::ThirdOctave
+                                                              : scale == "mel"     ? BandScale::Mel
+                                                                                   : BandScale::Logarithmic;
+            continue;
+        }
+        if (argument == "--count" && i + 1 < argc)
+        {
+            bands.bandCount = std::atoi(argv[++i]);
+            continue;
+        }
+        if (argument == "--range" && i + 2 < argc)
+        {
+            bands.minHz = std::atof(argv[++i]);
+            bands.maxHz = std::atof(argv[++i]);
+            continue;
+        }
+
+        std::unique_ptr<AudioDecoder> decoder = openAudioDecoder(argument);
+        if (!decoder)
+            continue;
+        int sampleRate = decoder->getSampleRate();
+        decoder.reset();
+        size_t hop = StftAnalyzer::hopForRate(sampleRate, rate);
+
+        auto begin = std::chrono::steady_clock::now();
+        if (!AnalysisCache::build(argument, frameSize, hop, window, bands))
+        {
+            std::cerr << "ERROR::ANALYSIS_CACHE:: could not analyze " << argument << std::endl;
+            continue;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        AnalysisCache cache;
+        if (!cache.open(argument, frameSize, hop, window, bands))
+        {
+            std::cerr << "ERROR::ANALYSIS_CACHE:: could not read back " << AnalysisCache::getCachePath(argument) << std::endl;
+            continue;
+        }
+        double duration = (double)cache.getFrameCount() * hop / sampleRate;
+        std::cout << argument << ": " << cache.getFrameCount() << " hops of " << hop << " samples, "
+                  << cache.getBandCount() << " bands, "
+                  << std::fixed << std::setprecision(2) << seconds << " s for " << duration << " s of audio ("
+                  << std::setprecision(0) << duration / seconds << "x real time, "
+                  << ThreadPool::shared().size() << " threads)" << std::endl;
+        analyzed++;
+    }
+
+    if (analyzed == 0)
+    {
+        std::cout << "usage: " << argv[0] << " [--rate hopsPerSecond] [--frame size] [--blackman]"
+                  << " [--bands linear|log|third|mel] [--count bands] [--range minHz maxHz] files..." << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -46,6 +46,9 @@ int main(int argc, char* argv[]) {
         return -1;
     }
     
+    // decode while playing, the whole track is never in memory
+    player.setStreaming(true);
+
     if (!player.loadMusic(musicFile)) {
         std::cerr << "Failed to load music file: " << musicFile << std::endl;
         return -1;
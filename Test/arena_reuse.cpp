@@ -0,0 +1,117 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+
+// custom utils
+#include "../util/RenderContext.h"
+#include "../util/Filesystem.h"
+#include "../util/Mesh.h"
+#include "../util/Model.h"
+#include "../util/GeometryArena.h"
+
+// checks that GeometryArena hands freed ranges out again: meshes are allocated,
+// freed and allocated again without the buffers growing, and a Model loaded with
+// useArena gives all of its meshes' ranges back when it goes out of scope, so
+// loading it over and over keeps the shared arena the same size.
+// Exits with 1 when a check fails. Runs headless as well:
+//   ./arena_reuse --headless egl
+// -------------------------------------------------------------------------------------
+
+static int failures = 0;
+
+void check(bool condition, const char *what)
+{
+    std::cout << (condition ? "  ok    " : "  FAIL  ") << what << std::endl;
+    if (!condition)
+        failures++;
+}
+
+// a flat grid of side x side quads, (side + 1)^2 vertices and 6 indices per quad
+Mesh makeGrid(int side, GeometryArena &arena)
+{
+    std::vector<Vertex> vertices((side + 1) * (side + 1));
+    for (int y = 0; y <= side; y++)
+    {
+        for (int x = 0; x <= side; x++)
+        {
+            Vertex &vertex = vertices[y * (side + 1) + x];
+            std::memset(&vertex, 0, sizeof(Vertex));
+            vertex.Position = glm::vec3((float)x, (float)y, 0.0f);
+            vertex.Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+    }
+    std::vector<unsigned int> indices;
+    for (int y = 0; y < side; y++)
+    {
+        for (int x = 0; x < side; x++)
+        {
+            unsigned int corner = y * (side + 1) + x;
+            indices.insert(indices.end(), {corner, corner + 1, corner + side + 1, corner + side + 1, corner + 1, corner + side + 2});
+        }
+    }
+    return Mesh(vertices, indices, std::vector<Texture>(), VertexLayout::Full, std::vector<MeshLod>(), &arena);
+}
+
+int main(int argc, char *argv[])
+{
+    RenderContext context;
+    if (!context.create(RenderContext::backendFromArguments(argc, argv), 64, 64, "Arena reuse"))
+        return -1;
+
+    std::cout << "GeometryArena, room for exactly two grids:" << std::endl;
+    {
+        // a 4x4 grid is 25 vertices and 96 indices
+        GeometryArena arena(VertexLayout::Full, 50, 192);
+        Mesh first = makeGrid(4, arena);
+        Mesh second = makeGrid(4, arena);
+        check(arena.getFreeVertices() == 0 && arena.getFreeIndices() == 0, "both grids fill it");
+
+        ArenaAllocation freed = first.getAllocation();
+        arena.free(freed);
+        check(arena.getFreeVertices() == 25 && arena.getFreeIndices() == 96, "freeing the first gives its range back");
+
+        Mesh third = makeGrid(4, arena);
+        check(third.getAllocation().baseVertex == freed.baseVertex && third.getAllocation().firstIndex == freed.firstIndex,
+              "the next grid reuses that range");
+        check(arena.getVertexCapacity() == 50 && arena.getIndexCapacity() == 192, "without growing the buffers");
+
+        arena.free(second.getAllocation());
+        arena.free(third.getAllocation());
+        check(arena.getFreeVertices() == 50 && arena.getFreeIndices() == 192, "freeing the rest empties it");
+    }
+
+    std::cout << "Model with useArena, loaded 3 times:" << std::endl;
+    {
+        ModelLoadOptions options;
+        options.useArena = true;
+        GeometryArena &arena = GeometryArena::shared(options.layout);
+        // what is in use before, other than the model
+        size_t usedVertices = arena.getVertexCapacity() - arena.getFreeVertices();
+        size_t usedIndices = arena.getIndexCapacity() - arena.getFreeIndices();
+        size_t vertexCapacity = 0, indexCapacity = 0;
+        bool allBack = true, sameSize = true;
+        for (int load = 0; load < 3; load++)
+        {
+            {
+                Model monkey(FileSystem::getPath("Test/smooth_monkey.obj"), false, options);
+            }
+            allBack = allBack && arena.getVertexCapacity() - arena.getFreeVertices() == usedVertices &&
+                      arena.getIndexCapacity() - arena.getFreeIndices() == usedIndices;
+            // the first load may grow the arena, the later ones fit where it was
+            if (load > 0)
+                sameSize = sameSize && arena.getVertexCapacity() == vertexCapacity && arena.getIndexCapacity() == indexCapacity;
+            vertexCapacity = arena.getVertexCapacity();
+            indexCapacity = arena.getIndexCapacity();
+        }
+        check(allBack, "every range is back once the model is gone");
+        check(sameSize, "the later loads don't grow the arena");
+    }
+
+    if (failures > 0)
+    {
+        std::cout << "ERROR::ARENA_REUSE:: " << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+// custom utils
+#include "../util/RenderContext.h"
+#include "../util/Filesystem.h"
+#include "../util/Shader.h"
+#include "../util/Mesh.h"
+
+// counts the heap allocations made inside Mesh::Draw, which should be none: the
+// texture bindings are built once in setupMesh and the uniform locations are only
+// looked up again when the mesh is drawn with another program. operator new is
+// replaced for the whole program, the counter only runs around the draws.
+// Exits with 1 when a draw allocated. Runs headless as well:
+//   ./draw_allocations --headless egl --draws 1000
+// -------------------------------------------------------------------------------------
+
+static size_t allocations = 0;
+static bool counting = false;
+
+void *operator new(std::size_t size)
+{
+    if (counting)
+        allocations++;
+    if (void *memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+// a 1x1 texture, what's in it doesn't matter
+unsigned int makeTexture()
+{
+    unsigned char pixel[4] = {255, 255, 255, 255};
+    unsigned int id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return id;
+}
+
+int main(int argc, char *argv[])
+{
+    int draws = 1000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--draws") == 0 && i + 1 < argc)
+            draws = std::max(1, std::atoi(argv[++i]));
+    }
+
+    RenderContext context;
+    if (!context.create(RenderContext::backendFromArguments(argc, argv), 64, 64, "Draw allocations"))
+        return -1;
+
+    Shader shader(FileSystem::getPath("Test/rock_vertex.vs").c_str(), FileSystem::getPath("Test/rock_fragment.fs").c_str());
+    Shader otherShader(FileSystem::getPath("Shaders/material_vertex.vs").c_str(), FileSystem::getPath("Shaders/material_fragment.fs").c_str());
+
+    // a quad with a diffuse, a specular and a normal map, like the monkey's meshes
+    std::vector<Vertex> vertices(4);
+    for (int i = 0; i < 4; i++)
+    {
+        std::memset(&vertices[i], 0, sizeof(Vertex));
+        vertices[i].Position = glm::vec3((float)(i & 1), (float)(i >> 1), 0.0f);
+        vertices[i].Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+    std::vector<unsigned int> indices = {0, 1, 2, 2, 1, 3};
+    std::vector<Texture> textures = {
+        {makeTexture(), "texture_diffuse", "diffuse.png"},
+        {makeTexture(), "texture_specular", "specular.png"},
+        {makeTexture(), "texture_normal", "normal.png"}};
+    Mesh mesh(vertices, indices, textures);
+
+    // the first draw with a program resolves its locations, that one may allocate
+    shader.use();
+    mesh.Draw(shader);
+
+    counting = true;
+    for (int i = 0; i < draws; i++)
+        mesh.Draw(shader);
+    counting = false;
+    size_t steady = allocations;
+
+    // switching programs every draw, the locations get looked up each time
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < draws; i++)
+    {
+        Shader &current = (i & 1) ? otherShader : shader;
+        current.use();
+        mesh.Draw(current);
+    }
+    counting = false;
+    size_t switching = allocations;
+    glFinish();
+
+    std::cout << draws << " draws of one mesh with " << textures.size() << " textures:" << std::endl;
+    std::cout << "  same program        " << steady << " allocations" << std::endl;
+    std::cout << "  program every draw  " << switching << " allocations (location lookups, expected)" << std::endl;
+    if (steady > 0)
+    {
+        std::cout << "ERROR::DRAW_ALLOCATIONS:: Mesh::Draw allocated " << steady << " times" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// custom utils
+#include "../util/RenderContext.h"
+#include "../util/RenderState.h"
+#include "../util/UtilDimension.h"
+#include "../util/Filesystem.h"
+#include "../util/Shader.h"
+#include "../util/Camera.h"
+#include "../util/Model.h"
+#include "../util/UniformBlocks.h"
+#include "../util/UniformRing.h"
+
+// draws the monkey 1k, 10k and 100k times, once with a setMat4 + draw call per copy
+// and once with Model::DrawInstanced, and prints the average frame time of each.
+// glFinish at the end of every frame so the time includes the GPU work, not only the
+// time spent queueing commands. Runs headless as well:
+//   ./instancing_benchmark --headless egl
+// -------------------------------------------------------------------------------------
+
+const int FRAMES_PER_RUN = 60;
+
+// a cube of copies around the origin, 2 units apart
+std::vector<glm::mat4> buildInstances(size_t count)
+{
+    std::vector<glm::mat4> instances;
+    instances.reserve(count);
+    int side = (int)std::ceil(std::cbrt((double)count));
+    for (size_t i = 0; i < count; i++)
+    {
+        int x = (int)(i % side);
+        int y = (int)((i / side) % side);
+        int z = (int)(i / (side * side));
+        glm::vec3 position = glm::vec3(x - side / 2, y - side / 2, -z) * 2.0f;
+        instances.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.5f)));
+    }
+    return instances;
+}
+
+// average milliseconds per frame of FRAMES_PER_RUN frames of draw()
+template <typename DrawFunction>
+double timeFrames(RenderContext &context, DrawFunction draw)
+{
+    double start = context.getTime();
+    for (int frame = 0; frame < FRAMES_PER_RUN && !context.shouldClose(); frame++)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        draw();
+        glFinish();
+        context.endFrame();
+    }
+    return (context.getTime() - start) * 1000.0 / FRAMES_PER_RUN;
+}
+
+int main(int argc, char *argv[])
+{
+    RenderContext context;
+    if (!context.create(RenderContext::backendFromArguments(argc, argv), SCR_WIDTH, SCR_HEIGHT, "Instancing benchmark"))
+        return -1;
+    // no vsync, otherwise every run just measures the refresh rate
+    context.setSwapInterval(0);
+
+    RenderState &state = RenderState::shared();
+    state.enable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+
+    Shader singleShader(FileSystem::getPath("Shaders/material_vertex.vs").c_str(), FileSystem::getPath("Shaders/material_fragment.fs").c_str());
+    Shader instancedShader(FileSystem::getPath("Shaders/material_vertex_instanced.vs").c_str(), FileSystem::getPath("Shaders/material_fragment.fs").c_str());
+    Model monkey(FileSystem::getPath("Test/smooth_monkey.obj"));
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 500.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 60.0f), glm::vec3(0.0f, 0.0f, -30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // same light and material for both shaders, so they cost the same per fragment.
+    // nothing changes between frames: the blocks are written once and stay bound
+    SpotLightBlock spotLight;
+    spotLight.position = glm::vec3(0.0f, 0.0f, 60.0f);
+    spotLight.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    spotLight.ambient = glm::vec3(0.3f);
+    spotLight.diffuse = glm::vec3(1.0f);
+    spotLight.specular = glm::vec3(1.0f);
+    spotLight.constant = 1.0f;
+    spotLight.linear = 0.0014f;
+    spotLight.quadratic = 0.000007f;
+    spotLight.cutOff = glm::cos(glm::radians(40.0f));
+    spotLight.outerCutOff = glm::cos(glm::radians(50.0f));
+    MaterialBlock material(Materials::EMERALD);
+    material.shininess = 16.0f;
+
+    UniformRing uniforms;
+    uniforms.bind(FRAME_BLOCK_BINDING, FrameBlock(projection, view, glm::vec3(0.0f, 0.0f, 60.0f)));
+    uniforms.bind(LIGHT_BLOCK_BINDING, spotLight);
+    uniforms.bind(MATERIAL_BLOCK_BINDING, material);
+    bindUniformBlocks(singleShader);
+    bindUniformBlocks(instancedShader);
+
+    GLint modelLocation = singleShader.getUniformLocation("model");
+    const size_t counts[] = {1000, 10000, 100000};
+    for (size_t count : counts)
+    {
+        std::vector<glm::mat4> instances = buildInstances(count);
+
+        double singleMs = timeFrames(context, [&]()
+        {
+            singleShader.use();
+            for (const glm::mat4 &instance : instances)
+            {
+                singleShader.setMat4(modelLocation, instance);
+                monkey.Draw(singleShader);
+            }
+        });
+
+        double instancedMs = timeFrames(context, [&]()
+        {
+            instancedShader.use();
+            monkey.DrawInstanced(instancedShader, instances);
+        });
+
+        std::cout << count << " instances: one draw per copy " << singleMs << " ms/frame, instanced "
+                  << instancedMs << " ms/frame (" << singleMs / instancedMs << "x)" << std::endl;
+    }
+    return 0;
+}
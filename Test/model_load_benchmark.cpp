@@ -0,0 +1,73 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+// custom utils
+#include "../util/RenderContext.h"
+#include "../util/Filesystem.h"
+#include "../util/Model.h"
+#include "../util/MeshCache.h"
+#include "../util/TextureStreamer.h"
+
+// loads a model over and over, cold (assimp import, optimizer and LOD generation on
+// every load, no mesh cache) and warm (straight from the mapped MeshCache file), and
+// prints the average milliseconds of each. Runs headless as well:
+//   ./model_load_benchmark --headless egl --runs 10 Test/smooth_monkey.obj
+// The cache file of the model is deleted first, so the first warm load writes it
+// -------------------------------------------------------------------------------------
+
+// average milliseconds of runs loads of path with the given options
+double timeLoads(const std::string &path, const ModelLoadOptions &options, int runs)
+{
+    double total = 0.0;
+    for (int run = 0; run < runs; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Model model(path, false, options);
+        total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        // textures decode in the background, they are not what is measured here
+        TextureStreamer::shared().finish();
+    }
+    return total / runs;
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 5;
+    std::string path = FileSystem::getPath("Test/smooth_monkey.obj");
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--headless") == 0 && i + 1 < argc &&
+                 (std::strcmp(argv[i + 1], "egl") == 0 || std::strcmp(argv[i + 1], "osmesa") == 0))
+            i++; // the backend name, RenderContext::backendFromArguments reads it
+        else if (argv[i][0] != '-')
+            path = argv[i];
+    }
+
+    // meshes upload their buffers while loading, so a context is needed
+    RenderContext context;
+    if (!context.create(RenderContext::backendFromArguments(argc, argv), 64, 64, "Model load benchmark"))
+        return -1;
+
+    ModelLoadOptions cold;
+    cold.useCache = false;
+    ModelLoadOptions warm;
+
+    std::remove(MeshCache::getCachePath(path).c_str());
+    // writes the cache file, and keeps the first (slower) import out of the cold numbers
+    double first = timeLoads(path, warm, 1);
+    double coldMs = timeLoads(path, cold, runs);
+    double warmMs = timeLoads(path, warm, runs);
+
+    std::cout << path << ", " << runs << " loads each:" << std::endl;
+    std::cout << "  first load, writes the cache " << first << " ms" << std::endl;
+    std::cout << "  cold, assimp every time      " << coldMs << " ms" << std::endl;
+    std::cout << "  warm, from the mesh cache    " << warmMs << " ms (" << coldMs / warmMs << "x)" << std::endl;
+    return 0;
+}
@@ -13,6 +13,7 @@
 #include "../util/Shader.h"
 #include "../util/Camera.h"
 #include "../util/Model.h"
+#include "../util/RenderState.h"
 
 int main()
 {
@@ -61,7 +62,7 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    RenderState::shared().enable(GL_DEPTH_TEST);
     // this is effcienet because avoid the calling of fragmente shaders
     // for all the intern faces, so we need to call it nonly the 50 % of the timne
     // it gona take only clockwise vertix, using fron view
@@ -69,15 +70,28 @@ int main()
     // GL_FRONT: Culls only the front faces.
     // GL_FRONT_AND_BACK: Culls both the front and back faces.
     // -----------------------------------------------------------------
-    glEnable(GL_CULL_FACE);
+    RenderState::shared().enable(GL_CULL_FACE);
     // build and compile shaders
     // -------------------------
     Shader ourShader("4.normal_mapping.vs", "4.normal_mapping.fs");
-    Shader rockShader("rock_vertex.vs", "rock_fragment.fs");
+    Shader rockShader("rock_vertex_instanced.vs", "rock_fragment.fs");
     // load models
     // -----------
+    // the same monkey is drawn once with the normal mapping shader and then as a grid of
+    // metal copies, so it's loaded once and the copies go out in a single instanced draw
     Model ourModel(FileSystem::getPath("Test/smooth_monkey.obj"));
-    Model cubeModel(FileSystem::getPath("Test/smooth_monkey.obj"));
+    LodState ourModelLods;
+    Frustum frustum;
+
+    std::vector<glm::mat4> rockInstances;
+    for (int x = 0; x < 10; x++)
+    {
+        for (int z = 0; z < 10; z++)
+        {
+            glm::mat4 instance = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f + x * 3.0f, 0.0f, -z * 3.0f));
+            rockInstances.push_back(instance);
+        }
+    }
 
     // draw in wireframe
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -106,7 +120,7 @@ int main()
     // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" <<  std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // render loop
     // -----------
@@ -119,6 +133,10 @@ int main()
         lastFrame = currentFrame;
         frameMovement = static_cast<float>(camera.GetSpeedCamera() * deltaTime);
 
+        // upload the model textures decoded in the background, 2 ms per frame at most
+        // ------------------------------------------------------------------------
+        TextureStreamer::shared().update(2.0);
+
         // input
         // -----
         processInput(window);
@@ -126,8 +144,7 @@ int main()
         // render
         // ------
         ourModel.Framebuffer();
-        cubeModel.Framebuffer();
-        glEnable(GL_STENCIL_TEST);
+        RenderState::shared().enable(GL_STENCIL_TEST);
 
         glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
@@ -156,6 +173,7 @@ int main()
         // view/projection transformations
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
+        frustum.update(projection * view);
 
         ourShader.setMat4("projection", projection);
         ourShader.setMat4("view", view);
@@ -168,7 +186,7 @@ int main()
         model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));     // it's a bit too big for our scene, so scale it down
 
         ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
+        ourModel.Draw(ourShader, camera, model, (float)SCR_HEIGHT, 1.0f, &ourModelLods);
 
         // Second model with rock shader and texture
         rockShader.use();
@@ -188,28 +206,19 @@ int main()
 
 
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, metal_normal);
+        RenderState::shared().bindTexture(0, GL_TEXTURE_2D, metal_normal);
         rockShader.setInt("metal_normal", 0);
         
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, metal_diff);
+        RenderState::shared().bindTexture(1, GL_TEXTURE_2D, metal_diff);
         rockShader.setInt("metal_diff", 1);
         
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, metal_spec);
+        RenderState::shared().bindTexture(2, GL_TEXTURE_2D, metal_spec);
         rockShader.setInt("metal_spec", 2);
         
         rockShader.setMat4("projection", projection);
         rockShader.setMat4("view", view);
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(3.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));     // it's a bit too big for our scene, so scale it down
-
-        rockShader.setMat4("model", model);
-
-        cubeModel.Draw(rockShader);
+        ourModel.DrawInstanced(rockShader, rockInstances, frustum);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
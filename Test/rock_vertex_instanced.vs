@@ -0,0 +1,44 @@
+#version 330 core
+// rock_vertex.vs with the model matrix per instance (Model::DrawInstanced)
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+layout (location = 7) in mat4 aInstanceModel;
+
+out VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    vec3 TangentLightPos;
+    vec3 TangentViewPos;
+    vec3 TangentFragPos;
+} vs_out;
+
+out vec3 Normal;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+uniform vec3 lightPos;
+uniform vec3 viewPos;
+
+void main()
+{
+    mat4 model = aInstanceModel;
+    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));   
+    vs_out.TexCoords = aTexCoords;
+    
+    mat3 normalMatrix = transpose(inverse(mat3(model)));
+    vec3 T = normalize(normalMatrix * aTangent);
+    vec3 N = normalize(normalMatrix * aNormal);
+    T = normalize(T - dot(T, N) * N);
+    vec3 B = cross(N, T);
+    
+    mat3 TBN = transpose(mat3(T, B, N));    
+    vs_out.TangentLightPos = TBN * lightPos;
+    vs_out.TangentViewPos  = TBN * viewPos;
+    vs_out.TangentFragPos  = TBN * vs_out.FragPos;
+    Normal = aNormal;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
\ No newline at end of file
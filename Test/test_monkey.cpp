@@ -13,6 +13,7 @@
 #include "../util/Shader.h"
 #include "../util/Camera.h"
 #include "../util/Model.h"
+#include "../util/RenderState.h"
 
 int main()
 {
@@ -61,7 +62,7 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    RenderState::shared().enable(GL_DEPTH_TEST);
     // this is effcienet because avoid the calling of fragmente shaders
     // for all the intern faces, so we need to call it nonly the 50 % of the timne
     // it gona take only clockwise vertix, using fron view
@@ -69,7 +70,7 @@ int main()
     // GL_FRONT: Culls only the front faces.
     // GL_FRONT_AND_BACK: Culls both the front and back faces.
     // -----------------------------------------------------------------
-    glEnable(GL_CULL_FACE);
+    RenderState::shared().enable(GL_CULL_FACE);
     // build and compile shaders
     // -------------------------
     Shader ourShader("4.normal_mapping.vs", "4.normal_mapping.fs");
@@ -108,13 +109,17 @@ int main()
         lastFrame = currentFrame;
         frameMovement = static_cast<float>(camera.GetSpeedCamera() * deltaTime);
 
+        // upload the model textures decoded in the background, 2 ms per frame at most
+        // ------------------------------------------------------------------------
+        TextureStreamer::shared().update(2.0);
+
         // input
         // -----
         processInput(window);
 
         // render
         // ------
-        glEnable(GL_STENCIL_TEST);
+        RenderState::shared().enable(GL_STENCIL_TEST);
         glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
         // don't forget to enable shader before setting uniforms
@@ -140,8 +145,7 @@ int main()
         ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(34.0f)));
 
         // set the rock color texture
-           glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, rock_color);
+           RenderState::shared().bindTexture(0, GL_TEXTURE_2D, rock_color);
 
 
         // view/projection transformations
@@ -165,7 +169,7 @@ int main()
         model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(3.0f, 0.0f, 0.0f)); // translate it down so it's at the center of the scene
         model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));     // it's a bit too big for our scene, so scale it down
-        glBindTexture(GL_TEXTURE_2D, transparentTexture);
+        RenderState::shared().bindTexture(GL_TEXTURE_2D, transparentTexture);
         grassShader.setMat4("model", model);
         cubeModel.Draw(grassShader);
 
@@ -0,0 +1,119 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// custom utils
+#include "../util/RenderContext.h"
+#include "../util/Filesystem.h"
+#include "../util/Shader.h"
+
+// sets the uniforms a rock draw of rock_money sets (model matrix, spot light,
+// material) over and over, three ways, and prints the nanoseconds per draw of each:
+//   driver:  glGetUniformLocation + glUniform per uniform, what Shader did before
+//   by name: shader.setX("name"), one hash lookup in the cached locations
+//   handles: locations resolved once, shader.setX(location)
+// Only the CPU side is measured, nothing is drawn. Runs headless as well:
+//   ./uniform_cache_benchmark --headless egl --draws 100000
+// -------------------------------------------------------------------------------------
+
+const int RUNS = 5;
+
+// the uniforms of one draw, in the order they get set
+const char *const VEC3_NAMES[] = {
+    "lightPos", "viewPos",
+    "spotLight.position", "spotLight.direction", "spotLight.ambient", "spotLight.diffuse", "spotLight.specular",
+    "material.ambient", "material.diffuse", "material.specular"};
+const char *const FLOAT_NAMES[] = {
+    "spotLight.cutOff", "spotLight.outerCutOff", "spotLight.constant", "spotLight.linear", "spotLight.quadratic",
+    "material.shininess"};
+const size_t VEC3_COUNT = sizeof(VEC3_NAMES) / sizeof(VEC3_NAMES[0]);
+const size_t FLOAT_COUNT = sizeof(FLOAT_NAMES) / sizeof(FLOAT_NAMES[0]);
+
+// best nanoseconds per draw of RUNS runs of draws calls to setUniforms(draw)
+template <typename SetFunction>
+double timeDraws(size_t draws, SetFunction setUniforms)
+{
+    double best = 1e30;
+    for (int run = 0; run < RUNS; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t draw = 0; draw < draws; draw++)
+            setUniforms(draw);
+        // the driver may queue the calls, make sure they are all done
+        glFinish();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, ns / draws);
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t draws = 100000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--draws") == 0 && i + 1 < argc)
+            draws = (size_t)std::max(1, std::atoi(argv[++i]));
+    }
+
+    RenderContext context;
+    if (!context.create(RenderContext::backendFromArguments(argc, argv), 64, 64, "Uniform cache benchmark"))
+        return -1;
+
+    Shader shader(FileSystem::getPath("Test/rock_vertex.vs").c_str(), FileSystem::getPath("Test/rock_fragment.fs").c_str());
+    shader.use();
+
+    // uniforms that were optimized out of the program are -1 all three ways, that's fine
+    GLint modelLocation = shader.getUniformLocation("model");
+    GLint vec3Locations[VEC3_COUNT];
+    GLint floatLocations[FLOAT_COUNT];
+    for (size_t i = 0; i < VEC3_COUNT; i++)
+        vec3Locations[i] = shader.getUniformLocation(VEC3_NAMES[i]);
+    for (size_t i = 0; i < FLOAT_COUNT; i++)
+        floatLocations[i] = shader.getUniformLocation(FLOAT_NAMES[i]);
+
+    // the values change per draw so nothing can be skipped as redundant
+    auto modelFor = [](size_t draw)
+    {
+        return glm::translate(glm::mat4(1.0f), glm::vec3((float)(draw % 100), 0.0f, 0.0f));
+    };
+
+    double driverNs = timeDraws(draws, [&](size_t draw)
+                                {
+        glm::mat4 model = modelFor(draw);
+        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, glm::value_ptr(model));
+        for (size_t i = 0; i < VEC3_COUNT; i++)
+            glUniform3f(glGetUniformLocation(shader.ID, VEC3_NAMES[i]), (float)draw, 1.0f, 0.0f);
+        for (size_t i = 0; i < FLOAT_COUNT; i++)
+            glUniform1f(glGetUniformLocation(shader.ID, FLOAT_NAMES[i]), (float)draw); });
+
+    double nameNs = timeDraws(draws, [&](size_t draw)
+                              {
+        shader.setMat4("model", modelFor(draw));
+        for (size_t i = 0; i < VEC3_COUNT; i++)
+            shader.setVec3(VEC3_NAMES[i], glm::vec3((float)draw, 1.0f, 0.0f));
+        for (size_t i = 0; i < FLOAT_COUNT; i++)
+            shader.setFloat(FLOAT_NAMES[i], (float)draw); });
+
+    double handleNs = timeDraws(draws, [&](size_t draw)
+                                {
+        shader.setMat4(modelLocation, modelFor(draw));
+        for (size_t i = 0; i < VEC3_COUNT; i++)
+            shader.setVec3(vec3Locations[i], glm::vec3((float)draw, 1.0f, 0.0f));
+        for (size_t i = 0; i < FLOAT_COUNT; i++)
+            shader.setFloat(floatLocations[i], (float)draw); });
+
+    std::cout << RenderContext::backendName(context.getBackend()) << ", " << draws << " draws of "
+              << 1 + VEC3_COUNT + FLOAT_COUNT << " uniforms, best of " << RUNS << " runs:" << std::endl;
+    std::cout << "  driver lookup per call " << driverNs << " ns/draw" << std::endl;
+    std::cout << "  cached, by name        " << nameNs << " ns/draw (" << driverNs / nameNs << "x)" << std::endl;
+    std::cout << "  pre-resolved handles   " << handleNs << " ns/draw (" << driverNs / handleNs << "x)" << std::endl;
+    return 0;
+}
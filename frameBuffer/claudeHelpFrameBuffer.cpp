@@ -13,6 +13,7 @@
 #include "../util/Shader.h"
 #include "../util/Camera.h"
 #include "../util/Model.h"
+#include "../util/RenderState.h"
 #include "../util/Material.h"
 
 
@@ -60,8 +61,8 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    RenderState::shared().enable(GL_DEPTH_TEST);
+    RenderState::shared().enable(GL_CULL_FACE);
 
     // build and compile shaders
     // -------------------------
@@ -101,7 +102,7 @@ int main()
     unsigned int quadVAO, quadVBO;
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    RenderState::shared().bindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -113,12 +114,12 @@ int main()
     // -------------------------
     unsigned int framebuffer;
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
     // create a color attachment texture
     unsigned int textureColorbuffer;
     glGenTextures(1, &textureColorbuffer);
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
+    RenderState::shared().bindTexture(GL_TEXTURE_2D, textureColorbuffer);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -134,7 +135,7 @@ int main()
     // check if framebuffer is complete
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // configure screen shader
     screenShader.use();
@@ -161,14 +162,18 @@ int main()
         lastFrame = currentFrame;
         frameMovement = static_cast<float>(camera.GetSpeedCamera() * deltaTime);
 
+        // upload the model textures decoded in the background, 2 ms per frame at most
+        // ------------------------------------------------------------------------
+        TextureStreamer::shared().update(2.0);
+
         // input
         // -----
         processInput(window);
 
         // FIRST PASS: render scene to framebuffer
         // ========================================
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glEnable(GL_DEPTH_TEST);
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        RenderState::shared().enable(GL_DEPTH_TEST);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -184,9 +189,8 @@ int main()
 
         for (Mesh mesh : ourModel.getMeshes())
         {
-            glBindVertexArray(mesh.getVAO());
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, rockColor);
+            RenderState::shared().bindVertexArray(mesh.getVAO());
+            RenderState::shared().bindTexture(0, GL_TEXTURE_2D, rockColor);
         }
 
         glm::mat4 model = glm::mat4(1.0f);
@@ -203,9 +207,8 @@ int main()
 
         for (Mesh mesh : monkeyTest2.getMeshes())
         {
-            glBindVertexArray(mesh.getVAO());
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, metal);
+            RenderState::shared().bindVertexArray(mesh.getVAO());
+            RenderState::shared().bindTexture(0, GL_TEXTURE_2D, metal);
         }
 
         model = glm::mat4(1.0f);
@@ -267,15 +270,14 @@ int main()
 
         // SECOND PASS: now draw framebuffer texture to screen
         // ===================================================
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST); // disable depth test for screen-space quad
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        RenderState::shared().disable(GL_DEPTH_TEST); // disable depth test for screen-space quad
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
         screenShader.use();
-        glBindVertexArray(quadVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
+        RenderState::shared().bindVertexArray(quadVAO);
+        RenderState::shared().bindTexture(0, GL_TEXTURE_2D, textureColorbuffer);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
         // glfw: swap buffers and poll IO events
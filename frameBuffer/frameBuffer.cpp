@@ -13,6 +13,7 @@
 #include "../util/Shader.h"
 #include "../util/Camera.h"
 #include "../util/Model.h"
+#include "../util/RenderState.h"
 
 int main()
 {
@@ -61,7 +62,7 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    RenderState::shared().enable(GL_DEPTH_TEST);
     // this is effcienet because avoid the calling of fragmente shaders
     // for all the intern faces, so we need to call it nonly the 50 % of the timne
     // it gona take only clockwise vertix, using fron view
@@ -69,7 +70,7 @@ int main()
     // GL_FRONT: Culls only the front faces.
     // GL_FRONT_AND_BACK: Culls both the front and back faces.
     // -----------------------------------------------------------------
-    glEnable(GL_CULL_FACE);
+    RenderState::shared().enable(GL_CULL_FACE);
     // build and compile shaders
     // -------------------------
     Shader ourShader("framebuffers.vs", "framebuffers.fs");
@@ -95,12 +96,12 @@ int main()
     // -------------------------
     unsigned int framebuffer;
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
     // create a color attachment texture
     unsigned int textureColorbuffer;
     glGenTextures(1, &textureColorbuffer);
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
+    RenderState::shared().bindTexture(GL_TEXTURE_2D, textureColorbuffer);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -114,7 +115,7 @@ int main()
     // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // render loop
     // -----------
@@ -127,16 +128,20 @@ int main()
         lastFrame = currentFrame;
         frameMovement = static_cast<float>(camera.GetSpeedCamera() * deltaTime);
 
+        // upload the model textures decoded in the background, 2 ms per frame at most
+        // ------------------------------------------------------------------------
+        TextureStreamer::shared().update(2.0);
+
         // input
         // -----
         processInput(window);
 
         // render
         // ------
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // we're not using the stencil buffer now
-        glEnable(GL_DEPTH_TEST);
+        RenderState::shared().enable(GL_DEPTH_TEST);
         // don't forget to enable shader before setting uniforms
         ourShader.use();
         ourShader.setVec3("viewPos", camera.Position);
@@ -148,9 +153,8 @@ int main()
 
         for (Mesh mesh : ourModel.getMeshes())
         {
-            glBindVertexArray(mesh.getVAO());
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, rockColor);
+            RenderState::shared().bindVertexArray(mesh.getVAO());
+            RenderState::shared().bindTexture(0, GL_TEXTURE_2D, rockColor);
         }
 
         // render the loaded model
@@ -165,9 +169,9 @@ int main()
         //  -------------------------------------------------------------------------------
 
         // now define the other money
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, 0);
         // clear all relevant buffers
-        glEnable(GL_DEPTH_TEST);
+        RenderState::shared().enable(GL_DEPTH_TEST);
         //glClear(GL_COLOR_BUFFER_BIT);
         monkeyTestShader.use();
 
@@ -179,9 +183,8 @@ int main()
 
         for (Mesh mesh : monkeyTest2.getMeshes())
         {
-            glBindVertexArray(mesh.getVAO());
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, metal);
+            RenderState::shared().bindVertexArray(mesh.getVAO());
+            RenderState::shared().bindTexture(0, GL_TEXTURE_2D, metal);
         }
 
         // render the loaded model
@@ -191,7 +194,7 @@ int main()
         monkeyTestShader.setMat4("model", model);
 
         monkeyTest2.Draw(monkeyTestShader);
-        glBindTexture(GL_TEXTURE_2D, textureColorbuffer);	// use the color attachment texture as the texture of the quad plane
+        RenderState::shared().bindTexture(GL_TEXTURE_2D, textureColorbuffer);	// use the color attachment texture as the texture of the quad plane
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -0,0 +1,292 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// custom utils
+#include "../util/RenderContext.h"
+#include "../util/FrameTimer.h"
+#include "../util/Callback.h"
+#include "../util/TextureLoader.h"
+#include "../util/TextureStreamer.h"
+#include "../util/Filesystem.h"
+#include "../util/Shader.h"
+#include "../util/Camera.h"
+#include "../util/Model.h"
+#include "../util/Material.h"
+#include "../util/Frustum.h"
+#include "../util/CanvasCube.h"
+#include "../util/RenderState.h"
+#include "../util/RenderQueue.h"
+#include "../util/ThreadPool.h"
+#include "../util/IndirectBatch.h"
+#include "../util/UniformBlocks.h"
+#include "../util/UniformRing.h"
+
+// renders the spot lit monkeys of testingMonkeyOnCanvas into CanvasCube's framebuffer
+// frame after frame as fast as they go (no vsync, no input) and prints the CPU and
+// GPU time of both passes, and how many state changes RenderState let through to GL.
+// With --headless it needs neither a display nor a GPU, so it runs on build boxes
+// (EGL on Mesa llvmpipe, or OSMesa):
+//   ./frameCapture --headless egl --frames 600 --copies 400 --capture last.ppm
+// --capture writes the canvas of the last frame, to check what was rendered.
+// The copies alternate between two materials; --queue submits them from the thread
+// pool into a RenderQueue, which sorts them by material instead of drawing them in
+// grid order; --indirect loads the monkey into the shared GeometryArena and draws all
+// the copies of a material with one multi draw indirect call.
+// Camera, light and materials reach the shader as uniform blocks in a UniformRing
+// -------------------------------------------------------------------------------------
+
+// the canvas color attachment as a binary PPM, top row first
+bool writeCapture(const std::string &path, unsigned int framebuffer, unsigned int width, unsigned int height)
+{
+    std::vector<unsigned char> pixels((size_t)width * height * 3);
+    RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    file << "P6\n"
+         << width << " " << height << "\n255\n";
+    for (unsigned int row = height; row-- > 0;)
+        file.write(reinterpret_cast<const char *>(pixels.data()) + (size_t)row * width * 3, width * 3);
+    return file.good();
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = 300;
+    int warmup = 30;
+    int copies = 100;
+    bool useQueue = false;
+    bool useIndirect = false;
+    std::string capturePath;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            warmup = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--copies") == 0 && i + 1 < argc)
+            copies = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            capturePath = argv[++i];
+        else if (std::strcmp(argv[i], "--queue") == 0)
+            useQueue = true;
+        else if (std::strcmp(argv[i], "--indirect") == 0)
+            useIndirect = true;
+    }
+
+    RenderContext context;
+    if (!context.create(RenderContext::backendFromArguments(argc, argv), SCR_WIDTH, SCR_HEIGHT, "frameCapture"))
+        return -1;
+    // as fast as possible, vsync would measure the display instead
+    context.setSwapInterval(0);
+
+    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
+    stbi_set_flip_vertically_on_load(true);
+
+    // configure global opengl state
+    // -----------------------------
+    RenderState &state = RenderState::shared();
+    state.enable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+
+    ModelLoadOptions options;
+    options.useArena = useIndirect;
+    Model moneyTest(FileSystem::getPath("Test/monkey.obj"), false, options);
+    // the batches read the model matrix per instance
+    const char *vertexShader = useIndirect ? "Shaders/material_vertex_instanced.vs" : "Shaders/material_vertex.vs";
+    Shader shaderMonkey(FileSystem::getPath(vertexShader).c_str(), FileSystem::getPath("Shaders/material_fragment.fs").c_str());
+    bindUniformBlocks(shaderMonkey);
+    const Material materials[2] = {Materials::TURQUOISE, Materials::JADE};
+    // every texture is on the GPU before the first measured frame
+    TextureStreamer::shared().finish();
+
+    glm::vec3 ligthConstant = glm::vec3(1.0f);
+    float outerCutOffCostant = glm::cos(glm::radians(34.0f));
+    float cutOffCostant = glm::cos(glm::radians(25.0f));
+    float constantDistance = 1.0f;
+    float linearDistance = 0.09f;
+    float quadraticDistance = 0.032f;
+
+    // the spotlight follows the camera, everything else about it stays
+    SpotLightBlock spotLight;
+    spotLight.ambient = ligthConstant;
+    spotLight.diffuse = ligthConstant;
+    spotLight.specular = ligthConstant;
+    spotLight.constant = constantDistance;
+    spotLight.linear = linearDistance;
+    spotLight.quadratic = quadraticDistance;
+    spotLight.cutOff = cutOffCostant;
+    spotLight.outerCutOff = outerCutOffCostant;
+
+    // a square grid of copies in front of the camera, 2.5 units apart
+    int side = (int)std::ceil(std::sqrt((double)copies));
+    camera.Position = glm::vec3(0.0f, 0.0f, 3.0f + 2.0f * side);
+
+    CanvasCube quadCube;
+    quadCube.initCanvas();
+    Frustum frustum;
+    // what the frustum let through, summed over the measured frames
+    CullingStatistics culling = CullingStatistics{};
+    FrameTimer timer;
+    // one bucket per thread of the pool, plus the calling thread that helps
+    RenderQueue queue(ThreadPool::shared().size() + 1);
+    UniformRing uniforms;
+    queue.setUniformRing(&uniforms);
+    // one batch per material, the material block is rebound between the two draws
+    IndirectBatch batches[2];
+    // levels of detail of every copy, the copies share moneyTest
+    std::vector<LodState> copyLods(copies);
+
+    double start = context.getTime();
+    int rendered = 0;
+    for (int frame = 0; frame < warmup + frames && !context.shouldClose(); frame++)
+    {
+        if (frame == warmup)
+        {
+            // shader compiles and first uploads stay out of the numbers
+            timer.clear();
+            state.resetStatistics();
+            start = context.getTime();
+        }
+        timer.beginFrame();
+        state.beginFrame();
+
+        // FIRST PASS: render scene to framebuffer
+        // ========================================
+        timer.beginPass("scene");
+        state.bindFramebuffer(GL_FRAMEBUFFER, quadCube.getFramebuffer());
+        state.enable(GL_DEPTH_TEST);
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glm::mat4 projectionMatrix = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.f);
+        glm::mat4 viewMatrix = camera.GetViewMatrix();
+        frustum.update(projectionMatrix * viewMatrix);
+
+        shaderMonkey.use();
+        uniforms.beginFrame();
+        uniforms.bind(FRAME_BLOCK_BINDING, FrameBlock(projectionMatrix, viewMatrix, camera.Position));
+        spotLight.position = camera.Position;
+        spotLight.direction = camera.Front;
+        uniforms.bind(LIGHT_BLOCK_BINDING, spotLight);
+        // both materials once per frame, the copies only pick one with glBindBufferRange
+        GLintptr materialOffsets[2] = {uniforms.write(MaterialBlock(materials[0])), uniforms.write(MaterialBlock(materials[1]))};
+        auto useMaterial = [&](int m)
+        {
+            uniforms.bindRange(MATERIAL_BLOCK_BINDING, materialOffsets[m], sizeof(MaterialBlock));
+        };
+
+        // the monkeys turn a little every frame, so no two frames are the same
+        float angle = glm::radians(2.0f * frame);
+        auto copyMatrix = [&](int i)
+        {
+            glm::vec3 position = glm::vec3((i % side) - (side - 1) / 2.0f, (i / side) - (side - 1) / 2.0f, 0.0f) * 2.5f;
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+            return glm::rotate(model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        };
+
+        if (useIndirect)
+        {
+            for (IndirectBatch &batch : batches)
+                batch.clear();
+            for (int i = 0; i < copies; i++)
+                moneyTest.Submit(batches[i % 2], camera, copyMatrix(i), (float)SCR_HEIGHT, frustum);
+            for (int m = 0; m < 2; m++)
+            {
+                useMaterial(m);
+                batches[m].draw(shaderMonkey);
+            }
+        }
+        else if (useQueue)
+        {
+            queue.clear();
+            size_t buckets = queue.getBucketCount();
+            // the frustum counts what it lets through, every thread gets its own copy
+            std::vector<Frustum> bucketFrustums(buckets, frustum);
+            ThreadPool::shared().parallelFor(buckets, [&](size_t b)
+            {
+                for (int i = (int)b; i < copies; i += (int)buckets)
+                    moneyTest.Submit(queue.getBucket(b), shaderMonkey, &materials[i % 2], camera, copyMatrix(i),
+                                     (float)SCR_HEIGHT, bucketFrustums[b]);
+            });
+            for (const Frustum &bucketFrustum : bucketFrustums)
+                frustum.addStatistics(bucketFrustum.getStatistics());
+            queue.sort();
+            queue.execute();
+        }
+        else
+        {
+            for (int i = 0; i < copies; i++)
+            {
+                useMaterial(i % 2);
+                glm::mat4 model = copyMatrix(i);
+                shaderMonkey.setMat4("model", model);
+                moneyTest.Draw(shaderMonkey, camera, model, (float)SCR_HEIGHT, frustum, 1.0f, &copyLods[i]);
+            }
+        }
+        uniforms.endFrame();
+        timer.endPass();
+
+        // SECOND PASS: now draw framebuffer texture to screen
+        // ===================================================
+        timer.beginPass("canvas");
+        state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        state.disable(GL_DEPTH_TEST); // disable depth test for screen-space quad
+        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        quadCube.useCanvas();
+        timer.endPass();
+
+        timer.endFrame();
+        state.endFrame();
+        context.endFrame();
+        if (frame >= warmup)
+        {
+            rendered++;
+            culling.tested += frustum.getStatistics().tested;
+            culling.visible += frustum.getStatistics().visible;
+            culling.culled += frustum.getStatistics().culled;
+        }
+    }
+    timer.finish();
+    double seconds = context.getTime() - start;
+
+    std::cout << rendered << " frames of " << copies << " monkeys (" << RenderContext::backendName(context.getBackend())
+              << (useIndirect ? ", indirect" : useQueue ? ", queued" : "") << "), " << seconds * 1000.0 / std::max(1, rendered) << " ms per frame, "
+              << rendered / std::max(seconds, 1e-9) << " fps" << std::endl;
+    timer.report(std::cout);
+    state.report(std::cout);
+    std::cout << "frustum culling per frame: " << culling.tested / std::max(1, rendered) << " meshes tested, "
+              << culling.visible / std::max(1, rendered) << " visible, " << culling.culled / std::max(1, rendered)
+              << " culled" << std::endl;
+    std::cout << "uniform ring: " << (uniforms.isPersistent() ? "persistently mapped" : "mapped per write") << ", "
+              << uniforms.getStalls() << " frames waited for the GPU" << std::endl;
+    if (useIndirect)
+        std::cout << "last frame: " << batches[0].getCommands() + batches[1].getCommands() << " indirect commands in "
+                  << batches[0].getCalls() + batches[1].getCalls() << " draw calls" << std::endl;
+
+    if (!capturePath.empty())
+    {
+        if (writeCapture(capturePath, quadCube.getFramebuffer(), SCR_WIDTH, SCR_HEIGHT))
+            std::cout << "Last frame written to " << capturePath << std::endl;
+        else
+            std::cout << "ERROR::FRAME_CAPTURE:: could not write " << capturePath << std::endl;
+    }
+
+    quadCube.deleteBuffers();
+    return 0;
+}
@@ -15,7 +15,10 @@
 #include "../util/Model.h"
 #include "../util/Material.h"
 #include "../util/CanvasCube.h"
+#include "../util/RenderState.h"
 #include "../util/MusicPlayer.h"
+#include "../util/UniformBlocks.h"
+#include "../util/UniformRing.h"
 
 int main(int argc, char* argv[])
 {
@@ -62,8 +65,8 @@ int main(int argc, char* argv[])
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    RenderState::shared().enable(GL_DEPTH_TEST);
+    RenderState::shared().enable(GL_CULL_FACE);
 
     // add all monkey to my world
     // --------------------------------
@@ -72,9 +75,11 @@ int main(int argc, char* argv[])
     // add the shader to my monkeys
     // --------------------------------
     Shader shaderMonkey(FileSystem::getPath("Shaders/material_vertex.vs").c_str(), FileSystem::getPath("Shaders/material_fragment.fs").c_str());
+    bindUniformBlocks(shaderMonkey);
     // if want i add the texture to my monkeys
     // --------------------------------
     Material material = Materials::TURQUOISE;
+    MaterialBlock materialBlock(material);
     // know i create my canvas, which is the cube
     // ---------------------------------------------
 
@@ -86,6 +91,19 @@ int main(int argc, char* argv[])
     float linearDistance = 0.09f;
     float quadraticDistance = 0.032f;
 
+    // the spotlight follows the camera, everything else about it stays
+    SpotLightBlock spotLight;
+    spotLight.ambient = ligthConstant;
+    spotLight.diffuse = ligthConstant;
+    spotLight.specular = ligthConstant;
+    spotLight.constant = constantDistance;
+    spotLight.linear = linearDistance;
+    spotLight.quadratic = quadraticDistance;
+    spotLight.cutOff = cutOffCostant;
+    spotLight.outerCutOff = outerCutOffCostant;
+    // camera, light and material go to the shaders as uniform blocks, a memcpy each per frame
+    UniformRing uniforms;
+
     CanvasCube quadCube;
     quadCube.initCanvas();
 
@@ -111,11 +129,20 @@ int main(int argc, char* argv[])
         return -1;
     }
     
+    // decode while playing, the whole track is never in memory
+    player.setStreaming(true);
+
     if (!player.loadMusic(musicFile)) {
         std::cerr << "Failed to load music file: " << musicFile << std::endl;
         return -1;
     }
     
+    Frustum frustum;
+    LodState monkeyLods;
+
+    // playback and analysis run on the player's audio thread, the loop only polls
+    player.start();
+    PlaybackState music = PlaybackState();
 
     // render loop
     // -----------
@@ -128,14 +155,18 @@ int main(int argc, char* argv[])
         lastFrame = currentFrame;
         frameMovement = static_cast<float>(camera.GetSpeedCamera() * deltaTime);
 
+        // upload the model textures decoded in the background, 2 ms per frame at most
+        // ------------------------------------------------------------------------
+        TextureStreamer::shared().update(2.0);
+
         // input
         // -----
         //processInput(window);
 
         // FIRST PASS: render scene to framebuffer
         // ========================================
-        glBindFramebuffer(GL_FRAMEBUFFER, quadCube.getFramebuffer());
-        glEnable(GL_DEPTH_TEST);
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, quadCube.getFramebuffer());
+        RenderState::shared().enable(GL_DEPTH_TEST);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -148,51 +179,46 @@ int main(int argc, char* argv[])
         // define my project o need it to pass from te 
         glm::mat4 projectionMatrix = glm::perspective(glm::radians(camera.Zoom),(float)SCR_WIDTH/(float)SCR_HEIGHT,0.1f,100.f);
         glm::mat4 viewMatrix = camera.GetViewMatrix();
+        // meshes out of view are skipped before they cost any draw call
+        frustum.update(projectionMatrix * viewMatrix);
 
 
         
         shaderMonkey.use();
-        
-        player.play();
-
-        
-        
-        shaderMonkey.setVec3("spotLight.position", camera.Position);
-        shaderMonkey.setVec3("spotLight.direction", camera.Front);
-        shaderMonkey.setVec3("spotLight.ambient", ligthConstant);
-        shaderMonkey.setVec3("spotLight.diffuse", ligthConstant);
-        shaderMonkey.setVec3("spotLight.specular", ligthConstant);
-
-        shaderMonkey.setFloat("spotLight.constant", constantDistance);
-        shaderMonkey.setFloat("spotLight.linear", linearDistance);
-        shaderMonkey.setFloat("spotLight.quadratic", quadraticDistance);
-        shaderMonkey.setFloat("spotLight.cutOff", cutOffCostant);
-        shaderMonkey.setFloat("spotLight.outerCutOff", outerCutOffCostant);
-
-        // Add after setting spotlight uniforms:
-        shaderMonkey.setVec3("material.ambient", material.ambient);
-        shaderMonkey.setVec3("material.diffuse", material.diffuse);
-        shaderMonkey.setVec3("material.specular", material.specular);
-        shaderMonkey.setFloat("material.shininess", material.shininess);
 
+        // newest analysis from the audio thread, never waits for it
+        player.poll(music);
 
-        shaderMonkey.setMat4("projection",projectionMatrix);
-        shaderMonkey.setMat4("view",viewMatrix);
-        shaderMonkey.setVec3("viewPos",camera.Position);
+        uniforms.beginFrame();
+        spotLight.position = camera.Position;
+        spotLight.direction = camera.Front;
+        uniforms.bind(LIGHT_BLOCK_BINDING, spotLight);
+        uniforms.bind(MATERIAL_BLOCK_BINDING, materialBlock);
+        uniforms.bind(FRAME_BLOCK_BINDING, FrameBlock(projectionMatrix, viewMatrix, camera.Position));
 
 
         // now i need the final matrix that one who move my young boy model
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model,glm::vec3(0.0f));
-        model = glm::scale(model,glm::vec3(1.0f));
+        // the monkey pulses with the loudness of the music
+        float pulse = music.hasAnalysis ? (float)music.analysis.overallRMS : 0.0f;
+        // and kicks on every beat, dying out before the next one
+        if (music.beat.bpm > 0.0)
+        {
+            float sinceBeat = 1.0f - (float)music.beat.phaseAt(music.seconds);
+            pulse += 0.15f * sinceBeat * sinceBeat * sinceBeat;
+        }
+        model = glm::scale(model,glm::vec3(1.0f + pulse));
         
         shaderMonkey.setMat4("model",model);
-        moneyTest.Draw(shaderMonkey);
+        moneyTest.Draw(shaderMonkey, camera, model, (float)SCR_HEIGHT, frustum, 1.0f, &monkeyLods);
+        // the GPU is done with this frame's blocks once it gets past here
+        uniforms.endFrame();
         
         // SECOND PASS: now draw framebuffer texture to screen
         // ===================================================
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST); // disable depth test for screen-space quad
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        RenderState::shared().disable(GL_DEPTH_TEST); // disable depth test for screen-space quad
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
         quadCube.useCanvas();
@@ -202,7 +228,9 @@ int main(int argc, char* argv[])
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
+    player.stop();
     quadCube.deleteBuffers();
+    uniforms.deleteBuffers();
 
     // glfw: terminate
     // ---------------
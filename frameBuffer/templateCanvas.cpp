@@ -15,6 +15,7 @@
 #include "../util/Model.h"
 #include "../util/Material.h"
 #include "../util/CanvasCube.h"
+#include "../util/RenderState.h"
 
 int main()
 {
@@ -61,8 +62,8 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    RenderState::shared().enable(GL_DEPTH_TEST);
+    RenderState::shared().enable(GL_CULL_FACE);
 
     // add all monkey to my world
     // --------------------------------
@@ -95,8 +96,8 @@ int main()
 
         // FIRST PASS: render scene to framebuffer
         // ========================================
-        glBindFramebuffer(GL_FRAMEBUFFER, quadCube.getFramebuffer());
-        glEnable(GL_DEPTH_TEST);
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, quadCube.getFramebuffer());
+        RenderState::shared().enable(GL_DEPTH_TEST);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -107,8 +108,8 @@ int main()
         // ---------------------------------------------------
         // SECOND PASS: now draw framebuffer texture to screen
         // ===================================================
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST); // disable depth test for screen-space quad
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        RenderState::shared().disable(GL_DEPTH_TEST); // disable depth test for screen-space quad
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
         quadCube.useCanvas();
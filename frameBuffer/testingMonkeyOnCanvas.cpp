@@ -15,6 +15,9 @@
 #include "../util/Model.h"
 #include "../util/Material.h"
 #include "../util/CanvasCube.h"
+#include "../util/RenderState.h"
+#include "../util/UniformBlocks.h"
+#include "../util/UniformRing.h"
 
 int main()
 {
@@ -61,8 +64,8 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    RenderState::shared().enable(GL_DEPTH_TEST);
+    RenderState::shared().enable(GL_CULL_FACE);
 
     // add all monkey to my world
     // --------------------------------
@@ -71,9 +74,11 @@ int main()
     // add the shader to my monkeys
     // --------------------------------
     Shader shaderMonkey(FileSystem::getPath("Shaders/material_vertex.vs").c_str(), FileSystem::getPath("Shaders/material_fragment.fs").c_str());
+    bindUniformBlocks(shaderMonkey);
     // if want i add the texture to my monkeys
     // --------------------------------
     Material material = Materials::TURQUOISE;
+    MaterialBlock materialBlock(material);
     // know i create my canvas, which is the cube
     // ---------------------------------------------
 
@@ -85,6 +90,18 @@ int main()
     float linearDistance = 0.09f;
     float quadraticDistance = 0.032f;
 
+    // the spotlight follows the camera, everything else about it stays
+    SpotLightBlock spotLight;
+    spotLight.ambient = ligthConstant;
+    spotLight.diffuse = ligthConstant;
+    spotLight.specular = ligthConstant;
+    spotLight.constant = constantDistance;
+    spotLight.linear = linearDistance;
+    spotLight.quadratic = quadraticDistance;
+    spotLight.cutOff = cutOffCostant;
+    spotLight.outerCutOff = outerCutOffCostant;
+    UniformRing uniforms;
+
     CanvasCube quadCube;
     quadCube.initCanvas();
 
@@ -99,14 +116,18 @@ int main()
         lastFrame = currentFrame;
         frameMovement = static_cast<float>(camera.GetSpeedCamera() * deltaTime);
 
+        // upload the model textures decoded in the background, 2 ms per frame at most
+        // ------------------------------------------------------------------------
+        TextureStreamer::shared().update(2.0);
+
         // input
         // -----
         processInput(window);
 
         // FIRST PASS: render scene to framebuffer
         // ========================================
-        glBindFramebuffer(GL_FRAMEBUFFER, quadCube.getFramebuffer());
-        glEnable(GL_DEPTH_TEST);
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, quadCube.getFramebuffer());
+        RenderState::shared().enable(GL_DEPTH_TEST);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -121,32 +142,12 @@ int main()
         glm::mat4 viewMatrix = camera.GetViewMatrix();
 
         shaderMonkey.use();
-        shaderMonkey.setVec3("spotLight.position", camera.Position);
-        shaderMonkey.setVec3("spotLight.direction", camera.Front);
-        shaderMonkey.setVec3("spotLight.ambient", ligthConstant);
-        shaderMonkey.setVec3("spotLight.diffuse", ligthConstant);
-        shaderMonkey.setVec3("spotLight.specular", ligthConstant);
-
-        shaderMonkey.setFloat("spotLight.constant", constantDistance);
-        shaderMonkey.setFloat("spotLight.linear", linearDistance);
-        shaderMonkey.setFloat("spotLight.quadratic", quadraticDistance);
-        shaderMonkey.setFloat("spotLight.cutOff", cutOffCostant);
-        shaderMonkey.setFloat("spotLight.outerCutOff", outerCutOffCostant);
-
-        // Add after setting spotlight uniforms:
-        shaderMonkey.setVec3("material.ambient", material.ambient);
-        shaderMonkey.setVec3("material.diffuse", material.diffuse);
-        shaderMonkey.setVec3("material.specular", material.specular);
-        shaderMonkey.setFloat("material.shininess", material.shininess);
-
-
-        
-
-
-
-        shaderMonkey.setMat4("projection",projectionMatrix);
-        shaderMonkey.setMat4("view",viewMatrix);
-        shaderMonkey.setVec3("viewPos",camera.Position);
+        uniforms.beginFrame();
+        spotLight.position = camera.Position;
+        spotLight.direction = camera.Front;
+        uniforms.bind(LIGHT_BLOCK_BINDING, spotLight);
+        uniforms.bind(MATERIAL_BLOCK_BINDING, materialBlock);
+        uniforms.bind(FRAME_BLOCK_BINDING, FrameBlock(projectionMatrix, viewMatrix, camera.Position));
 
 
         // now i need the final matrix that one who move my young boy model
@@ -156,11 +157,12 @@ int main()
         
         shaderMonkey.setMat4("model",model);
         moneyTest.Draw(shaderMonkey);
+        uniforms.endFrame();
         
         // SECOND PASS: now draw framebuffer texture to screen
         // ===================================================
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST); // disable depth test for screen-space quad
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        RenderState::shared().disable(GL_DEPTH_TEST); // disable depth test for screen-space quad
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
         quadCube.useCanvas();
@@ -171,6 +173,7 @@ int main()
         glfwPollEvents();
     }
     quadCube.deleteBuffers();
+    uniforms.deleteBuffers();
 
     // glfw: terminate
     // ---------------
@@ -0,0 +1,348 @@
+#ifndef ANALYSISCACHE_H
+#define ANALYSISCACHE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "AudioDecoder.h"
+#include "AudioFeatures.h"
+#include "StftAnalyzer.h"
+#include "ThreadPool.h"
+
+// bump this every time the layout of the file (or of struct AnalysisFrame) changes,
+// old sidecars are then simply ignored and rebuilt
+#define AUDIO_ANALYSIS_CACHE_VERSION 3
+
+// the analysis of one hop, the frame of the STFT that ends with it. Its band levels
+// are stored apart (bandsAt()), their count depends on the filterbank
+struct AnalysisFrame
+{
+    float bass;
+    float mid;
+    float treble;
+    float rms;
+    float peak;
+    float centroid; // Hz
+    float rolloff;  // Hz, 85% of the energy below
+    float flux;     // magnitude increase since the previous hop
+    float onset;    // AudioFeatures::onsetStrength, what BeatTracker runs on
+};
+
+// Whole-track analysis computed ahead of time: one AnalysisFrame per STFT hop, in a
+// sidecar file next to the audio (<audio>.analysis) that is memory mapped at runtime.
+// The file is keyed by a hash of the audio file's bytes and by the STFT and filterbank
+// settings, so a different file or different settings mean a rebuild. Looking up the
+// analysis of a playback position is then one index computation, no FFT.
+class AnalysisCache
+{
+public:
+    AnalysisCache() : mapped(nullptr), mappedSize(0), frames(nullptr), bandLevels(nullptr), frameCount(0), bandCount(0),
+                      sampleRate(0), hopSize(0) {}
+
+    ~AnalysisCache()
+    {
+        close();
+    }
+
+    AnalysisCache(const AnalysisCache &) = delete;
+    AnalysisCache &operator=(const AnalysisCache &) = delete;
+
+    static std::string getCachePath(const std::string &audioPath)
+    {
+        return audioPath + ".analysis";
+    }
+
+    // 64 bit FNV-1a of the file contents, 0 if it can not be read
+    static uint64_t hashFile(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return 0;
+        uint64_t hash = 14695981039346656037ull;
+        std::vector<char> block(1 << 20);
+        while (file)
+        {
+            file.read(block.data(), block.size());
+            std::streamsize got = file.gcount();
+            for (std::streamsize i = 0; i < got; i++)
+            {
+                hash ^= (unsigned char)block[i];
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+
+    // maps the sidecar of audioPath, false if it is missing, stale or made with other settings
+    bool open(const std::string &audioPath, size_t frameSize, size_t hop, WindowFunction window,
+              const FilterbankConfig &bands = FilterbankConfig())
+    {
+        close();
+
+        int fd = ::open(getCachePath(audioPath).c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Header))
+        {
+            ::close(fd);
+            return false;
+        }
+        mappedSize = (size_t)info.st_size;
+        mapped = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            mapped = nullptr;
+            mappedSize = 0;
+            return false;
+        }
+
+        Header header;
+        std::memcpy(&header, mapped, sizeof(header));
+        bool valid = std::memcmp(header.magic, MAGIC, sizeof(header.magic)) == 0 &&
+                     header.version == AUDIO_ANALYSIS_CACHE_VERSION &&
+                     header.frameBytes == sizeof(AnalysisFrame) &&
+                     header.frameSize == frameSize && header.hopSize == hop &&
+                     header.window == (uint32_t)window &&
+                     header.bandScale == (uint32_t)bands.scale && header.bandConfigCount == bands.bandCount &&
+                     header.minHz == bands.minHz && header.maxHz == bands.maxHz &&
+                     sizeof(Header) + header.frameCount * (sizeof(AnalysisFrame) + header.bandCount * sizeof(float)) <= mappedSize &&
+                     header.audioHash == hashFile(audioPath);
+        if (!valid)
+        {
+            close();
+            return false;
+        }
+
+        frames = reinterpret_cast<const AnalysisFrame *>(static_cast<const unsigned char *>(mapped) + sizeof(Header));
+        frameCount = (size_t)header.frameCount;
+        bandLevels = reinterpret_cast<const float *>(frames + frameCount);
+        bandCount = (size_t)header.bandCount;
+        bandConfig = bands;
+        sampleRate = (int)header.sampleRate;
+        hopSize = (size_t)header.hopSize;
+        return true;
+    }
+
+    // open(), building the sidecar first if that fails
+    bool openOrBuild(const std::string &audioPath, size_t frameSize, size_t hop, WindowFunction window,
+                     const FilterbankConfig &bands = FilterbankConfig())
+    {
+        if (open(audioPath, frameSize, hop, window, bands))
+            return true;
+        return build(audioPath, frameSize, hop, window, bands) && open(audioPath, frameSize, hop, window, bands);
+    }
+
+    void close()
+    {
+        if (mapped)
+        {
+            munmap(mapped, mappedSize);
+            mapped = nullptr;
+            mappedSize = 0;
+        }
+        frames = nullptr;
+        bandLevels = nullptr;
+        frameCount = 0;
+        bandCount = 0;
+    }
+
+    bool isOpen() const
+    {
+        return frames != nullptr;
+    }
+
+    // the hop that ended last at this playback position, nullptr before the first or past the end
+    const AnalysisFrame *at(double seconds) const
+    {
+        if (!frames || seconds < 0.0)
+            return nullptr;
+        size_t played = (size_t)(seconds * sampleRate / hopSize);
+        if (played == 0 || played > frameCount)
+            return nullptr;
+        return frames + played - 1;
+    }
+
+    // position of a frame at() returned, hop i ends at sample (i + 1) * hop
+    size_t indexOf(const AnalysisFrame *frame) const
+    {
+        return (size_t)(frame - frames);
+    }
+
+    // the getBandCount() band levels of a frame at() returned
+    const float *bandsAt(const AnalysisFrame *frame) const
+    {
+        return bandLevels + (size_t)(frame - frames) * bandCount;
+    }
+
+    size_t getFrameCount() const { return frameCount; }
+    size_t getBandCount() const { return bandCount; }
+    // the filterbank the band levels were made with
+    const FilterbankConfig &getBands() const { return bandConfig; }
+    size_t getHopSize() const { return hopSize; }
+    int getSampleRate() const { return sampleRate; }
+
+    // decodes audioPath, analyzes every hop on all cores and writes the sidecar
+    static bool build(const std::string &audioPath, size_t frameSize, size_t hop, WindowFunction window,
+                      const FilterbankConfig &bands = FilterbankConfig())
+    {
+        uint64_t audioHash = hashFile(audioPath);
+        std::unique_ptr<AudioDecoder> decoder = openAudioDecoder(audioPath);
+        if (!decoder || audioHash == 0)
+            return false;
+
+        // the whole track as mono, the only part that has to run in order
+        int rate = decoder->getSampleRate();
+        std::vector<float> mono;
+        decodeMono(*decoder, mono);
+
+        // only whole hops, chunks of hops spread over the pool. Each chunk first runs
+        // the frame that precedes it through its own STFT, so a chunk gives exactly
+        // what one STFT over the whole track would
+        size_t total = mono.size() / hop;
+        size_t bandCount = Filterbank(bands, rate, frameSize).getBandCount();
+        std::vector<AnalysisFrame> result(total);
+        std::vector<float> levels(total * bandCount);
+        const size_t chunkHops = 256;
+        size_t chunks = (total + chunkHops - 1) / chunkHops;
+        ThreadPool::shared().parallelFor(chunks, [&](size_t chunk)
+                                         { analyzeHops(mono, chunk * chunkHops, std::min(total, (chunk + 1) * chunkHops),
+                                                       rate, frameSize, hop, window, bands, result, levels); });
+
+        return write(audioPath, audioHash, rate, frameSize, hop, window, bands, bandCount, result, levels);
+    }
+
+private:
+    static constexpr char MAGIC[4] = {'A', 'A', 'C', 'H'};
+
+    // the frames follow right after it, 8 byte aligned like the mapping, then the
+    // band levels, bandCount floats per frame
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t audioHash;
+        uint32_t sampleRate;
+        uint32_t frameSize;
+        uint32_t hopSize;
+        uint32_t window;
+        uint32_t frameBytes;
+        uint32_t bandScale;
+        int32_t bandConfigCount;
+        uint32_t bandCount;
+        double minHz;
+        double maxHz;
+        uint64_t frameCount;
+    };
+
+    void *mapped;
+    size_t mappedSize;
+    const AnalysisFrame *frames;
+    const float *bandLevels;
+    size_t frameCount;
+    size_t bandCount;
+    FilterbankConfig bandConfig;
+    int sampleRate;
+    size_t hopSize;
+
+    // fills result[firstHop, endHop) and their band levels
+    static void analyzeHops(const std::vector<float> &mono, size_t firstHop, size_t endHop, int rate,
+                            size_t frameSize, size_t hop, WindowFunction window, const FilterbankConfig &bands,
+                            std::vector<AnalysisFrame> &result, std::vector<float> &bandLevels)
+    {
+        size_t warmupHops = (frameSize + hop - 1) / hop;
+        size_t hopIndex = firstHop > warmupHops ? firstHop - warmupHops : 0;
+
+        StftAnalyzer stft(frameSize, hop, window);
+        std::vector<float> previous(frameSize / 2 + 1, 0.0f);
+        std::vector<float> previousLog(frameSize / 2 + 1, 0.0f);
+        AudioAnalysis levels = AudioAnalysis();
+        BandAnalyzer bandAnalyzer;
+        bandAnalyzer.configure(bands, rate, frameSize);
+        size_t bandCount = bandAnalyzer.getBands().getBandCount();
+        auto onFrame = [&](const StftAnalyzer &analyzer)
+        {
+            const std::vector<float> &magnitudes = analyzer.getMagnitudes();
+            double onset = AudioFeatures::onsetStrength(magnitudes.data(), previousLog.data(), frameSize);
+            if (hopIndex >= firstHop)
+            {
+                bandAnalyzer.analyze(magnitudes.data(), levels);
+                AnalysisFrame &frame = result[hopIndex];
+                frame.bass = (float)levels.bassLevel;
+                frame.mid = (float)levels.midLevel;
+                frame.treble = (float)levels.trebleLevel;
+                frame.rms = analyzer.getRMS();
+                frame.peak = analyzer.getPeak();
+                frame.centroid = (float)AudioFeatures::spectralCentroid(magnitudes.data(), frameSize, rate);
+                frame.rolloff = (float)AudioFeatures::spectralRolloff(magnitudes.data(), frameSize, rate);
+                frame.flux = (float)AudioFeatures::spectralFlux(magnitudes.data(), previous.data(), frameSize);
+                frame.onset = (float)onset;
+                for (size_t band = 0; band < bandCount; band++)
+                    bandLevels[hopIndex * bandCount + band] = (float)levels.frequencyBands[band];
+            }
+            previous = magnitudes;
+            hopIndex++;
+        };
+        stft.push(mono.data() + hopIndex * hop, (endHop - hopIndex) * hop, onFrame);
+    }
+
+    static bool write(const std::string &audioPath, uint64_t audioHash, int rate, size_t frameSize, size_t hop,
+                      WindowFunction window, const FilterbankConfig &bands, size_t bandCount,
+                      const std::vector<AnalysisFrame> &result, const std::vector<float> &bandLevels)
+    {
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+        header.version = AUDIO_ANALYSIS_CACHE_VERSION;
+        header.audioHash = audioHash;
+        header.sampleRate = (uint32_t)rate;
+        header.frameSize = (uint32_t)frameSize;
+        header.hopSize = (uint32_t)hop;
+        header.window = (uint32_t)window;
+        header.frameBytes = sizeof(AnalysisFrame);
+        header.bandScale = (uint32_t)bands.scale;
+        header.bandConfigCount = bands.bandCount;
+        header.bandCount = (uint32_t)bandCount;
+        header.minHz = bands.minHz;
+        header.maxHz = bands.maxHz;
+        header.frameCount = result.size();
+
+        // write to a temporary file first and rename it, so a crash half way
+        // through never leaves a truncated sidecar that looks valid
+        std::string cachePath = getCachePath(audioPath);
+        std::string temporaryPath = cachePath + ".tmp";
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cout << "WARNING::ANALYSIS_CACHE:: could not write " << cachePath << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(result.data()), result.size() * sizeof(AnalysisFrame));
+        file.write(reinterpret_cast<const char *>(bandLevels.data()), bandLevels.size() * sizeof(float));
+        file.close();
+        if (!file)
+        {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, cachePath, error);
+        return !error;
+    }
+};
+
+#endif
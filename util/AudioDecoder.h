@@ -0,0 +1,344 @@
+#ifndef AUDIODECODER_H
+#define AUDIODECODER_H
+
+#include <sndfile.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <cmath>
+#include "AudioSimd.h"
+
+// declarations only, MusicPlayer.h compiles the implementation
+#include "minimp3.h"
+#include "Mp3FrameIndex.h"
+
+// Pull decoder for streaming playback: hands out interleaved 16 bit PCM a piece
+// at a time, so only the piece being decoded is ever in memory.
+class AudioDecoder
+{
+public:
+    virtual ~AudioDecoder() {}
+
+    // reads up to frames frames (frames * channels samples) into out,
+    // returns how many were read, 0 once the track is over
+    virtual size_t read(short *out, size_t frames) = 0;
+    // continue reading at this frame
+    virtual bool seek(size_t frame) = 0;
+
+    int getSampleRate() const { return sampleRate; }
+    int getChannels() const { return channels; }
+    // can be an estimate for formats without a frame count in the header (MP3)
+    size_t getTotalFrames() const { return totalFrames; }
+    const std::string &getFormatName() const { return formatName; }
+
+protected:
+    int sampleRate = 0;
+    int channels = 0;
+    size_t totalFrames = 0;
+    std::string formatName;
+};
+
+// MP3 through minimp3, reading the file in small blocks instead of all at once.
+// The frame index built on open gives the exact length and direct seeks
+class Mp3StreamDecoder : public AudioDecoder
+{
+public:
+    bool open(const std::string &filePath)
+    {
+        file.open(filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cerr << "Error: Could not open MP3 file: " << filePath << std::endl;
+            return false;
+        }
+        if (!index.buildFromFile(filePath))
+        {
+            std::cerr << "Error: No audio data decoded from MP3 file" << std::endl;
+            return false;
+        }
+        sampleRate = index.getSampleRate();
+        channels = index.getChannels();
+        totalFrames = index.getTotalSamples();
+        formatName = "MP3";
+        return seek(0);
+    }
+
+    size_t read(short *out, size_t frames) override
+    {
+        size_t done = 0;
+        while (done < frames)
+        {
+            if (pendingFrames == 0 && !decodeNextFrame())
+                break;
+            size_t take = std::min(frames - done, pendingFrames);
+            std::memcpy(out + done * channels, pcm + pendingOffset * channels, take * channels * sizeof(short));
+            pendingOffset += take;
+            pendingFrames -= take;
+            done += take;
+        }
+        return done;
+    }
+
+    // straight to the MPEG frame holding it, only the frames its bit reservoir
+    // reaches back to are decoded first
+    bool seek(size_t frame) override
+    {
+        if (frame >= totalFrames)
+            return false;
+        size_t target = index.frameForSample(frame);
+        mp3dec_init(&decoder);
+        pendingOffset = pendingFrames = 0;
+        nextFrame = index.decodeStart(target);
+        while (nextFrame <= target)
+        {
+            if (!decodeNextFrame())
+                return false;
+        }
+        size_t skip = frame - index.getFrame(target).sample;
+        pendingOffset = skip;
+        pendingFrames -= std::min(skip, pendingFrames);
+        return true;
+    }
+
+private:
+    static const size_t INPUT_BLOCK = 16 * 1024;
+
+    Mp3FrameIndex index;
+    std::ifstream file;
+    mp3dec_t decoder;
+    mp3dec_frame_info_t frameInfo;
+
+    // file bytes [inputOffset, inputOffset + inputBytes)
+    std::vector<uint8_t> input;
+    size_t inputOffset = 0;
+    size_t inputBytes = 0;
+    size_t nextFrame = 0;
+
+    short pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+    size_t pendingOffset = 0;
+    size_t pendingFrames = 0;
+
+    // the bytes of one frame, the file is read a block at a time from there
+    const uint8_t *frameBytes(const Mp3FrameIndex::Frame &frame)
+    {
+        if (frame.offset < inputOffset || frame.offset + frame.bytes > inputOffset + inputBytes)
+        {
+            input.resize(INPUT_BLOCK);
+            file.clear();
+            file.seekg((std::streamoff)frame.offset, std::ios::beg);
+            file.read(reinterpret_cast<char *>(input.data()), input.size());
+            inputOffset = frame.offset;
+            inputBytes = (size_t)file.gcount();
+            if (inputBytes < frame.bytes)
+                return nullptr;
+        }
+        return input.data() + (frame.offset - inputOffset);
+    }
+
+    bool decodeNextFrame()
+    {
+        if (nextFrame >= index.getFrameCount())
+            return false;
+        const Mp3FrameIndex::Frame &frame = index.getFrame(nextFrame++);
+        const uint8_t *bytes = frameBytes(frame);
+        if (!bytes)
+            return false;
+        int samples = mp3dec_decode_frame(&decoder, bytes, frame.bytes, pcm, &frameInfo);
+        // a damaged frame (or one whose reservoir is not there yet) plays as silence,
+        // so every position stays where the index says
+        if (samples <= 0 || frameInfo.channels != channels)
+        {
+            samples = index.getSamplesPerFrame();
+            std::memset(pcm, 0, (size_t)samples * channels * sizeof(short));
+        }
+        pendingOffset = 0;
+        pendingFrames = (size_t)samples;
+        return true;
+    }
+};
+
+// everything libsndfile reads (WAV, FLAC, OGG, AIFF, AU)
+class SndfileStreamDecoder : public AudioDecoder
+{
+public:
+    ~SndfileStreamDecoder()
+    {
+        if (file)
+            sf_close(file);
+    }
+
+    bool open(const std::string &filePath)
+    {
+        std::memset(&info, 0, sizeof(info));
+        file = sf_open(filePath.c_str(), SFM_READ, &info);
+        if (!file)
+        {
+            std::cerr << "Error: Could not open file: " << filePath << std::endl;
+            std::cerr << "libsndfile error: " << sf_strerror(nullptr) << std::endl;
+            return false;
+        }
+        sampleRate = info.samplerate;
+        channels = info.channels;
+        totalFrames = (size_t)info.frames;
+
+        switch (info.format & SF_FORMAT_TYPEMASK)
+        {
+        case SF_FORMAT_WAV:
+            formatName = "WAV";
+            break;
+        case SF_FORMAT_FLAC:
+            formatName = "FLAC";
+            break;
+        case SF_FORMAT_OGG:
+            formatName = "OGG";
+            break;
+        case SF_FORMAT_AIFF:
+            formatName = "AIFF";
+            break;
+        case SF_FORMAT_AU:
+            formatName = "AU";
+            break;
+        default:
+            formatName = "Unknown";
+            break;
+        }
+        return true;
+    }
+
+    size_t read(short *out, size_t frames) override
+    {
+        sf_count_t got = sf_readf_short(file, out, (sf_count_t)frames);
+        return got > 0 ? (size_t)got : 0;
+    }
+
+    bool seek(size_t frame) override
+    {
+        return sf_seek(file, (sf_count_t)frame, SEEK_SET) >= 0;
+    }
+
+private:
+    SNDFILE *file = nullptr;
+    SF_INFO info;
+};
+
+// Folds more channels down to stereo, for surround tracks OpenAL has no format for.
+// Channels are taken in WAV order (FL FR FC LFE BL BR SL SR, the layouts libsndfile
+// reports); centre and surrounds go in at -3 dB, LFE is dropped, and each side is
+// scaled so it can not clip
+class StereoDownmix
+{
+public:
+    explicit StereoDownmix(int channelCount) : channels(channelCount), left(std::max(8, channelCount), 0), right(std::max(8, channelCount), 0)
+    {
+        std::vector<float> leftGains(channels, 0.0f), rightGains(channels, 0.0f);
+        const float side = 0.7071f;
+        // side of each channel by channel count: 'L', 'R', 'C' both, 'X' dropped.
+        // Unknown counts alternate left and right
+        static const char *LAYOUTS[] = {nullptr, nullptr, nullptr, "LRC", "LRLR", "LRCLR", "LRCXLR", "LRCXCLR", "LRCXLRLR"};
+        const char *layout = channels < 9 ? LAYOUTS[channels] : nullptr;
+        for (int c = 0; c < channels; c++)
+        {
+            char position = layout ? layout[c] : (c % 2 == 0 ? 'L' : 'R');
+            float gain = c < 2 ? 1.0f : side;
+            if (position == 'L' || position == 'C')
+                leftGains[c] = gain;
+            if (position == 'R' || position == 'C')
+                rightGains[c] = gain;
+        }
+        float leftSum = 0.0f, rightSum = 0.0f;
+        for (int c = 0; c < channels; c++)
+        {
+            leftSum += leftGains[c];
+            rightSum += rightGains[c];
+        }
+        // Q15 for the integer kernels, the sums stay under 1.0 so nothing clips
+        for (int c = 0; c < channels; c++)
+        {
+            left[c] = (short)std::min(32767L, std::lround(leftGains[c] / std::max(1.0f, leftSum) * 32768.0f));
+            right[c] = (short)std::min(32767L, std::lround(rightGains[c] / std::max(1.0f, rightSum) * 32768.0f));
+        }
+    }
+
+    // frames interleaved frames to stereo, out may be in (it is written behind the reads)
+    void apply(const short *in, short *out, size_t frames) const
+    {
+        AudioSimd::kernels().downmix(in, out, frames, channels, left.data(), right.data());
+    }
+
+private:
+    int channels;
+    // Q15 gains, zero past the channels up to 8 as AudioKernels::downmix reads
+    std::vector<short> left;
+    std::vector<short> right;
+};
+
+// a decoder that hands out the stereo downmix of another one
+class DownmixDecoder : public AudioDecoder
+{
+public:
+    explicit DownmixDecoder(std::unique_ptr<AudioDecoder> source) : input(std::move(source)), downmix(input->getChannels())
+    {
+        sampleRate = input->getSampleRate();
+        channels = 2;
+        totalFrames = input->getTotalFrames();
+        formatName = input->getFormatName();
+    }
+
+    size_t read(short *out, size_t frames) override
+    {
+        scratch.resize(frames * input->getChannels());
+        size_t got = input->read(scratch.data(), frames);
+        downmix.apply(scratch.data(), out, got);
+        return got;
+    }
+
+    bool seek(size_t frame) override
+    {
+        return input->seek(frame);
+    }
+
+private:
+    std::unique_ptr<AudioDecoder> input;
+    StereoDownmix downmix;
+    std::vector<short> scratch;
+};
+
+// the rest of the track as mono floats in -1..1, channels averaged
+inline void decodeMono(AudioDecoder &decoder, std::vector<float> &mono)
+{
+    const size_t BLOCK = 4096;
+    int channels = decoder.getChannels();
+    mono.reserve(mono.size() + decoder.getTotalFrames());
+    std::vector<short> block(BLOCK * channels);
+    while (size_t got = decoder.read(block.data(), BLOCK))
+    {
+        size_t end = mono.size();
+        mono.resize(end + got);
+        AudioSimd::kernels().toMono(block.data(), mono.data() + end, got, channels);
+    }
+}
+
+// the decoder for filePath, picked by its extension. nullptr if it can not be opened
+inline std::unique_ptr<AudioDecoder> openAudioDecoder(const std::string &filePath)
+{
+    std::string extension = filePath.substr(filePath.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == "mp3")
+    {
+        std::unique_ptr<Mp3StreamDecoder> mp3(new Mp3StreamDecoder());
+        if (!mp3->open(filePath))
+            return nullptr;
+        return mp3;
+    }
+    std::unique_ptr<SndfileStreamDecoder> other(new SndfileStreamDecoder());
+    if (!other->open(filePath))
+        return nullptr;
+    return other;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef AUDIOFEATURES_H
+#define AUDIOFEATURES_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include "Filterbank.h"
+
+struct AudioAnalysis
+{
+    double bassLevel;                   // 20-250 Hz
+    double midLevel;                    // 250-4000 Hz
+    double trebleLevel;                 // 4000-20000 Hz
+    double overallRMS;                  // Root Mean Square (volume)
+    double peakLevel;                   // Peak amplitude
+    double dynamicRange;                // Difference between peak and average
+    std::vector<double> frequencyBands; // one level per band of the filterbank in use
+};
+
+// bass/mid/treble and the frequency bands of an AudioAnalysis from the magnitudes of
+// one FFT frame. Both filterbanks are built once and only rebuilt when the sample
+// rate, FFT size or band config changes
+class BandAnalyzer
+{
+public:
+    void configure(const FilterbankConfig &config, int sampleRate, size_t fftSize)
+    {
+        static const std::vector<double> edges = {20.0, 250.0, 4000.0, 20000.0};
+        levels.configureRanges(edges, sampleRate, fftSize);
+        bands.configure(config, sampleRate, fftSize);
+    }
+
+    void analyze(const float *magnitudes, AudioAnalysis &analysis) const
+    {
+        double threeLevels[3];
+        levels.apply(magnitudes, threeLevels);
+        analysis.bassLevel = threeLevels[0];
+        analysis.midLevel = threeLevels[1];
+        analysis.trebleLevel = threeLevels[2];
+        analysis.frequencyBands.resize(bands.getBandCount());
+        bands.apply(magnitudes, analysis.frequencyBands.data());
+    }
+
+    const Filterbank &getBands() const { return bands; }
+
+private:
+    Filterbank levels;
+    Filterbank bands;
+};
+
+// Features computed from the magnitudes (bins 0..fftSize/2) of one FFT frame,
+// shared by the live analysis and the precomputed one (AnalysisCache.h)
+namespace AudioFeatures
+{
+    // magnitude weighted mean frequency in Hz, where the "brightness" of the sound sits
+    inline double spectralCentroid(const float *magnitudes, size_t fftSize, int sampleRate)
+    {
+        double binSize = (double)sampleRate / fftSize;
+        double weighted = 0.0, total = 0.0;
+        for (size_t i = 1; i <= fftSize / 2; i++)
+        {
+            weighted += i * binSize * magnitudes[i];
+            total += magnitudes[i];
+        }
+        return total > 0.0 ? weighted / total : 0.0;
+    }
+
+    // frequency in Hz below which fraction of the spectral energy lies
+    inline double spectralRolloff(const float *magnitudes, size_t fftSize, int sampleRate, double fraction = 0.85)
+    {
+        double energy = 0.0;
+        for (size_t i = 1; i <= fftSize / 2; i++)
+            energy += (double)magnitudes[i] * magnitudes[i];
+        double threshold = energy * fraction, running = 0.0;
+        for (size_t i = 1; i <= fftSize / 2; i++)
+        {
+            running += (double)magnitudes[i] * magnitudes[i];
+            if (running >= threshold)
+                return i * (double)sampleRate / fftSize;
+        }
+        return 0.0;
+    }
+
+    // spectral flux on log compressed magnitudes, the onset detection function of
+    // BeatTracker: soft notes count next to loud ones. previousLog holds the log
+    // magnitudes of the previous frame (zeros at first) and is updated
+    inline double onsetStrength(const float *magnitudes, float *previousLog, size_t fftSize)
+    {
+        double flux = 0.0;
+        for (size_t i = 1; i <= fftSize / 2; i++)
+        {
+            float compressed = std::log1p(100.0f * magnitudes[i]);
+            flux += std::max(0.0f, compressed - previousLog[i]);
+            previousLog[i] = compressed;
+        }
+        return flux / (fftSize / 2);
+    }
+
+    // sum of the magnitude increases since the previous frame, peaks at note onsets
+    inline double spectralFlux(const float *magnitudes, const float *previous, size_t fftSize)
+    {
+        double flux = 0.0;
+        for (size_t i = 1; i <= fftSize / 2; i++)
+            flux += std::max(0.0f, magnitudes[i] - previous[i]);
+        return flux;
+    }
+}
+
+#endif
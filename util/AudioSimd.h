@@ -0,0 +1,642 @@
+#ifndef AUDIOSIMD_H
+#define AUDIOSIMD_H
+
+#include <cstddef>
+#include <cmath>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define AUDIOSIMD_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define AUDIOSIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Vectorized float kernels for the audio analysis path. Complex values are
+// interleaved (re, im), the same layout as std::complex<float>; PCM comes in as
+// interleaved 16 bit samples and is turned into mono floats in -1..1 once.
+// The best instruction set is picked once at runtime: AVX2+FMA or SSE2 on x86
+// (the AVX2 kernels are compiled with a target attribute, so no -mavx2 is needed),
+// NEON on aarch64, plain C++ everywhere else.
+struct AudioKernels
+{
+    const char *name;
+
+    // one radix-2 stage on half complex pairs: t = w[k] * b[k], a[k] += t, b[k] = a[k] - t
+    void (*butterflies)(float *a, float *b, const float *w, size_t half);
+    // out[k] = |value[k]| for count complex values
+    void (*magnitudes)(const float *values, float *out, size_t count);
+    // out[i] = mean of the channels of interleaved frame i, scaled to -1..1
+    void (*toMono)(const short *in, float *out, size_t frames, int channels);
+    // interleaved frames to stereo with Q15 gains per channel, out[2i] = sum of
+    // left[c] * in[i][c] rounded. The gains are padded with zeros to 8 channels at least.
+    // out may be in, every frame is read before its stereo pair is written
+    void (*downmix)(const short *in, short *out, size_t frames, int channels, const short *left, const short *right);
+    // adds the squares of samples to *sumSquares and raises *peak to their largest magnitude
+    void (*levels)(const float *samples, size_t count, double *sumSquares, float *peak);
+    // out[i] = a[i] * b[i], e.g. a frame times its window
+    void (*multiply)(const float *a, const float *b, float *out, size_t count);
+};
+
+namespace AudioSimd
+{
+    inline void butterfliesScalar(float *a, float *b, const float *w, size_t half)
+    {
+        for (size_t k = 0; k < half; k++)
+        {
+            float wr = w[2 * k], wi = w[2 * k + 1];
+            float br = b[2 * k], bi = b[2 * k + 1];
+            float tr = wr * br - wi * bi;
+            float ti = wr * bi + wi * br;
+            float ar = a[2 * k], ai = a[2 * k + 1];
+            a[2 * k] = ar + tr;
+            a[2 * k + 1] = ai + ti;
+            b[2 * k] = ar - tr;
+            b[2 * k + 1] = ai - ti;
+        }
+    }
+
+    inline void magnitudesScalar(const float *values, float *out, size_t count)
+    {
+        for (size_t k = 0; k < count; k++)
+            out[k] = std::sqrt(values[2 * k] * values[2 * k] + values[2 * k + 1] * values[2 * k + 1]);
+    }
+
+    inline void toMonoScalar(const short *in, float *out, size_t frames, int channels)
+    {
+        float scale = 1.0f / (32768.0f * channels);
+        for (size_t i = 0; i < frames; i++)
+        {
+            int sum = 0;
+            for (int c = 0; c < channels; c++)
+                sum += in[i * channels + c];
+            out[i] = sum * scale;
+        }
+    }
+
+    // a Q15 weighted sum back to 16 bit, rounded half up
+    inline short fromQ15(int sum)
+    {
+        return (short)std::min(32767, std::max(-32768, (sum + (1 << 14)) >> 15));
+    }
+
+    inline void downmixScalar(const short *in, short *out, size_t frames, int channels, const short *left, const short *right)
+    {
+        for (size_t i = 0; i < frames; i++)
+        {
+            int l = 0, r = 0;
+            for (int c = 0; c < channels; c++)
+            {
+                l += left[c] * in[i * channels + c];
+                r += right[c] * in[i * channels + c];
+            }
+            out[2 * i] = fromQ15(l);
+            out[2 * i + 1] = fromQ15(r);
+        }
+    }
+
+    inline void levelsScalar(const float *samples, size_t count, double *sumSquares, float *peak)
+    {
+        double sum = 0.0;
+        float largest = *peak;
+        for (size_t i = 0; i < count; i++)
+        {
+            sum += (double)samples[i] * samples[i];
+            largest = std::max(largest, std::fabs(samples[i]));
+        }
+        *sumSquares += sum;
+        *peak = largest;
+    }
+
+    inline void multiplyScalar(const float *a, const float *b, float *out, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            out[i] = a[i] * b[i];
+    }
+
+    // the vector kernels sum squares in float registers, emptied into the double
+    // total every LEVELS_BLOCK samples so long buffers keep their precision
+    const size_t LEVELS_BLOCK = 1024;
+
+#ifdef AUDIOSIMD_X86
+    // 2 complex values per register
+    inline void butterfliesSSE(float *a, float *b, const float *w, size_t half)
+    {
+        const __m128 sign = _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+        size_t k = 0;
+        for (; k + 2 <= half; k += 2)
+        {
+            __m128 va = _mm_loadu_ps(a + 2 * k);
+            __m128 vb = _mm_loadu_ps(b + 2 * k);
+            __m128 vw = _mm_loadu_ps(w + 2 * k);
+            __m128 wr = _mm_shuffle_ps(vw, vw, _MM_SHUFFLE(2, 2, 0, 0));
+            __m128 wi = _mm_shuffle_ps(vw, vw, _MM_SHUFFLE(3, 3, 1, 1));
+            __m128 swapped = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 3, 0, 1));
+            // (br wr - bi wi, bi wr + br wi)
+            __m128 t = _mm_add_ps(_mm_mul_ps(vb, wr), _mm_mul_ps(_mm_mul_ps(swapped, wi), sign));
+            _mm_storeu_ps(a + 2 * k, _mm_add_ps(va, t));
+            _mm_storeu_ps(b + 2 * k, _mm_sub_ps(va, t));
+        }
+        butterfliesScalar(a + 2 * k, b + 2 * k, w + 2 * k, half - k);
+    }
+
+    inline void magnitudesSSE(const float *values, float *out, size_t count)
+    {
+        size_t k = 0;
+        for (; k + 4 <= count; k += 4)
+        {
+            __m128 v0 = _mm_loadu_ps(values + 2 * k);
+            __m128 v1 = _mm_loadu_ps(values + 2 * k + 4);
+            __m128 re = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 im = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(out + k, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im))));
+        }
+        magnitudesScalar(values + 2 * k, out + k, count - k);
+    }
+
+    // [sum of a, sum of b, sum of c, sum of d]
+    inline __m128i horizontalSumsSSE(__m128i a, __m128i b, __m128i c, __m128i d)
+    {
+        __m128i ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+        __m128i cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+        return _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+    }
+
+    // 1 in the lanes of the channels, 0 in the lanes of the next frame
+    inline __m128i channelOnesSSE(int channels)
+    {
+        __m128i lanes = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+        return _mm_and_si128(_mm_cmplt_epi16(lanes, _mm_set1_epi16((short)channels)), _mm_set1_epi16(1));
+    }
+
+    inline __m128i loadFrameSSE(const short *frame)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(frame));
+    }
+
+    // stereo: pmaddwd adds the left and right sample of 4 frames to 32 bit in one go.
+    // up to 8 channels: one frame per register (the load runs into the next frame),
+    // pmaddwd against ones for the channels only, then 4 frames summed across at once
+    inline void toMonoSSE(const short *in, float *out, size_t frames, int channels)
+    {
+        size_t i = 0;
+        if (channels == 1)
+        {
+            const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+            for (; i + 8 <= frames; i += 8)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+                __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+                __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+                _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+                _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+            }
+        }
+        else if (channels == 2)
+        {
+            const __m128 scale = _mm_set1_ps(1.0f / 65536.0f);
+            const __m128i ones = _mm_set1_epi16(1);
+            for (; i + 4 <= frames; i += 4)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 2 * i));
+                _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_madd_epi16(v, ones)), scale));
+            }
+        }
+        else if (channels <= 8)
+        {
+            const __m128 scale = _mm_set1_ps(1.0f / (32768.0f * channels));
+            const __m128i ones = channelOnesSSE(channels);
+            for (; (i + 3) * channels + 8 <= frames * channels; i += 4)
+            {
+                const short *frame = in + i * channels;
+                __m128i sums = horizontalSumsSSE(_mm_madd_epi16(loadFrameSSE(frame), ones),
+                                                 _mm_madd_epi16(loadFrameSSE(frame + channels), ones),
+                                                 _mm_madd_epi16(loadFrameSSE(frame + 2 * channels), ones),
+                                                 _mm_madd_epi16(loadFrameSSE(frame + 3 * channels), ones));
+                _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(sums), scale));
+            }
+        }
+        toMonoScalar(in + i * channels, out + i, frames - i, channels);
+    }
+
+    // one frame per register like toMono, pmaddwd against the left and the right gains
+    // (zero past the channels), 4 frames rounded and packed back to interleaved 16 bit
+    inline void downmixSSE(const short *in, short *out, size_t frames, int channels, const short *left, const short *right)
+    {
+        size_t i = 0;
+        if (channels <= 8)
+        {
+            const __m128i gainsLeft = loadFrameSSE(left);
+            const __m128i gainsRight = loadFrameSSE(right);
+            const __m128i half = _mm_set1_epi32(1 << 14);
+            for (; (i + 3) * channels + 8 <= frames * channels; i += 4)
+            {
+                const short *frame = in + i * channels;
+                __m128i f0 = loadFrameSSE(frame);
+                __m128i f1 = loadFrameSSE(frame + channels);
+                __m128i f2 = loadFrameSSE(frame + 2 * channels);
+                __m128i f3 = loadFrameSSE(frame + 3 * channels);
+                __m128i l = horizontalSumsSSE(_mm_madd_epi16(f0, gainsLeft), _mm_madd_epi16(f1, gainsLeft),
+                                              _mm_madd_epi16(f2, gainsLeft), _mm_madd_epi16(f3, gainsLeft));
+                __m128i r = horizontalSumsSSE(_mm_madd_epi16(f0, gainsRight), _mm_madd_epi16(f1, gainsRight),
+                                              _mm_madd_epi16(f2, gainsRight), _mm_madd_epi16(f3, gainsRight));
+                l = _mm_srai_epi32(_mm_add_epi32(l, half), 15);
+                r = _mm_srai_epi32(_mm_add_epi32(r, half), 15);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i),
+                                 _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r)));
+            }
+        }
+        downmixScalar(in + i * channels, out + 2 * i, frames - i, channels, left, right);
+    }
+
+    inline void levelsSSE(const float *samples, size_t count, double *sumSquares, float *peak)
+    {
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 largest = _mm_set1_ps(*peak);
+        size_t i = 0;
+        while (i + 4 <= count)
+        {
+            size_t end = std::min(count & ~(size_t)3, i + LEVELS_BLOCK);
+            __m128 sum = _mm_setzero_ps();
+            for (; i < end; i += 4)
+            {
+                __m128 v = _mm_loadu_ps(samples + i);
+                sum = _mm_add_ps(sum, _mm_mul_ps(v, v));
+                largest = _mm_max_ps(largest, _mm_and_ps(v, absMask));
+            }
+            float lanes[4];
+            _mm_storeu_ps(lanes, sum);
+            *sumSquares += (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, largest);
+        *peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+        levelsScalar(samples + i, count - i, sumSquares, peak);
+    }
+
+    inline void multiplySSE(const float *a, const float *b, float *out, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        multiplyScalar(a + i, b + i, out + i, count - i);
+    }
+
+    // 4 complex values per register
+    __attribute__((target("avx2,fma"))) inline void butterfliesAVX2(float *a, float *b, const float *w, size_t half)
+    {
+        size_t k = 0;
+        for (; k + 4 <= half; k += 4)
+        {
+            __m256 va = _mm256_loadu_ps(a + 2 * k);
+            __m256 vb = _mm256_loadu_ps(b + 2 * k);
+            __m256 vw = _mm256_loadu_ps(w + 2 * k);
+            __m256 wr = _mm256_moveldup_ps(vw);
+            __m256 wi = _mm256_movehdup_ps(vw);
+            __m256 swapped = _mm256_permute_ps(vb, _MM_SHUFFLE(2, 3, 0, 1));
+            // even lanes b*wr - swapped*wi, odd lanes b*wr + swapped*wi
+            __m256 t = _mm256_fmaddsub_ps(vb, wr, _mm256_mul_ps(swapped, wi));
+            _mm256_storeu_ps(a + 2 * k, _mm256_add_ps(va, t));
+            _mm256_storeu_ps(b + 2 * k, _mm256_sub_ps(va, t));
+        }
+        butterfliesSSE(a + 2 * k, b + 2 * k, w + 2 * k, half - k);
+    }
+
+    __attribute__((target("avx2,fma"))) inline void magnitudesAVX2(const float *values, float *out, size_t count)
+    {
+        size_t k = 0;
+        for (; k + 8 <= count; k += 8)
+        {
+            __m256 v0 = _mm256_loadu_ps(values + 2 * k);
+            __m256 v1 = _mm256_loadu_ps(values + 2 * k + 8);
+            // shuffles work inside 128 bit lanes: this yields values 0 1 4 5 2 3 6 7
+            __m256 re = _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m256 im = _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+            __m256 magnitude = _mm256_sqrt_ps(_mm256_fmadd_ps(re, re, _mm256_mul_ps(im, im)));
+            magnitude = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(magnitude), _MM_SHUFFLE(3, 1, 2, 0)));
+            _mm256_storeu_ps(out + k, magnitude);
+        }
+        magnitudesSSE(values + 2 * k, out + k, count - k);
+    }
+
+    // horizontalSumsSSE in both halves: [sums of a..d of the low half | of the high half]
+    __attribute__((target("avx2,fma"))) inline __m256i horizontalSumsAVX2(__m256i a, __m256i b, __m256i c, __m256i d)
+    {
+        __m256i ab = _mm256_add_epi32(_mm256_unpacklo_epi32(a, b), _mm256_unpackhi_epi32(a, b));
+        __m256i cd = _mm256_add_epi32(_mm256_unpacklo_epi32(c, d), _mm256_unpackhi_epi32(c, d));
+        return _mm256_add_epi32(_mm256_unpacklo_epi64(ab, cd), _mm256_unpackhi_epi64(ab, cd));
+    }
+
+    // frame k in the low half, frame k + 4 in the high one
+    __attribute__((target("avx2,fma"))) inline __m256i loadFramesAVX2(const short *frame, int channels)
+    {
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(loadFrameSSE(frame)), loadFrameSSE(frame + 4 * channels), 1);
+    }
+
+    __attribute__((target("avx2,fma"))) inline void toMonoAVX2(const short *in, float *out, size_t frames, int channels)
+    {
+        size_t i = 0;
+        if (channels == 1)
+        {
+            const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+            for (; i + 8 <= frames; i += 8)
+            {
+                __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+                _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+            }
+        }
+        else if (channels == 2)
+        {
+            const __m256 scale = _mm256_set1_ps(1.0f / 65536.0f);
+            const __m256i ones = _mm256_set1_epi16(1);
+            for (; i + 8 <= frames; i += 8)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + 2 * i));
+                _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(v, ones)), scale));
+            }
+        }
+        else if (channels <= 8)
+        {
+            const __m256 scale = _mm256_set1_ps(1.0f / (32768.0f * channels));
+            const __m256i ones = _mm256_broadcastsi128_si256(channelOnesSSE(channels));
+            for (; (i + 7) * channels + 8 <= frames * channels; i += 8)
+            {
+                const short *frame = in + i * channels;
+                __m256i sums = horizontalSumsAVX2(_mm256_madd_epi16(loadFramesAVX2(frame, channels), ones),
+                                                  _mm256_madd_epi16(loadFramesAVX2(frame + channels, channels), ones),
+                                                  _mm256_madd_epi16(loadFramesAVX2(frame + 2 * channels, channels), ones),
+                                                  _mm256_madd_epi16(loadFramesAVX2(frame + 3 * channels, channels), ones));
+                _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(sums), scale));
+            }
+        }
+        toMonoSSE(in + i * channels, out + i, frames - i, channels);
+    }
+
+    // 8 frames per step, 2 per register; the in-lane unpacks and packs of the SSE
+    // version leave frames 0-3 in the low half and 4-7 in the high one, already in order
+    __attribute__((target("avx2,fma"))) inline void downmixAVX2(const short *in, short *out, size_t frames, int channels, const short *left, const short *right)
+    {
+        size_t i = 0;
+        if (channels <= 8)
+        {
+            const __m256i gainsLeft = _mm256_broadcastsi128_si256(loadFrameSSE(left));
+            const __m256i gainsRight = _mm256_broadcastsi128_si256(loadFrameSSE(right));
+            const __m256i half = _mm256_set1_epi32(1 << 14);
+            for (; (i + 7) * channels + 8 <= frames * channels; i += 8)
+            {
+                const short *frame = in + i * channels;
+                __m256i f0 = loadFramesAVX2(frame, channels);
+                __m256i f1 = loadFramesAVX2(frame + channels, channels);
+                __m256i f2 = loadFramesAVX2(frame + 2 * channels, channels);
+                __m256i f3 = loadFramesAVX2(frame + 3 * channels, channels);
+                __m256i l = horizontalSumsAVX2(_mm256_madd_epi16(f0, gainsLeft), _mm256_madd_epi16(f1, gainsLeft),
+                                               _mm256_madd_epi16(f2, gainsLeft), _mm256_madd_epi16(f3, gainsLeft));
+                __m256i r = horizontalSumsAVX2(_mm256_madd_epi16(f0, gainsRight), _mm256_madd_epi16(f1, gainsRight),
+                                               _mm256_madd_epi16(f2, gainsRight), _mm256_madd_epi16(f3, gainsRight));
+                l = _mm256_srai_epi32(_mm256_add_epi32(l, half), 15);
+                r = _mm256_srai_epi32(_mm256_add_epi32(r, half), 15);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * i),
+                                    _mm256_packs_epi32(_mm256_unpacklo_epi32(l, r), _mm256_unpackhi_epi32(l, r)));
+            }
+        }
+        downmixSSE(in + i * channels, out + 2 * i, frames - i, channels, left, right);
+    }
+
+    __attribute__((target("avx2,fma"))) inline void levelsAVX2(const float *samples, size_t count, double *sumSquares, float *peak)
+    {
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        __m256 largest = _mm256_set1_ps(*peak);
+        size_t i = 0;
+        while (i + 8 <= count)
+        {
+            size_t end = std::min(count & ~(size_t)7, i + LEVELS_BLOCK);
+            __m256 sum = _mm256_setzero_ps();
+            for (; i < end; i += 8)
+            {
+                __m256 v = _mm256_loadu_ps(samples + i);
+                sum = _mm256_fmadd_ps(v, v, sum);
+                largest = _mm256_max_ps(largest, _mm256_and_ps(v, absMask));
+            }
+            float lanes[8];
+            _mm256_storeu_ps(lanes, sum);
+            double total = 0.0;
+            for (float lane : lanes)
+                total += lane;
+            *sumSquares += total;
+        }
+        float lanes[8];
+        _mm256_storeu_ps(lanes, largest);
+        *peak = *std::max_element(lanes, lanes + 8);
+        levelsSSE(samples + i, count - i, sumSquares, peak);
+    }
+
+    __attribute__((target("avx2,fma"))) inline void multiplyAVX2(const float *a, const float *b, float *out, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        multiplySSE(a + i, b + i, out + i, count - i);
+    }
+#endif
+
+#ifdef AUDIOSIMD_NEON
+    // vld2q splits 4 complex values into a real and an imaginary register
+    inline void butterfliesNEON(float *a, float *b, const float *w, size_t half)
+    {
+        size_t k = 0;
+        for (; k + 4 <= half; k += 4)
+        {
+            float32x4x2_t va = vld2q_f32(a + 2 * k);
+            float32x4x2_t vb = vld2q_f32(b + 2 * k);
+            float32x4x2_t vw = vld2q_f32(w + 2 * k);
+            float32x4_t tr = vmlsq_f32(vmulq_f32(vw.val[0], vb.val[0]), vw.val[1], vb.val[1]);
+            float32x4_t ti = vmlaq_f32(vmulq_f32(vw.val[0], vb.val[1]), vw.val[1], vb.val[0]);
+            float32x4x2_t outA, outB;
+            outA.val[0] = vaddq_f32(va.val[0], tr);
+            outA.val[1] = vaddq_f32(va.val[1], ti);
+            outB.val[0] = vsubq_f32(va.val[0], tr);
+            outB.val[1] = vsubq_f32(va.val[1], ti);
+            vst2q_f32(a + 2 * k, outA);
+            vst2q_f32(b + 2 * k, outB);
+        }
+        butterfliesScalar(a + 2 * k, b + 2 * k, w + 2 * k, half - k);
+    }
+
+    inline void magnitudesNEON(const float *values, float *out, size_t count)
+    {
+        size_t k = 0;
+        for (; k + 4 <= count; k += 4)
+        {
+            float32x4x2_t v = vld2q_f32(values + 2 * k);
+            vst1q_f32(out + k, vsqrtq_f32(vmlaq_f32(vmulq_f32(v.val[0], v.val[0]), v.val[1], v.val[1])));
+        }
+        magnitudesScalar(values + 2 * k, out + k, count - k);
+    }
+
+    // [sum of a, sum of b, sum of c, sum of d]
+    inline int32x4_t horizontalSumsNEON(int32x4_t a, int32x4_t b, int32x4_t c, int32x4_t d)
+    {
+        return vpaddq_s32(vpaddq_s32(a, b), vpaddq_s32(c, d));
+    }
+
+    // the 8 samples at frame times the 8 gains, added in pairs to 32 bit
+    inline int32x4_t weightFrameNEON(int16x8_t frame, int16x8_t gains)
+    {
+        return vmlal_s16(vmull_s16(vget_low_s16(frame), vget_low_s16(gains)), vget_high_s16(frame), vget_high_s16(gains));
+    }
+
+    // vld2q splits 8 stereo frames into left and right, widened to 32 bit while adding.
+    // up to 8 channels: one frame per register, the next frame's samples masked off
+    inline void toMonoNEON(const short *in, float *out, size_t frames, int channels)
+    {
+        size_t i = 0;
+        if (channels == 1)
+        {
+            for (; i + 8 <= frames; i += 8)
+            {
+                int16x8_t v = vld1q_s16(in + i);
+                vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / 32768.0f));
+                vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / 32768.0f));
+            }
+        }
+        else if (channels == 2)
+        {
+            for (; i + 8 <= frames; i += 8)
+            {
+                int16x8x2_t v = vld2q_s16(in + 2 * i);
+                int32x4_t low = vaddl_s16(vget_low_s16(v.val[0]), vget_low_s16(v.val[1]));
+                int32x4_t high = vaddl_s16(vget_high_s16(v.val[0]), vget_high_s16(v.val[1]));
+                vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(low), 1.0f / 65536.0f));
+                vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(high), 1.0f / 65536.0f));
+            }
+        }
+        else if (channels <= 8)
+        {
+            static const int16_t LANES[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+            const int16x8_t mask = vreinterpretq_s16_u16(vcltq_s16(vld1q_s16(LANES), vdupq_n_s16((int16_t)channels)));
+            const float scale = 1.0f / (32768.0f * channels);
+            for (; (i + 3) * channels + 8 <= frames * channels; i += 4)
+            {
+                const short *frame = in + i * channels;
+                int32x4_t sums = horizontalSumsNEON(vpaddlq_s16(vandq_s16(vld1q_s16(frame), mask)),
+                                                    vpaddlq_s16(vandq_s16(vld1q_s16(frame + channels), mask)),
+                                                    vpaddlq_s16(vandq_s16(vld1q_s16(frame + 2 * channels), mask)),
+                                                    vpaddlq_s16(vandq_s16(vld1q_s16(frame + 3 * channels), mask)));
+                vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(sums), scale));
+            }
+        }
+        toMonoScalar(in + i * channels, out + i, frames - i, channels);
+    }
+
+    // vrshrq rounds the Q15 sums like fromQ15, vqmovn saturates and vst2 interleaves
+    inline void downmixNEON(const short *in, short *out, size_t frames, int channels, const short *left, const short *right)
+    {
+        size_t i = 0;
+        if (channels <= 8)
+        {
+            const int16x8_t gainsLeft = vld1q_s16(left);
+            const int16x8_t gainsRight = vld1q_s16(right);
+            for (; (i + 3) * channels + 8 <= frames * channels; i += 4)
+            {
+                const short *frame = in + i * channels;
+                int16x8_t f0 = vld1q_s16(frame);
+                int16x8_t f1 = vld1q_s16(frame + channels);
+                int16x8_t f2 = vld1q_s16(frame + 2 * channels);
+                int16x8_t f3 = vld1q_s16(frame + 3 * channels);
+                int32x4_t l = horizontalSumsNEON(weightFrameNEON(f0, gainsLeft), weightFrameNEON(f1, gainsLeft),
+                                                 weightFrameNEON(f2, gainsLeft), weightFrameNEON(f3, gainsLeft));
+                int32x4_t r = horizontalSumsNEON(weightFrameNEON(f0, gainsRight), weightFrameNEON(f1, gainsRight),
+                                                 weightFrameNEON(f2, gainsRight), weightFrameNEON(f3, gainsRight));
+                int16x4x2_t stereo = {{vqmovn_s32(vrshrq_n_s32(l, 15)), vqmovn_s32(vrshrq_n_s32(r, 15))}};
+                vst2_s16(out + 2 * i, stereo);
+            }
+        }
+        downmixScalar(in + i * channels, out + 2 * i, frames - i, channels, left, right);
+    }
+
+    inline void levelsNEON(const float *samples, size_t count, double *sumSquares, float *peak)
+    {
+        float32x4_t largest = vdupq_n_f32(*peak);
+        size_t i = 0;
+        while (i + 4 <= count)
+        {
+            size_t end = std::min(count & ~(size_t)3, i + LEVELS_BLOCK);
+            float32x4_t sum = vdupq_n_f32(0.0f);
+            for (; i < end; i += 4)
+            {
+                float32x4_t v = vld1q_f32(samples + i);
+                sum = vmlaq_f32(sum, v, v);
+                largest = vmaxq_f32(largest, vabsq_f32(v));
+            }
+            *sumSquares += vaddvq_f32(sum);
+        }
+        *peak = vmaxvq_f32(largest);
+        levelsScalar(samples + i, count - i, sumSquares, peak);
+    }
+
+    inline void multiplyNEON(const float *a, const float *b, float *out, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+            vst1q_f32(out + i, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+        multiplyScalar(a + i, b + i, out + i, count - i);
+    }
+#endif
+
+    inline AudioKernels select()
+    {
+#ifdef AUDIOSIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return AudioKernels{"AVX2", butterfliesAVX2, magnitudesAVX2, toMonoAVX2, downmixAVX2, levelsAVX2, multiplyAVX2};
+        return AudioKernels{"SSE2", butterfliesSSE, magnitudesSSE, toMonoSSE, downmixSSE, levelsSSE, multiplySSE};
+#elif defined(AUDIOSIMD_NEON)
+        return AudioKernels{"NEON", butterfliesNEON, magnitudesNEON, toMonoNEON, downmixNEON, levelsNEON, multiplyNEON};
+#else
+        return AudioKernels{"scalar", butterfliesScalar, magnitudesScalar, toMonoScalar, downmixScalar, levelsScalar, multiplyScalar};
+#endif
+    }
+
+    // the kernels for this CPU, chosen on first use
+    inline const AudioKernels &kernels()
+    {
+        static const AudioKernels selected = select();
+        return selected;
+    }
+
+    // cache line aligned storage, so vector loads of a buffer start on a line and
+    // never split one. Buffers are meant to be kept and resized, not reallocated per call
+    const size_t ALIGNMENT = 64;
+
+    template <typename T>
+    struct AlignedAllocator
+    {
+        typedef T value_type;
+
+        AlignedAllocator() {}
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U> &) {}
+
+        T *allocate(size_t count)
+        {
+            return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(ALIGNMENT)));
+        }
+        void deallocate(T *pointer, size_t)
+        {
+            ::operator delete(pointer, std::align_val_t(ALIGNMENT));
+        }
+
+        template <typename U>
+        bool operator==(const AlignedAllocator<U> &) const { return true; }
+        template <typename U>
+        bool operator!=(const AlignedAllocator<U> &) const { return false; }
+    };
+
+    template <typename T>
+    using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+}
+
+#endif
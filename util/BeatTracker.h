@@ -0,0 +1,309 @@
+#ifndef BEATTRACKER_H
+#define BEATTRACKER_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "StftAnalyzer.h"
+#include "AudioFeatures.h"
+
+// what the render thread gets about onsets and beats. The counts only grow: an event
+// happened since the last look when a count differs from the value seen then, so
+// none is lost however seldom the state is read
+struct BeatState
+{
+    unsigned long long onsetCount = 0;
+    unsigned long long beatCount = 0;
+    double lastOnsetSeconds = 0.0; // playback time of the latest onset
+    double lastBeatSeconds = 0.0;  // and of the latest beat
+    double bpm = 0.0;              // 0 until the tempo is known
+    double confidence = 0.0;       // of the tempo, 0..1
+    float onsetStrength = 0.0f;    // of the latest frame
+
+    // 0 on a beat rising to 1 just before the next one, for any playback time,
+    // so animation can follow the beat between two updates
+    double phaseAt(double seconds) const
+    {
+        if (bpm <= 0.0)
+            return 0.0;
+        double beats = (seconds - lastBeatSeconds) * bpm / 60.0;
+        return beats - std::floor(beats);
+    }
+};
+
+// a whole track analyzed at once, times in seconds
+struct BeatAnalysis
+{
+    double bpm = 0.0;
+    std::vector<double> onsets;
+    std::vector<double> beats;
+};
+
+// Causal onset detection and beat tracking on one onset strength value per STFT frame
+// (AudioFeatures::onsetStrength).
+// - onsets: a frame is one when its strength is the maximum of the last 30 ms, above
+//   the mean of the last 100 ms by a margin that follows the level of the last 2 s,
+//   and 50 ms after the previous onset. No look-ahead, so an onset is reported on the
+//   frame it shows up in.
+// - tempo: every 250 ms, the autocorrelation of the last 8 s of strength (plus half
+//   of it at twice the lag, against octave errors) weighted by a prior around 120 BPM;
+//   the phase is the offset where a comb at that period collects the most strength.
+// - beats are predicted from that grid and emitted on the frame they fall on, not
+//   after the fact, so their latency is zero once the tempo locked.
+class BeatTracker
+{
+public:
+    explicit BeatTracker(double framesPerSecond = 60.0)
+    {
+        configure(framesPerSecond);
+    }
+
+    // framesPerSecond: sample rate / STFT hop
+    void configure(double framesPerSecond, double newMinBpm = 60.0, double newMaxBpm = 200.0)
+    {
+        fps = framesPerSecond;
+        minBpm = newMinBpm;
+        maxBpm = newMaxBpm;
+        history.assign(std::max((size_t)16, (size_t)(HISTORY_SECONDS * fps)), 0.0f);
+        maxWindow = std::max((size_t)1, (size_t)std::lround(0.03 * fps));
+        meanWindow = std::max((size_t)2, (size_t)std::lround(0.1 * fps));
+        levelWindow = std::min(history.size(), std::max((size_t)4, (size_t)(2.0 * fps)));
+        minOnsetGap = std::max((size_t)1, (size_t)std::lround(0.05 * fps));
+        tempoInterval = std::max((size_t)1, (size_t)std::lround(0.25 * fps));
+        recent.resize(history.size());
+        correlation.resize(history.size());
+        reset();
+    }
+
+    // forget the signal, e.g. after a seek
+    void reset()
+    {
+        std::fill(history.begin(), history.end(), 0.0f);
+        frame = 0;
+        levelSum = 0.0;
+        lastOnsetFrame = -1e9;
+        period = 0.0;
+        nextBeatFrame = 0.0;
+        lastBeatFrame = -1e9;
+        state = BeatState();
+    }
+
+    // the strength of the next frame, whose centre is at this playback time.
+    // true if the frame is an onset or a beat
+    bool process(double strength, double seconds)
+    {
+        size_t slot = (size_t)(frame % history.size());
+        if (frame >= levelWindow)
+            levelSum -= history[(size_t)((frame - levelWindow) % history.size())];
+        history[slot] = (float)strength;
+        levelSum += strength;
+        state.onsetStrength = (float)strength;
+
+        bool event = detectOnset(strength, seconds);
+        if (frame + 1 >= (unsigned long long)(MIN_TEMPO_SECONDS * fps) && frame % tempoInterval == 0)
+            estimateTempo();
+
+        // the beat the grid puts on this frame
+        if (period > 0.0 && (double)frame >= nextBeatFrame - 0.5)
+        {
+            lastBeatFrame = nextBeatFrame;
+            state.lastBeatSeconds = seconds - ((double)frame - nextBeatFrame) / fps;
+            state.beatCount++;
+            nextBeatFrame += period;
+            event = true;
+        }
+        frame++;
+        return event;
+    }
+
+    const BeatState &getState() const
+    {
+        return state;
+    }
+
+    double getFramesPerSecond() const
+    {
+        return fps;
+    }
+
+    // the whole track through the same detector and tracker as playback, as fast as the
+    // FFTs go. For checking them against labeled beats (see StupidIdea/beat_eval.cpp)
+    static BeatAnalysis analyzeTrack(const float *mono, size_t count, int sampleRate,
+                                     double framesPerSecond = 100.0, size_t frameSize = 2048)
+    {
+        size_t hop = StftAnalyzer::hopForRate(sampleRate, framesPerSecond);
+        StftAnalyzer stft(frameSize, hop);
+        BeatTracker tracker((double)sampleRate / hop);
+        std::vector<float> previousLog(frameSize / 2 + 1, 0.0f);
+        BeatAnalysis result;
+
+        unsigned long long onsets = 0, beats = 0;
+        stft.push(mono, count, [&](const StftAnalyzer &analyzer)
+                  {
+                      double strength = AudioFeatures::onsetStrength(analyzer.getMagnitudes().data(), previousLog.data(), frameSize);
+                      double centre = ((double)analyzer.getFrameCount() * hop - frameSize / 2.0) / sampleRate;
+                      tracker.process(strength, centre);
+                      const BeatState &state = tracker.getState();
+                      if (state.onsetCount != onsets)
+                          result.onsets.push_back(state.lastOnsetSeconds);
+                      if (state.beatCount != beats)
+                          result.beats.push_back(state.lastBeatSeconds);
+                      onsets = state.onsetCount;
+                      beats = state.beatCount; });
+        result.bpm = tracker.getState().bpm;
+        return result;
+    }
+
+private:
+    static constexpr double HISTORY_SECONDS = 8.0;
+    static constexpr double MIN_TEMPO_SECONDS = 3.0;
+
+    double fps = 60.0;
+    double minBpm = 60.0;
+    double maxBpm = 200.0;
+
+    // the onset strength of the last HISTORY_SECONDS, frame f at f % size
+    std::vector<float> history;
+    unsigned long long frame = 0;
+    size_t maxWindow = 1, meanWindow = 2, levelWindow = 4, minOnsetGap = 1, tempoInterval = 1;
+    double levelSum = 0.0;
+    double lastOnsetFrame = -1e9;
+
+    // beat grid, in frames
+    double period = 0.0;
+    double nextBeatFrame = 0.0;
+    double lastBeatFrame = -1e9;
+
+    std::vector<float> recent;
+    std::vector<double> correlation;
+    BeatState state;
+
+    float past(size_t back) const
+    {
+        return history[(size_t)((frame - back) % history.size())];
+    }
+
+    bool detectOnset(double strength, double seconds)
+    {
+        size_t available = (size_t)std::min<unsigned long long>(frame, history.size() - 1);
+        double localMax = 0.0, localMean = 0.0;
+        size_t maxCount = std::min(maxWindow, available), meanCount = std::min(meanWindow, available);
+        for (size_t back = 1; back <= maxCount; back++)
+            localMax = std::max(localMax, (double)past(back));
+        for (size_t back = 1; back <= meanCount; back++)
+            localMean += past(back);
+        localMean /= std::max((size_t)1, meanCount);
+        double level = levelSum / std::min<unsigned long long>(frame + 1, levelWindow);
+
+        if (strength <= localMax || strength < localMean + 0.5 * level + 1e-4 ||
+            (double)frame - lastOnsetFrame <= (double)minOnsetGap)
+            return false;
+        lastOnsetFrame = (double)frame;
+        state.lastOnsetSeconds = seconds;
+        state.onsetCount++;
+        return true;
+    }
+
+    void estimateTempo()
+    {
+        size_t n = (size_t)std::min<unsigned long long>(frame + 1, history.size());
+        double mean = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            recent[i] = past(n - 1 - i); // oldest first
+            mean += recent[i];
+        }
+        mean /= n;
+
+        size_t minLag = std::max((size_t)1, (size_t)std::floor(fps * 60.0 / maxBpm));
+        size_t maxLag = std::min(n / 2, (size_t)std::ceil(fps * 60.0 / minBpm));
+        size_t lastLag = std::min(n - 1, 2 * maxLag + 1);
+        if (maxLag <= minLag + 1)
+            return;
+        for (size_t lag = 0; lag <= lastLag; lag++)
+        {
+            double sum = 0.0;
+            for (size_t i = lag; i < n; i++)
+                sum += (recent[i] - mean) * (recent[i - lag] - mean);
+            correlation[lag] = sum / (double)(n - lag);
+        }
+        if (correlation[0] <= 0.0)
+            return;
+
+        auto score = [&](size_t lag)
+        {
+            double bpm = fps * 60.0 / lag;
+            double octaves = std::log2(bpm / 120.0);
+            double weight = std::exp(-0.5 * octaves * octaves);
+            double twice = 2 * lag <= lastLag ? correlation[2 * lag] : 0.0;
+            return weight * (correlation[lag] + 0.5 * twice);
+        };
+        size_t best = minLag;
+        for (size_t lag = minLag + 1; lag <= maxLag; lag++)
+            if (score(lag) > score(best))
+                best = lag;
+        // stay with the current tempo while it is nearly as good, so the grid does not
+        // flip between a tempo and its double
+        size_t current = (size_t)std::lround(period);
+        if (period > 0.0 && current >= minLag && current <= maxLag && current != best &&
+            score(current) >= 0.9 * score(best))
+            best = current;
+        if (correlation[best] <= 0.0)
+            return;
+
+        // parabola through the neighbours for a fractional period
+        double refined = (double)best;
+        if (best > minLag && best < maxLag)
+        {
+            double left = score(best - 1), centre = score(best), right = score(best + 1);
+            double curvature = left - 2.0 * centre + right;
+            if (curvature < 0.0)
+                refined += 0.5 * (left - right) / curvature;
+        }
+        if (period > 0.0 && std::fabs(refined - period) < 0.05 * period)
+            period = 0.8 * period + 0.2 * refined;
+        else
+            period = refined;
+        state.bpm = fps * 60.0 / period;
+        state.confidence = std::min(1.0, correlation[best] / correlation[0]);
+
+        // phase: the offset back from now where the comb collects the most, recent beats weigh more
+        auto comb = [&](size_t phase)
+        {
+            double sum = 0.0, weight = 1.0;
+            for (double back = (double)phase; back < (double)n; back += period, weight *= 0.8)
+                sum += weight * recent[n - 1 - (size_t)std::lround(std::min(back, (double)(n - 1)))];
+            return sum;
+        };
+        size_t phases = std::max((size_t)1, (size_t)std::floor(period));
+        double bestComb = -1.0;
+        size_t bestPhase = 0;
+        for (size_t phase = 0; phase < phases; phase++)
+        {
+            double sum = comb(phase);
+            if (sum > bestComb)
+            {
+                bestComb = sum;
+                bestPhase = phase;
+            }
+        }
+        // keep the running grid unless the new phase is clearly better, otherwise a
+        // half tempo grid hops between the two beats it could sit on
+        if (state.beatCount > 0)
+        {
+            double since = std::fmod((double)frame - lastBeatFrame, period);
+            size_t current = (size_t)std::lround(since) % phases;
+            if (comb(current) >= 0.9 * bestComb)
+                bestPhase = current;
+        }
+
+        // first grid point from this frame on, never right after the beat just given
+        double anchor = (double)frame - (double)bestPhase;
+        double next = anchor + period * std::ceil(((double)frame - 0.5 - anchor) / period);
+        if (next - lastBeatFrame < 0.5 * period)
+            next += period;
+        nextBeatFrame = next;
+    }
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef QUADCUBE_H
 #define QUADCUBE_H
 #include "Shader.h"
+#include "RenderState.h"
 #include <iostream>
 #include <memory>
 #include "UtilDimension.h"
@@ -68,6 +69,10 @@ CanvasCube::~CanvasCube()
 
 void CanvasCube::deleteBuffers()
 {
+    RenderState &state = RenderState::shared();
+    state.forgetVertexArray(quadVAO);
+    state.forgetFramebuffer(framebuffer);
+    state.forgetTexture(textureColorbuffer);
     if (quadVAO != 0)
         glDeleteVertexArrays(1, &quadVAO);
     if (quadVBO != 0)
@@ -85,7 +90,8 @@ void CanvasCube::initCanvas()
     // Use class members directly - NO local variable declarations
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    RenderState &state = RenderState::shared();
+    state.bindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -95,11 +101,11 @@ void CanvasCube::initCanvas()
 
     // Framebuffer configuration
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    state.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
     // Create color attachment texture
     glGenTextures(1, &textureColorbuffer);
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
+    state.bindTexture(GL_TEXTURE_2D, textureColorbuffer);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -115,7 +121,7 @@ void CanvasCube::initCanvas()
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    state.bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // Configure shader
     shader->use(); // Can use -> instead of .get()->
@@ -124,11 +130,10 @@ void CanvasCube::initCanvas()
 
 void CanvasCube::useCanvas()
 {
-
+    RenderState &state = RenderState::shared();
     shader->use();
-    glBindVertexArray(quadVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
+    state.bindVertexArray(quadVAO);
+    state.bindTexture(0, GL_TEXTURE_2D, textureColorbuffer);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
@@ -0,0 +1,230 @@
+#ifndef FILTERBANK_H
+#define FILTERBANK_H
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+// how the bands of a Filterbank are spread over the spectrum
+enum class BandScale
+{
+    Linear,      // equal width in Hz, rectangular
+    Logarithmic, // equal width in octaves, rectangular
+    ThirdOctave, // the standard 1/3 octave bands around 1 kHz inside the range, bandCount is ignored
+    Mel          // overlapping triangles equally spaced in mel
+};
+
+struct FilterbankConfig
+{
+    BandScale scale = BandScale::Logarithmic;
+    int bandCount = 10;
+    double minHz = 20.0;
+    double maxHz = 20000.0;
+
+    bool operator==(const FilterbankConfig &other) const
+    {
+        return scale == other.scale && bandCount == other.bandCount && minHz == other.minHz && maxHz == other.maxHz;
+    }
+    bool operator!=(const FilterbankConfig &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// Maps the magnitudes of one FFT frame (bins 0..fftSize/2) to band levels. The
+// weights of every band are worked out once per sample rate, FFT size and config
+// and kept as a sparse matrix: the bins of a band are contiguous, so a row is its
+// first bin and a run of weights. Every row sums to 1, a band level is the weighted
+// mean magnitude of its bins, and bands narrower than a bin still get the bin they fall in.
+class Filterbank
+{
+public:
+    Filterbank() : sampleRate(0), fftSize(0), ranges(false) {}
+
+    Filterbank(const FilterbankConfig &config, int sampleRate, size_t fftSize) : Filterbank()
+    {
+        configure(config, sampleRate, fftSize);
+    }
+
+    // rebuilds the weights only if something changed
+    void configure(const FilterbankConfig &newConfig, int newSampleRate, size_t newFftSize)
+    {
+        if (!ranges && newConfig == config && newSampleRate == sampleRate && newFftSize == fftSize && !rowStart.empty())
+            return;
+        config = newConfig;
+        sampleRate = newSampleRate;
+        fftSize = newFftSize;
+        ranges = false;
+
+        double minHz = std::max(1.0, config.minHz);
+        double maxHz = std::max(minHz * 1.001, config.maxHz);
+        int count = std::max(1, config.bandCount);
+        std::vector<double> edges;
+        switch (config.scale)
+        {
+        case BandScale::Linear:
+            for (int i = 0; i <= count; i++)
+                edges.push_back(minHz + (maxHz - minHz) * i / count);
+            build(edges, false);
+            break;
+        case BandScale::Logarithmic:
+            for (int i = 0; i <= count; i++)
+                edges.push_back(minHz * std::pow(maxHz / minHz, (double)i / count));
+            build(edges, false);
+            break;
+        case BandScale::ThirdOctave:
+        {
+            // centres 1000 * 2^(k/3) Hz, edges a sixth of an octave either side. The range
+            // ends are rounded to the nearest centre, so 20 Hz - 20 kHz gives the usual 31 bands
+            int first = (int)std::lround(3.0 * std::log2(minHz / 1000.0));
+            int last = (int)std::lround(3.0 * std::log2(maxHz / 1000.0));
+            for (int k = first; k <= last + 1; k++)
+                edges.push_back(1000.0 * std::pow(2.0, (k - 0.5) / 3.0));
+            if (edges.size() < 2)
+                edges = {minHz, maxHz};
+            build(edges, false);
+            break;
+        }
+        case BandScale::Mel:
+        {
+            // count triangles need count + 2 corner points
+            double low = hzToMel(minHz), high = hzToMel(maxHz);
+            for (int i = 0; i <= count + 1; i++)
+                edges.push_back(melToHz(low + (high - low) * i / (count + 1)));
+            build(edges, true);
+            break;
+        }
+        }
+    }
+
+    // rectangular bands between consecutive edges, e.g. {20, 250, 4000, 20000} for bass/mid/treble
+    void configureRanges(const std::vector<double> &edgesHz, int newSampleRate, size_t newFftSize)
+    {
+        if (ranges && edgesHz == rangeEdges && newSampleRate == sampleRate && newFftSize == fftSize)
+            return;
+        sampleRate = newSampleRate;
+        fftSize = newFftSize;
+        ranges = true;
+        rangeEdges = edgesHz;
+        build(edgesHz, false);
+    }
+
+    // bands[b] = sum of weight * magnitude over the bins of band b
+    template <typename Level>
+    void apply(const float *magnitudes, Level *bands) const
+    {
+        for (size_t band = 0; band < firstBin.size(); band++)
+        {
+            const float *weight = weights.data() + rowStart[band];
+            const float *magnitude = magnitudes + firstBin[band];
+            size_t count = rowStart[band + 1] - rowStart[band];
+            float sum = 0.0f;
+            for (size_t i = 0; i < count; i++)
+                sum += weight[i] * magnitude[i];
+            bands[band] = sum;
+        }
+    }
+
+    size_t getBandCount() const { return firstBin.size(); }
+    double getLowHz(size_t band) const { return lowHz[band]; }
+    double getCenterHz(size_t band) const { return centerHz[band]; }
+    double getHighHz(size_t band) const { return highHz[band]; }
+    const FilterbankConfig &getConfig() const { return config; }
+    // stored weights, the cost of one apply()
+    size_t getWeightCount() const { return weights.size(); }
+
+    static double hzToMel(double hz) { return 2595.0 * std::log10(1.0 + hz / 700.0); }
+    static double melToHz(double mel) { return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0); }
+
+private:
+    FilterbankConfig config;
+    int sampleRate;
+    size_t fftSize;
+    bool ranges;
+    std::vector<double> rangeEdges;
+
+    // row b covers bins firstBin[b] .. with weights[rowStart[b], rowStart[b + 1])
+    std::vector<uint32_t> firstBin;
+    std::vector<uint32_t> rowStart;
+    std::vector<float> weights;
+    std::vector<double> lowHz, centerHz, highHz;
+
+    // rectangular: band b is [edges[b], edges[b + 1]), each bin weighted by how much of
+    // its width lies inside. triangular: band b rises from edges[b] to a peak at
+    // edges[b + 1] and falls to edges[b + 2]
+    void build(const std::vector<double> &edges, bool triangular)
+    {
+        firstBin.clear();
+        rowStart.assign(1, 0);
+        weights.clear();
+        lowHz.clear();
+        centerHz.clear();
+        highHz.clear();
+        if (sampleRate <= 0 || fftSize < 2)
+            return;
+
+        double binHz = (double)sampleRate / fftSize;
+        size_t lastBin = fftSize / 2;
+        size_t bands = edges.size() >= (triangular ? 3u : 2u) ? edges.size() - (triangular ? 2 : 1) : 0;
+        std::vector<float> row;
+        for (size_t band = 0; band < bands; band++)
+        {
+            double low = edges[band];
+            double high = edges[band + (triangular ? 2 : 1)];
+            double peak = triangular ? edges[band + 1] : 0.5 * (low + high);
+
+            // bins touching [low, high], the DC bin is never part of a band
+            size_t begin = std::max((size_t)1, (size_t)std::floor(low / binHz + 0.5));
+            size_t end = std::min(lastBin, (size_t)std::ceil(high / binHz + 0.5));
+            row.clear();
+            size_t first = begin;
+            double total = 0.0;
+            for (size_t bin = begin; bin <= end; bin++)
+            {
+                double weight;
+                if (triangular)
+                {
+                    double hz = bin * binHz;
+                    weight = hz <= peak ? (hz - low) / (peak - low) : (high - hz) / (high - peak);
+                }
+                else
+                {
+                    double overlap = std::min(high, (bin + 0.5) * binHz) - std::max(low, (bin - 0.5) * binHz);
+                    weight = overlap / binHz;
+                }
+                weight = std::max(0.0, weight);
+                if (row.empty() && weight == 0.0)
+                {
+                    first = bin + 1;
+                    continue;
+                }
+                row.push_back((float)weight);
+                total += weight;
+            }
+            while (!row.empty() && row.back() == 0.0f)
+                row.pop_back();
+
+            if (total <= 0.0)
+            {
+                // narrower than a bin: the bin its centre falls in
+                row.assign(1, 1.0f);
+                first = std::min(lastBin, std::max((size_t)1, (size_t)std::floor(peak / binHz + 0.5)));
+                total = 1.0;
+            }
+            for (float &weight : row)
+                weight = (float)(weight / total);
+
+            firstBin.push_back((uint32_t)first);
+            weights.insert(weights.end(), row.begin(), row.end());
+            rowStart.push_back((uint32_t)weights.size());
+            lowHz.push_back(low);
+            bool geometric = !ranges && config.scale != BandScale::Linear;
+            centerHz.push_back(geometric && !triangular ? std::sqrt(low * high) : peak);
+            highHz.push_back(high);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "FrameTimer.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace
+{
+    double percentile(std::vector<double> values, double fraction)
+    {
+        if (values.empty())
+            return 0.0;
+        size_t index = std::min(values.size() - 1, (size_t)(fraction * (values.size() - 1) + 0.5));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+    double mean(const std::vector<double> &values)
+    {
+        double sum = 0.0;
+        for (double value : values)
+            sum += value;
+        return values.empty() ? 0.0 : sum / values.size();
+    }
+
+    double maximum(const std::vector<double> &values)
+    {
+        return values.empty() ? 0.0 : *std::max_element(values.begin(), values.end());
+    }
+}
+
+FrameTimer::FrameTimer(size_t framesInFlight) : framesInFlight(std::max((size_t)1, framesInFlight)),
+                                                slots(this->framesInFlight), frameIndex(0), frameOpen(false),
+                                                currentPass(0), passQuery(0), frameQuery(0)
+{
+    passIndex("frame");
+}
+
+FrameTimer::~FrameTimer()
+{
+    for (std::vector<Sample> &samples : slots)
+    {
+        for (Sample &sample : samples)
+        {
+            freeQueries.push_back(sample.begin);
+            freeQueries.push_back(sample.end);
+        }
+    }
+    if (!freeQueries.empty())
+        glDeleteQueries((GLsizei)freeQueries.size(), freeQueries.data());
+}
+
+size_t FrameTimer::passIndex(const std::string &name)
+{
+    for (size_t i = 0; i < passNames.size(); i++)
+    {
+        if (passNames[i] == name)
+            return i;
+    }
+    passNames.push_back(name);
+    cpuTimes.emplace_back();
+    gpuTimes.emplace_back();
+    return passNames.size() - 1;
+}
+
+GLuint FrameTimer::timestamp()
+{
+    GLuint query;
+    if (freeQueries.empty())
+    {
+        glGenQueries(1, &query);
+    }
+    else
+    {
+        query = freeQueries.back();
+        freeQueries.pop_back();
+    }
+    glQueryCounter(query, GL_TIMESTAMP);
+    return query;
+}
+
+void FrameTimer::beginFrame()
+{
+    // the slot this frame reuses was written framesInFlight frames ago
+    collect(slots[frameIndex % framesInFlight]);
+    frameOpen = true;
+    frameStart = std::chrono::steady_clock::now();
+    frameQuery = timestamp();
+}
+
+void FrameTimer::beginPass(const std::string &name)
+{
+    currentPass = passIndex(name);
+    passQuery = timestamp();
+    passStart = std::chrono::steady_clock::now();
+}
+
+void FrameTimer::endPass()
+{
+    double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - passStart).count();
+    slots[frameIndex % framesInFlight].push_back(Sample{currentPass, cpuMs, passQuery, timestamp()});
+}
+
+void FrameTimer::endFrame()
+{
+    if (!frameOpen)
+        return;
+    double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    slots[frameIndex % framesInFlight].push_back(Sample{0, cpuMs, frameQuery, timestamp()});
+    frameOpen = false;
+    frameIndex++;
+}
+
+void FrameTimer::collect(std::vector<Sample> &samples)
+{
+    for (Sample &sample : samples)
+    {
+        // waits only if the GPU is more than framesInFlight frames behind
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(sample.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(sample.end, GL_QUERY_RESULT, &end);
+        cpuTimes[sample.pass].push_back(sample.cpuMs);
+        gpuTimes[sample.pass].push_back((double)(end - begin) / 1.0e6);
+        freeQueries.push_back(sample.begin);
+        freeQueries.push_back(sample.end);
+    }
+    samples.clear();
+}
+
+void FrameTimer::finish()
+{
+    for (std::vector<Sample> &samples : slots)
+        collect(samples);
+}
+
+void FrameTimer::clear()
+{
+    finish();
+    for (size_t i = 0; i < passNames.size(); i++)
+    {
+        cpuTimes[i].clear();
+        gpuTimes[i].clear();
+    }
+}
+
+std::vector<PassStatistics> FrameTimer::getStatistics() const
+{
+    std::vector<PassStatistics> statistics;
+    for (size_t i = 0; i < passNames.size(); i++)
+    {
+        const std::vector<double> &cpu = cpuTimes[i];
+        const std::vector<double> &gpu = gpuTimes[i];
+        statistics.push_back(PassStatistics{passNames[i], cpu.size(),
+                                            mean(cpu), percentile(cpu, 0.5), percentile(cpu, 0.95), maximum(cpu),
+                                            mean(gpu), percentile(gpu, 0.5), percentile(gpu, 0.95), maximum(gpu)});
+    }
+    return statistics;
+}
+
+void FrameTimer::report(std::ostream &out) const
+{
+    out << std::left << std::setw(12) << "pass" << std::right << std::setw(8) << "frames"
+        << std::setw(10) << "cpu mean" << std::setw(8) << "p50" << std::setw(8) << "p95" << std::setw(8) << "max"
+        << std::setw(10) << "gpu mean" << std::setw(8) << "p50" << std::setw(8) << "p95" << std::setw(8) << "max"
+        << "  (ms)" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for (const PassStatistics &pass : getStatistics())
+    {
+        out << std::left << std::setw(12) << pass.name << std::right << std::setw(8) << pass.frames
+            << std::setw(10) << pass.cpuMean << std::setw(8) << pass.cpuMedian << std::setw(8) << pass.cpu95
+            << std::setw(8) << pass.cpuMax
+            << std::setw(10) << pass.gpuMean << std::setw(8) << pass.gpuMedian << std::setw(8) << pass.gpu95
+            << std::setw(8) << pass.gpuMax << std::endl;
+    }
+}
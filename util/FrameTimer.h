@@ -0,0 +1,74 @@
+#ifndef FRAMETIMER_H
+#define FRAMETIMER_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+
+// milliseconds of one pass over the measured frames
+struct PassStatistics
+{
+    std::string name;
+    size_t frames;
+    double cpuMean, cpuMedian, cpu95, cpuMax; // submitting the pass on the CPU
+    double gpuMean, gpuMedian, gpu95, gpuMax; // executing it on the GPU
+};
+
+// CPU and GPU time of named passes, frame after frame. The CPU side is the time
+// between beginPass() and endPass() on the calling thread (what the driver costs to
+// queue the work), the GPU side comes from GL_TIMESTAMP queries written before and
+// after the pass. Query results are read framesInFlight frames later, when the GPU
+// is done with them, so measuring never stalls the pipeline.
+// Passes are told apart by name and can not nest; the whole frame is timed as "frame".
+class FrameTimer
+{
+public:
+    explicit FrameTimer(size_t framesInFlight = 4);
+    ~FrameTimer();
+
+    void beginFrame();
+    void beginPass(const std::string &name);
+    void endPass();
+    void endFrame();
+    // waits for the frames still in flight, call before getStatistics()
+    void finish();
+    // drops everything measured so far, e.g. after warming up
+    void clear();
+
+    std::vector<PassStatistics> getStatistics() const;
+    // a table of getStatistics()
+    void report(std::ostream &out) const;
+
+private:
+    struct Sample
+    {
+        size_t pass;
+        double cpuMs;
+        GLuint begin;
+        GLuint end;
+    };
+
+    size_t framesInFlight;
+    std::vector<std::vector<Sample>> slots; // the samples of the frames in flight
+    std::vector<GLuint> freeQueries;
+    size_t frameIndex;
+    bool frameOpen;
+
+    std::vector<std::string> passNames;
+    std::vector<std::vector<double>> cpuTimes; // by pass
+    std::vector<std::vector<double>> gpuTimes;
+
+    size_t currentPass;
+    std::chrono::steady_clock::time_point passStart;
+    GLuint passQuery;
+    std::chrono::steady_clock::time_point frameStart;
+    GLuint frameQuery;
+
+    size_t passIndex(const std::string &name);
+    GLuint timestamp();
+    void collect(std::vector<Sample> &samples);
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "Frustum.h"
+
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+
+Frustum::Frustum()
+{
+    for (int i = 0; i < 8; i++)
+    {
+        // planes that accept everything until the first update
+        planeX[i] = planeY[i] = planeZ[i] = 0.0f;
+        planeD[i] = 1.0f;
+    }
+    statistics = CullingStatistics{};
+}
+
+const CullingStatistics &Frustum::getStatistics() const
+{
+    return statistics;
+}
+
+bool Frustum::record(bool visible)
+{
+    statistics.tested++;
+    if (visible)
+        statistics.visible++;
+    else
+        statistics.culled++;
+    return visible;
+}
+
+void Frustum::addStatistics(const CullingStatistics &other)
+{
+    statistics.tested += other.tested;
+    statistics.visible += other.visible;
+    statistics.culled += other.culled;
+}
+
+void Frustum::update(const glm::mat4 &projectionView)
+{
+    statistics = CullingStatistics{};
+    const float *m = glm::value_ptr(projectionView);
+
+#ifdef FRUSTUM_SSE
+    // glm is column major: transposing the 4 columns gives the 4 rows
+    __m128 row0 = _mm_loadu_ps(m + 0);
+    __m128 row1 = _mm_loadu_ps(m + 4);
+    __m128 row2 = _mm_loadu_ps(m + 8);
+    __m128 row3 = _mm_loadu_ps(m + 12);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+    // left, right, bottom, top, near, far as (a, b, c, d)
+    __m128 left = _mm_add_ps(row3, row0);
+    __m128 right = _mm_sub_ps(row3, row0);
+    __m128 bottom = _mm_add_ps(row3, row1);
+    __m128 top = _mm_sub_ps(row3, row1);
+    __m128 nearPlane = _mm_add_ps(row3, row2);
+    __m128 farPlane = _mm_sub_ps(row3, row2);
+    __m128 padding0 = left;
+    __m128 padding1 = left;
+
+    // back to structure of arrays: x, y, z, d of 4 planes per register
+    _MM_TRANSPOSE4_PS(left, right, bottom, top);
+    _MM_TRANSPOSE4_PS(nearPlane, farPlane, padding0, padding1);
+
+    // normalize, so the plane distances are real distances (needed for the sphere radius)
+    __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(left, left), _mm_mul_ps(right, right)), _mm_mul_ps(bottom, bottom)));
+    _mm_store_ps(planeX, _mm_div_ps(left, length));
+    _mm_store_ps(planeY, _mm_div_ps(right, length));
+    _mm_store_ps(planeZ, _mm_div_ps(bottom, length));
+    _mm_store_ps(planeD, _mm_div_ps(top, length));
+
+    length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nearPlane, nearPlane), _mm_mul_ps(farPlane, farPlane)), _mm_mul_ps(padding0, padding0)));
+    _mm_store_ps(planeX + 4, _mm_div_ps(nearPlane, length));
+    _mm_store_ps(planeY + 4, _mm_div_ps(farPlane, length));
+    _mm_store_ps(planeZ + 4, _mm_div_ps(padding0, length));
+    _mm_store_ps(planeD + 4, _mm_div_ps(padding1, length));
+#else
+    // row r of the matrix is m[r], m[4 + r], m[8 + r], m[12 + r]
+    auto row = [m](int r, int component)
+    { return m[component * 4 + r]; };
+    // plane p = row3 + sign * row(axis)
+    const int axis[6] = {0, 0, 1, 1, 2, 2};
+    const float sign[6] = {1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f};
+    for (int p = 0; p < 8; p++)
+    {
+        int source = p < 6 ? p : 0;
+        float plane[4];
+        for (int component = 0; component < 4; component++)
+            plane[component] = row(3, component) + sign[source] * row(axis[source], component);
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        planeX[p] = plane[0] / length;
+        planeY[p] = plane[1] / length;
+        planeZ[p] = plane[2] / length;
+        planeD[p] = plane[3] / length;
+    }
+#endif
+}
+
+bool Frustum::isSphereVisible(const glm::vec3 &center, float radius) const
+{
+#ifdef FRUSTUM_SSE
+    __m128 x = _mm_set1_ps(center.x);
+    __m128 y = _mm_set1_ps(center.y);
+    __m128 z = _mm_set1_ps(center.z);
+    __m128 negativeRadius = _mm_set1_ps(-radius);
+    int outside = 0;
+    for (int batch = 0; batch < 8; batch += 4)
+    {
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(planeX + batch), x), _mm_mul_ps(_mm_load_ps(planeY + batch), y)),
+                                     _mm_add_ps(_mm_mul_ps(_mm_load_ps(planeZ + batch), z), _mm_load_ps(planeD + batch)));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(distance, negativeRadius));
+    }
+    return outside == 0;
+#else
+    for (int p = 0; p < 6; p++)
+    {
+        if (planeX[p] * center.x + planeY[p] * center.y + planeZ[p] * center.z + planeD[p] < -radius)
+            return false;
+    }
+    return true;
+#endif
+}
+
+bool Frustum::isBoxVisible(const glm::vec3 &minimum, const glm::vec3 &maximum) const
+{
+    glm::vec3 center = (minimum + maximum) * 0.5f;
+    glm::vec3 extent = (maximum - minimum) * 0.5f;
+
+#ifdef FRUSTUM_SSE
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+    int outside = 0;
+    for (int batch = 0; batch < 8; batch += 4)
+    {
+        __m128 nx = _mm_load_ps(planeX + batch);
+        __m128 ny = _mm_load_ps(planeY + batch);
+        __m128 nz = _mm_load_ps(planeZ + batch);
+        // distance of the center, and how far the box reaches along the plane normal
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                     _mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(planeD + batch)));
+        __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                                  _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+    }
+    return outside == 0;
+#else
+    for (int p = 0; p < 6; p++)
+    {
+        float distance = planeX[p] * center.x + planeY[p] * center.y + planeZ[p] * center.z + planeD[p];
+        float reach = std::fabs(planeX[p]) * extent.x + std::fabs(planeY[p]) * extent.y + std::fabs(planeZ[p]) * extent.z;
+        if (distance + reach < 0.0f)
+            return false;
+    }
+    return true;
+#endif
+}
+
+bool Frustum::isBoxVisible(const glm::vec3 &minimum, const glm::vec3 &maximum, const glm::mat4 &model) const
+{
+    // Arvo: the world space box around a transformed box has the transformed center
+    // and extents summed through the absolute values of the matrix
+    glm::vec3 center = glm::vec3(model * glm::vec4((minimum + maximum) * 0.5f, 1.0f));
+    glm::vec3 extent = (maximum - minimum) * 0.5f;
+    glm::vec3 worldExtent = glm::abs(glm::vec3(model[0])) * extent.x + glm::abs(glm::vec3(model[1])) * extent.y +
+                            glm::abs(glm::vec3(model[2])) * extent.z;
+    return isBoxVisible(center - worldExtent, center + worldExtent);
+}
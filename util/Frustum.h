@@ -0,0 +1,53 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FRUSTUM_SSE 1
+#include <emmintrin.h>
+#endif
+
+// visible/culled counters, reset by every update() so they read per frame. the tests
+// don't count, whoever decides what gets drawn records one result per object
+struct CullingStatistics
+{
+    unsigned int tested;
+    unsigned int visible;
+    unsigned int culled;
+};
+
+// The 6 planes of the view frustum, extracted from projection * view (Gribb & Hartmann).
+// Planes are stored structure-of-arrays, so one SSE instruction tests a bounding
+// volume against 4 planes at once; the last 2 slots repeat plane 0.
+// A volume is culled only if it lies completely outside one plane, so volumes near
+// the frustum corners can be kept even if invisible (conservative, never wrong).
+class Frustum
+{
+public:
+    Frustum();
+
+    // extracts the planes in world space, call once per frame after the camera moved
+    void update(const glm::mat4 &projectionView);
+
+    bool isSphereVisible(const glm::vec3 &center, float radius) const;
+    bool isBoxVisible(const glm::vec3 &minimum, const glm::vec3 &maximum) const;
+    // object space box under a model matrix, tested as the world space box enclosing it
+    bool isBoxVisible(const glm::vec3 &minimum, const glm::vec3 &maximum, const glm::mat4 &model) const;
+
+    // counts one object as visible or culled, returns visible
+    bool record(bool visible);
+    // adds the counters of a copy (e.g. one per thread) to these
+    void addStatistics(const CullingStatistics &other);
+    const CullingStatistics &getStatistics() const;
+
+private:
+    // left, right, bottom, top, near, far + 2 padding copies of left
+    alignas(16) float planeX[8];
+    alignas(16) float planeY[8];
+    alignas(16) float planeZ[8];
+    alignas(16) float planeD[8];
+    CullingStatistics statistics;
+};
+
+#endif
@@ -0,0 +1,275 @@
+#include "GeometryArena.h"
+#include "Mesh.h"
+#include "RenderState.h"
+#include "RenderContext.h"
+
+#include <algorithm>
+#include <iterator>
+
+typedef void(APIENTRY *MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect,
+                                                       GLsizei drawcount, GLsizei stride);
+
+namespace
+{
+    // -1 not looked up yet, 0 missing, 1 there
+    int multiDrawSupport = -1;
+    MultiDrawElementsIndirectProc multiDrawElementsIndirectProc = nullptr;
+}
+
+RangeAllocator::RangeAllocator(size_t capacity) : capacity(0), freeElements(0)
+{
+    grow(capacity);
+}
+
+size_t RangeAllocator::allocate(size_t count)
+{
+    if (count == 0)
+        return INVALID;
+    for (auto block = freeBlocks.begin(); block != freeBlocks.end(); ++block)
+    {
+        if (block->second < count)
+            continue;
+        size_t offset = block->first;
+        size_t left = block->second - count;
+        freeBlocks.erase(block);
+        if (left > 0)
+            freeBlocks[offset + count] = left;
+        freeElements -= count;
+        return offset;
+    }
+    return INVALID;
+}
+
+void RangeAllocator::free(size_t offset, size_t count)
+{
+    if (count == 0)
+        return;
+    freeElements += count;
+    auto next = freeBlocks.lower_bound(offset);
+    // glue to the block right after
+    if (next != freeBlocks.end() && offset + count == next->first)
+    {
+        count += next->second;
+        next = freeBlocks.erase(next);
+    }
+    // and to the one right before
+    if (next != freeBlocks.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += count;
+            return;
+        }
+    }
+    freeBlocks[offset] = count;
+}
+
+void RangeAllocator::grow(size_t newCapacity)
+{
+    if (newCapacity <= capacity)
+        return;
+    size_t oldCapacity = capacity;
+    capacity = newCapacity;
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+size_t RangeAllocator::getCapacity() const
+{
+    return capacity;
+}
+
+size_t RangeAllocator::getFreeElements() const
+{
+    return freeElements;
+}
+
+size_t RangeAllocator::getLargestFree() const
+{
+    size_t largest = 0;
+    for (const auto &block : freeBlocks)
+        largest = std::max(largest, block.second);
+    return largest;
+}
+
+GeometryArena::GeometryArena(VertexLayout layout, size_t vertexCapacity, size_t indexCapacity)
+    : layout(layout), vertexSize(Mesh::vertexSize(layout)), VAO(0), VBO(0), EBO(0),
+      vertexSpace(vertexCapacity), indexSpace(indexCapacity), instanceBuffer(0), instanceOffset(0)
+{
+    glGenVertexArrays(1, &VAO);
+    VBO = resize(0, 0, vertexCapacity * vertexSize);
+    EBO = resize(0, 0, indexCapacity * sizeof(unsigned int));
+    setupAttributes();
+}
+
+GeometryArena::~GeometryArena()
+{
+    RenderState::shared().forgetVertexArray(VAO);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+}
+
+GeometryArena &GeometryArena::shared(VertexLayout layout)
+{
+    // never destroyed: the context may be gone at exit
+    static GeometryArena *arenas[2] = {nullptr, nullptr};
+    GeometryArena *&arena = arenas[layout == VertexLayout::Compact ? 1 : 0];
+    if (!arena)
+        arena = new GeometryArena(layout);
+    return *arena;
+}
+
+// a buffer of newBytes holding the first usedBytes of the old one. Both sides go
+// through the copy targets, binding GL_ELEMENT_ARRAY_BUFFER would change whatever VAO is bound
+GLuint GeometryArena::resize(GLuint buffer, size_t usedBytes, size_t newBytes)
+{
+    GLuint resized;
+    glGenBuffers(1, &resized);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+    if (buffer != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        if (usedBytes > 0)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+        glDeleteBuffers(1, &buffer);
+    }
+    return resized;
+}
+
+// the vertex attributes point at the buffer they were set up with, so they are
+// set again every time VBO or EBO get replaced
+void GeometryArena::setupAttributes()
+{
+    RenderState::shared().bindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    Mesh::setupVertexAttributes(layout);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::growVertices(size_t minimumCapacity)
+{
+    size_t capacity = std::max((size_t)1, vertexSpace.getCapacity());
+    while (capacity < minimumCapacity)
+        capacity *= 2;
+    VBO = resize(VBO, vertexSpace.getCapacity() * vertexSize, capacity * vertexSize);
+    vertexSpace.grow(capacity);
+    setupAttributes();
+}
+
+void GeometryArena::growIndices(size_t minimumCapacity)
+{
+    size_t capacity = std::max((size_t)1, indexSpace.getCapacity());
+    while (capacity < minimumCapacity)
+        capacity *= 2;
+    EBO = resize(EBO, indexSpace.getCapacity() * sizeof(unsigned int), capacity * sizeof(unsigned int));
+    indexSpace.grow(capacity);
+    setupAttributes();
+}
+
+ArenaAllocation GeometryArena::allocate(const void *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount)
+{
+    ArenaAllocation allocation;
+    if (vertexCount == 0 || indexCount == 0)
+        return allocation;
+
+    size_t firstVertex = vertexSpace.allocate(vertexCount);
+    if (firstVertex == RangeAllocator::INVALID)
+    {
+        // fragmented or full: the capacity doubles, so the next meshes fit too
+        growVertices(vertexSpace.getCapacity() + vertexCount);
+        firstVertex = vertexSpace.allocate(vertexCount);
+    }
+    size_t firstIndex = indexSpace.allocate(indexCount);
+    if (firstIndex == RangeAllocator::INVALID)
+    {
+        growIndices(indexSpace.getCapacity() + indexCount);
+        firstIndex = indexSpace.allocate(indexCount);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * vertexSize, vertexCount * vertexSize, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(unsigned int), indexCount * sizeof(unsigned int), indices);
+
+    allocation.baseVertex = (GLint)firstVertex;
+    allocation.vertexCount = (unsigned int)vertexCount;
+    allocation.firstIndex = (unsigned int)firstIndex;
+    allocation.indexCount = (unsigned int)indexCount;
+    return allocation;
+}
+
+void GeometryArena::free(const ArenaAllocation &allocation)
+{
+    if (!allocation.isValid())
+        return;
+    vertexSpace.free((size_t)allocation.baseVertex, allocation.vertexCount);
+    indexSpace.free(allocation.firstIndex, allocation.indexCount);
+}
+
+VertexLayout GeometryArena::getLayout() const
+{
+    return layout;
+}
+
+GLuint GeometryArena::getVAO() const
+{
+    return VAO;
+}
+
+size_t GeometryArena::getVertexCapacity() const
+{
+    return vertexSpace.getCapacity();
+}
+
+size_t GeometryArena::getIndexCapacity() const
+{
+    return indexSpace.getCapacity();
+}
+
+size_t GeometryArena::getFreeVertices() const
+{
+    return vertexSpace.getFreeElements();
+}
+
+size_t GeometryArena::getFreeIndices() const
+{
+    return indexSpace.getFreeElements();
+}
+
+void GeometryArena::useInstanceBuffer(GLuint buffer, size_t firstInstance)
+{
+    RenderState::shared().bindVertexArray(VAO);
+    if (buffer == instanceBuffer && firstInstance == instanceOffset)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    Mesh::setupInstanceAttributes(firstInstance);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    instanceBuffer = buffer;
+    instanceOffset = firstInstance;
+}
+
+bool GeometryArena::supportsMultiDrawIndirect()
+{
+    if (multiDrawSupport < 0)
+    {
+        bool core = RenderContext::isVersionAtLeast(4, 3);
+        // baseInstance has to be honoured too, it picks the model matrix of every draw
+        bool extensions = RenderContext::hasExtension("GL_ARB_multi_draw_indirect") &&
+                          RenderContext::hasExtension("GL_ARB_base_instance");
+        // ARB_multi_draw_indirect is a core extension, its entry point has no suffix
+        if (core || extensions)
+            multiDrawElementsIndirectProc = reinterpret_cast<MultiDrawElementsIndirectProc>(
+                RenderContext::getProcAddress("glMultiDrawElementsIndirect"));
+        multiDrawSupport = multiDrawElementsIndirectProc != nullptr ? 1 : 0;
+    }
+    return multiDrawSupport == 1;
+}
+
+void GeometryArena::multiDrawElementsIndirect(size_t offset, size_t count)
+{
+    multiDrawElementsIndirectProc(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void *>(offset),
+                                  (GLsizei)count, (GLsizei)sizeof(DrawElementsIndirectCommand));
+}
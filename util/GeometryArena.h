@@ -0,0 +1,121 @@
+#ifndef GEOMETRYARENA_H
+#define GEOMETRYARENA_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+#include <cstddef>
+#include <map>
+
+// declared in Mesh.h, which includes this file
+enum class VertexLayout;
+
+// the GL 4.0 indirect buffer binding, glad is generated for 3.3
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// first fit free list over [0, capacity) elements. Free blocks are kept by offset,
+// so freeing merges a range with its neighbours in O(log n)
+class RangeAllocator
+{
+public:
+    static const size_t INVALID = (size_t)-1;
+
+    explicit RangeAllocator(size_t capacity = 0);
+
+    // offset of count free elements, INVALID when no free block is big enough
+    size_t allocate(size_t count);
+    void free(size_t offset, size_t count);
+    // adds [capacity, newCapacity) as free space
+    void grow(size_t newCapacity);
+
+    size_t getCapacity() const;
+    size_t getFreeElements() const;
+    size_t getLargestFree() const;
+
+private:
+    size_t capacity;
+    size_t freeElements;
+    std::map<size_t, size_t> freeBlocks; // offset -> size
+};
+
+// where a mesh lives inside the arena: its indices start at firstIndex and are
+// relative to baseVertex, as glDrawElementsBaseVertex wants them
+struct ArenaAllocation
+{
+    GLint baseVertex = 0;
+    unsigned int vertexCount = 0;
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+
+    bool isValid() const { return vertexCount != 0; }
+};
+
+// one draw of glMultiDrawElementsIndirect, the layout is fixed by GL
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// One vertex buffer and one index buffer shared by every mesh of a vertex layout,
+// behind a single VAO: drawing mesh after mesh changes no vertex array at all, and
+// a whole list of them can go out in one glMultiDrawElementsIndirect (IndirectBatch).
+// Meshes get sub ranges from a free list allocator; when one does not fit the
+// buffers double and the old content is copied over on the GPU.
+// The instance matrix attributes (INSTANCE_MATRIX_LOCATION) of the VAO point at
+// whatever buffer useInstanceBuffer() was given last.
+// GL thread only.
+class GeometryArena
+{
+public:
+    // capacities in vertices and indices, the buffers grow past them when needed
+    GeometryArena(VertexLayout layout, size_t vertexCapacity = 1 << 18, size_t indexCapacity = 1 << 20);
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    // the arena of a layout, created on first use
+    static GeometryArena &shared(VertexLayout layout);
+
+    // vertices are already in the layout's format (Vertex or CompactVertex)
+    ArenaAllocation allocate(const void *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount);
+    // gives the ranges back, the next allocations reuse them. touches no GL
+    void free(const ArenaAllocation &allocation);
+
+    VertexLayout getLayout() const;
+    GLuint getVAO() const;
+    size_t getVertexCapacity() const;
+    size_t getIndexCapacity() const;
+    size_t getFreeVertices() const;
+    size_t getFreeIndices() const;
+
+    // points the instance matrices at a buffer of glm::mat4, starting at the given
+    // instance. binds the arena VAO, does nothing when it already points there
+    void useInstanceBuffer(GLuint buffer, size_t firstInstance = 0);
+
+    // glMultiDrawElementsIndirect with baseInstance: GL 4.3 or ARB_multi_draw_indirect.
+    // looked up at runtime, glad does not load it
+    static bool supportsMultiDrawIndirect();
+    // count commands read from the bound GL_DRAW_INDIRECT_BUFFER at byte offset
+    static void multiDrawElementsIndirect(size_t offset, size_t count);
+
+private:
+    VertexLayout layout;
+    size_t vertexSize;
+    GLuint VAO, VBO, EBO;
+    RangeAllocator vertexSpace;
+    RangeAllocator indexSpace;
+    GLuint instanceBuffer;
+    size_t instanceOffset;
+
+    void setupAttributes();
+    void growVertices(size_t minimumCapacity);
+    void growIndices(size_t minimumCapacity);
+    static GLuint resize(GLuint buffer, size_t usedBytes, size_t newBytes);
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "IndirectBatch.h"
+#include "RenderState.h"
+
+#include <algorithm>
+#include <iostream>
+
+IndirectBatch::IndirectBatch() : arena(nullptr), instanceBuffer(0), indirectBuffer(0),
+                                 instanceCapacity(0), indirectCapacity(0), calls(0)
+{
+}
+
+IndirectBatch::~IndirectBatch()
+{
+    if (instanceBuffer != 0)
+        glDeleteBuffers(1, &instanceBuffer);
+    if (indirectBuffer != 0)
+        glDeleteBuffers(1, &indirectBuffer);
+}
+
+void IndirectBatch::clear()
+{
+    entries.clear();
+    matrices.clear();
+    arena = nullptr;
+}
+
+bool IndirectBatch::add(Mesh &mesh, unsigned int lod, const glm::mat4 &model)
+{
+    GeometryArena *meshArena = mesh.getArena();
+    if (!meshArena || (arena && meshArena != arena))
+    {
+        static bool warned = false;
+        if (!warned)
+            std::cout << "Warning: IndirectBatch only draws meshes of one arena, load the model with ModelLoadOptions::useArena" << std::endl;
+        warned = true;
+        return false;
+    }
+    arena = meshArena;
+    entries.push_back(Entry{mesh.getMaterialKey(), &mesh, std::min(lod, (unsigned int)mesh.lods.size() - 1), (unsigned int)matrices.size()});
+    matrices.push_back(model);
+    return true;
+}
+
+void IndirectBatch::build()
+{
+    // material first: one multi draw per texture set. then mesh and level, so the
+    // copies of one mesh end up next to each other and become one instanced command
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+              {
+                  if (a.materialKey != b.materialKey)
+                      return a.materialKey < b.materialKey;
+                  if (a.mesh != b.mesh)
+                      return a.mesh < b.mesh;
+                  return a.lod < b.lod;
+              });
+
+    sortedMatrices.clear();
+    commands.clear();
+    commandMeshes.clear();
+    const Entry *previous = nullptr;
+    for (const Entry &entry : entries)
+    {
+        if (previous && previous->mesh == entry.mesh && previous->lod == entry.lod)
+        {
+            commands.back().instanceCount++;
+        }
+        else
+        {
+            const ArenaAllocation &allocation = entry.mesh->getAllocation();
+            const MeshLod &lod = entry.mesh->lods[entry.lod];
+            commands.push_back(DrawElementsIndirectCommand{lod.indexCount, 1, allocation.firstIndex + lod.indexOffset,
+                                                           allocation.baseVertex, (GLuint)sortedMatrices.size()});
+            commandMeshes.push_back(entry.mesh);
+        }
+        sortedMatrices.push_back(matrices[entry.matrix]);
+        previous = &entry;
+    }
+}
+
+// grows by doubling and orphans the old storage, like Model::DrawInstanced
+void IndirectBatch::upload(GLenum target, GLuint buffer, size_t &capacity, const void *data, size_t bytes)
+{
+    glBindBuffer(target, buffer);
+    if (bytes > capacity)
+        capacity = std::max(bytes, capacity * 2);
+    glBufferData(target, capacity, NULL, GL_STREAM_DRAW);
+    glBufferSubData(target, 0, bytes, data);
+}
+
+void IndirectBatch::draw(Shader &shader)
+{
+    calls = 0;
+    if (entries.empty())
+    {
+        commands.clear();
+        return;
+    }
+    build();
+
+    if (instanceBuffer == 0)
+        glGenBuffers(1, &instanceBuffer);
+    upload(GL_ARRAY_BUFFER, instanceBuffer, instanceCapacity, sortedMatrices.data(), sortedMatrices.size() * sizeof(glm::mat4));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    bool multiDraw = GeometryArena::supportsMultiDrawIndirect();
+    if (multiDraw)
+    {
+        if (indirectBuffer == 0)
+            glGenBuffers(1, &indirectBuffer);
+        upload(GL_DRAW_INDIRECT_BUFFER, indirectBuffer, indirectCapacity, commands.data(),
+               commands.size() * sizeof(DrawElementsIndirectCommand));
+    }
+
+    shader.use();
+    arena->useInstanceBuffer(instanceBuffer);
+    for (size_t begin = 0; begin < commands.size();)
+    {
+        size_t end = begin + 1;
+        // the key only sorts, two texture sets may share one
+        while (end < commands.size() && commandMeshes[end]->hasSameTextures(*commandMeshes[begin]))
+            end++;
+
+        commandMeshes[begin]->bindTextures(shader);
+        if (multiDraw)
+        {
+            GeometryArena::multiDrawElementsIndirect(begin * sizeof(DrawElementsIndirectCommand), end - begin);
+            calls++;
+        }
+        else
+        {
+            // no baseInstance before GL 4.2: move the instance attributes to the first matrix instead
+            for (size_t i = begin; i < end; i++)
+            {
+                const DrawElementsIndirectCommand &command = commands[i];
+                arena->useInstanceBuffer(instanceBuffer, command.baseInstance);
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                                                  (void *)(command.firstIndex * sizeof(unsigned int)),
+                                                  command.instanceCount, command.baseVertex);
+                calls++;
+            }
+        }
+        begin = end;
+    }
+}
+
+size_t IndirectBatch::size() const
+{
+    return entries.size();
+}
+
+size_t IndirectBatch::getCommands() const
+{
+    return commands.size();
+}
+
+size_t IndirectBatch::getCalls() const
+{
+    return calls;
+}
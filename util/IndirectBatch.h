@@ -0,0 +1,69 @@
+#ifndef INDIRECTBATCH_H
+#define INDIRECTBATCH_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "GeometryArena.h"
+
+// Copies of arena meshes collected over a frame and drawn with as few calls as the
+// textures allow: draw() groups the copies by material, merges copies of the same
+// mesh and level of detail into one instanced command and issues every material
+// group with one glMultiDrawElementsIndirect. The model matrix of every copy goes
+// into an instance buffer, the commands pick theirs with baseInstance, so the shader
+// has to read it from INSTANCE_MATRIX_LOCATION (Shaders/material_vertex_instanced.vs).
+// Without GL 4.3 the same commands go out one glDrawElementsInstancedBaseVertex each,
+// still without a single VAO switch.
+class IndirectBatch
+{
+public:
+    IndirectBatch();
+    ~IndirectBatch();
+
+    IndirectBatch(const IndirectBatch &) = delete;
+    IndirectBatch &operator=(const IndirectBatch &) = delete;
+
+    // drops the copies of the last frame, keeps the buffers
+    void clear();
+    // one copy of the mesh at a level of detail. false when the mesh is not in an
+    // arena, or in another one than the meshes added before
+    bool add(Mesh &mesh, unsigned int lod, const glm::mat4 &model);
+    void draw(Shader &shader);
+
+    size_t size() const;
+    // commands and GL draw calls of the last draw()
+    size_t getCommands() const;
+    size_t getCalls() const;
+
+private:
+    struct Entry
+    {
+        unsigned int materialKey;
+        Mesh *mesh;
+        unsigned int lod;
+        unsigned int matrix;
+    };
+
+    GeometryArena *arena;
+    std::vector<Entry> entries;
+    std::vector<glm::mat4> matrices;
+
+    // built by draw(), in material order
+    std::vector<glm::mat4> sortedMatrices;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<Mesh *> commandMeshes;
+
+    GLuint instanceBuffer;
+    GLuint indirectBuffer;
+    size_t instanceCapacity;
+    size_t indirectCapacity;
+    size_t calls;
+
+    void build();
+    static void upload(GLenum target, GLuint buffer, size_t &capacity, const void *data, size_t bytes);
+};
+
+#endif
@@ -1,12 +1,39 @@
 #include "Mesh.h"
+#include "RenderState.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
+#include <cmath>
+#include <algorithm>
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+           VertexLayout layout, std::vector<MeshLod> lods, GeometryArena *arena)
 {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    init(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(),
+         std::move(textures), layout, std::move(lods), arena);
+}
 
-    setupMesh();
+Mesh::Mesh(const Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount,
+           std::vector<Texture> textures, VertexLayout layout, std::vector<MeshLod> lods, GeometryArena *arena)
+{
+    init(vertices, vertexCount, indices, indexCount, std::move(textures), layout, std::move(lods), arena);
+}
+
+void Mesh::init(const Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount,
+                std::vector<Texture> textures, VertexLayout layout, std::vector<MeshLod> lods, GeometryArena *arena)
+{
+    this->arena = arena;
+    this->instanceBuffer = 0;
+    this->textures = std::move(textures);
+    this->bindingProgram = 0;
+    this->boneVBO = 0;
+    this->layout = layout;
+    this->lods = std::move(lods);
+    if (this->lods.empty())
+        this->lods.push_back({0, (unsigned int)indexCount, 0.0f});
+
+    computeBounds(vertices, vertexCount);
+    setupMesh(vertices, vertexCount, indices, indexCount);
 }
 
 unsigned int Mesh::getVAO()
@@ -14,21 +41,164 @@ unsigned int Mesh::getVAO()
     return VAO;
 }
 
+unsigned int Mesh::getMaterialKey() const
+{
+    return materialKey;
+}
+
+bool Mesh::hasSameTextures(const Mesh &other) const
+{
+    if (textureBindings.size() != other.textureBindings.size())
+        return false;
+    for (size_t i = 0; i < textureBindings.size(); i++)
+    {
+        if (textureBindings[i].unit != other.textureBindings[i].unit ||
+            textureBindings[i].textureID != other.textureBindings[i].textureID)
+            return false;
+    }
+    return true;
+}
+
+// center of the bounding box and the farthest vertex from it, a bit larger than
+// the optimal sphere but good enough for distances and culling
+void Mesh::computeBounds(const Vertex *vertices, size_t vertexCount)
+{
+    if (vertexCount == 0)
+    {
+        boundsCenter = boundsMin = boundsMax = glm::vec3(0.0f);
+        boundsRadius = 0.0f;
+        return;
+    }
+    glm::vec3 minimum = vertices[0].Position, maximum = vertices[0].Position;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const Vertex &vertex = vertices[i];
+        minimum = glm::min(minimum, vertex.Position);
+        maximum = glm::max(maximum, vertex.Position);
+    }
+    boundsMin = minimum;
+    boundsMax = maximum;
+    boundsCenter = (minimum + maximum) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        glm::vec3 offset = vertices[i].Position - boundsCenter;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    boundsRadius = std::sqrt(radiusSquared);
+}
+
+// coarsest level whose projected error is under the given limit
+unsigned int Mesh::lodFor(float pixelsPerUnit, float maxPixelError) const
+{
+    unsigned int level = 0;
+    for (unsigned int i = 1; i < lods.size(); i++)
+    {
+        if (lods[i].error * pixelsPerUnit <= maxPixelError)
+            level = i;
+    }
+    return level;
+}
+
+unsigned int Mesh::selectLod(unsigned int current, float pixelsPerUnit, float maxPixelError, float hysteresis) const
+{
+    current = std::min(current, (unsigned int)lods.size() - 1);
+    // only go coarser once the level is clearly good enough, and only go finer
+    // once the current level is clearly too coarse
+    unsigned int coarser = lodFor(pixelsPerUnit, maxPixelError * (1.0f - hysteresis));
+    if (coarser > current)
+        return coarser;
+    if (lods[current].error * pixelsPerUnit > maxPixelError * (1.0f + hysteresis))
+        return lodFor(pixelsPerUnit, maxPixelError);
+    return current;
+}
+
 
-void Mesh::setupMesh()
+void Mesh::setupMesh(const Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount)
 {
+    // the compact layout keeps bones in a second vertex stream the arena doesn't have
+    if (arena && (layout == VertexLayout::Full || !hasBones(vertices, vertexCount)))
+    {
+        if (layout == VertexLayout::Compact)
+        {
+            std::vector<CompactVertex> packed = packCompact(vertices, vertexCount);
+            allocation = arena->allocate(packed.data(), packed.size(), indices, indexCount);
+        }
+        else
+        {
+            allocation = arena->allocate(vertices, vertexCount, indices, indexCount);
+        }
+        VAO = arena->getVAO();
+        VBO = EBO = 0;
+        setupTextureBindings();
+        return;
+    }
+    arena = nullptr;
+
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
   
-    glBindVertexArray(VAO);
+    RenderState::shared().bindVertexArray(VAO);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), 
+                 indices, GL_STATIC_DRAW);
+
+    if (layout == VertexLayout::Compact)
+        setupCompactLayout(vertices, vertexCount);
+    else
+        setupFullLayout(vertices, vertexCount);
+
+    RenderState::shared().bindVertexArray(0);
+
+    setupTextureBindings();
+
+   
+//    // framebuffer configuration
+//     // -------------------------
+//     glGenFramebuffers(1, &framebuffer);
+//     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+//     // create a color attachment texture
+//     glGenTextures(1, &textureColorbuffer);
+//     glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
+//     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+//     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+//     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+//     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
+}
+
+void Mesh::setupFullLayout(const Vertex *vertices, size_t vertexCount)
+{
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);  
+    setupVertexAttributes(VertexLayout::Full);
+}
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+size_t Mesh::vertexSize(VertexLayout layout)
+{
+    return layout == VertexLayout::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), 
-                 &indices[0], GL_STATIC_DRAW);
+// points the attributes of the bound VAO at the bound GL_ARRAY_BUFFER
+void Mesh::setupVertexAttributes(VertexLayout layout)
+{
+    if (layout == VertexLayout::Compact)
+    {
+        // vertex positions (xyz) + bitangent sign (w)
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Position));
+        // octahedral normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, TexCoords));
+        // octahedral tangents, the bitangent is rebuilt in the shader
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Tangent));
+        return;
+    }
 
     // vertex positions
     glEnableVertexAttribArray(0);	
@@ -47,60 +217,216 @@ void Mesh::setupMesh()
     // vertex bitangent
     glEnableVertexAttribArray(4);
     glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+}
 
-    glBindVertexArray(0);
+std::vector<CompactVertex> Mesh::packCompact(const Vertex *vertices, size_t vertexCount)
+{
+    std::vector<CompactVertex> packed(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const Vertex &vertex = vertices[i];
+        CompactVertex &compact = packed[i];
+        // right handed tangent frame -> +1, mirrored UVs -> -1
+        float bitangentSign = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
 
-   
-//    // framebuffer configuration
-//     // -------------------------
-//     glGenFramebuffers(1, &framebuffer);
-//     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-//     // create a color attachment texture
-//     glGenTextures(1, &textureColorbuffer);
-//     glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-//     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-//     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-//     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-//     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
+        compact.Position[0] = VertexPacking::packHalf(vertex.Position.x);
+        compact.Position[1] = VertexPacking::packHalf(vertex.Position.y);
+        compact.Position[2] = VertexPacking::packHalf(vertex.Position.z);
+        compact.Position[3] = VertexPacking::packHalf(bitangentSign);
+        VertexPacking::packOctahedral(vertex.Normal, compact.Normal);
+        compact.TexCoords[0] = VertexPacking::packHalf(vertex.TexCoords.x);
+        compact.TexCoords[1] = VertexPacking::packHalf(vertex.TexCoords.y);
+        VertexPacking::packOctahedral(vertex.Tangent, compact.Tangent);
+    }
+    return packed;
+}
 
-} 
+// quantizes the vertices into CompactVertex before uploading them,
+// the full precision vertices stay on the CPU side (in this->vertices when the mesh has them)
+void Mesh::setupCompactLayout(const Vertex *vertices, size_t vertexCount)
+{
+    std::vector<CompactVertex> packed = packCompact(vertices, vertexCount);
 
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(CompactVertex), packed.data(), GL_STATIC_DRAW);
+    setupVertexAttributes(VertexLayout::Compact);
 
+    if (!hasBones(vertices, vertexCount))
+        return;
 
-void Mesh::Draw(Shader &shader) 
+    std::vector<CompactBoneData> bones(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+        {
+            bones[i].m_BoneIDs[j] = (uint8_t)vertices[i].m_BoneIDs[j];
+            bones[i].m_Weights[j] = VertexPacking::packUnorm8(vertices[i].m_Weights[j]);
+        }
+    }
+
+    glGenBuffers(1, &boneVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, boneVBO);
+    glBufferData(GL_ARRAY_BUFFER, bones.size() * sizeof(CompactBoneData), bones.data(), GL_STATIC_DRAW);
+    // bone ids
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, sizeof(CompactBoneData), (void*)offsetof(CompactBoneData, m_BoneIDs));
+    // bone weights
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactBoneData), (void*)offsetof(CompactBoneData, m_Weights));
+}
+
+// a mesh has bones if any vertex is influenced by one
+bool Mesh::hasBones(const Vertex *vertices, size_t vertexCount)
+{
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const Vertex &vertex = vertices[i];
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+        {
+            if (vertex.m_Weights[j] > 0.0f)
+                return true;
+        }
+    }
+    return false;
+}
+
+ 
+
+
+
+// builds the sampler names once, so Draw does no string work at all
+void Mesh::setupTextureBindings()
 {
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
+    textureBindings.clear();
+    textureBindings.reserve(textures.size());
     for(unsigned int i = 0; i < textures.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
         // retrieve texture number (the N in diffuse_textureN)
         std::string number;
-        std::string name = textures[i].type;
-        std::cout <<  name <<std::endl;
-
+        const std::string &name = textures[i].type;
         if(name == "texture_diffuse")
             number = std::to_string(diffuseNr++);
         else if(name == "texture_specular")
             number = std::to_string(specularNr++);
 
-        shader.setInt(("material." + name + number).c_str(), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        TextureBinding binding;
+        binding.unit = i;
+        binding.textureID = textures[i].id;
+        binding.uniformName = "material." + name + number;
+        binding.location = -1;
+        textureBindings.push_back(binding);
+    }
+    bindingProgram = 0;
+
+    // FNV-1a over the (unit, texture) pairs
+    materialKey = 0;
+    if (textureBindings.empty())
+        return;
+    materialKey = 2166136261u;
+    for (const TextureBinding &binding : textureBindings)
+    {
+        materialKey = (materialKey ^ binding.unit) * 16777619u;
+        materialKey = (materialKey ^ binding.textureID) * 16777619u;
+    }
+}
 
+// no allocations and no I/O in here, it runs for every mesh on every frame
+void Mesh::bindTextures(Shader &shader)
+{
+    if (shader.ID != bindingProgram)
+    {
+        for (TextureBinding &binding : textureBindings)
+            binding.location = shader.getUniformLocation(binding.uniformName);
+        bindingProgram = shader.ID;
+    }
 
+    // meshes sharing a material leave the units as they are, no rebinds between them
+    RenderState &state = RenderState::shared();
+    for (const TextureBinding &binding : textureBindings)
+    {
+        shader.setInt(binding.location, (int)binding.unit);
+        state.bindTexture(binding.unit, GL_TEXTURE_2D, binding.textureID);
     }
-    glActiveTexture(GL_TEXTURE0);
+}
 
-    // draw mesh
-    glBindVertexArray(VAO);
+void Mesh::Draw(Shader &shader) 
+{
+    DrawLod(shader, 0);
+}
+
+void Mesh::DrawLod(Shader &shader, unsigned int level)
+{
+    bindTextures(shader);
+
+    // draw mesh, the VAO stays bound: the next draw of this mesh binds nothing
+    RenderState::shared().bindVertexArray(VAO);
     //glBindTexture(GL_TEXTURE_2D, textureColorbuffer);	// use the color attachment texture as the texture of the quad plane
 
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    const MeshLod &lod = lods[std::min(level, (unsigned int)lods.size() - 1)];
+    // arena meshes share one index buffer, their indices are relative to baseVertex
+    if (arena)
+        glDrawElementsBaseVertex(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT,
+                                 (void*)((allocation.firstIndex + lod.indexOffset) * sizeof(unsigned int)), allocation.baseVertex);
+    else
+        glDrawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT, (void*)(lod.indexOffset * sizeof(unsigned int)));
 
 
 }  
 
+void Mesh::DrawInstanced(Shader &shader, unsigned int level, unsigned int instanceCount)
+{
+    bindTextures(shader);
+
+    const MeshLod &lod = lods[std::min(level, (unsigned int)lods.size() - 1)];
+    if (arena)
+    {
+        // the arena VAO is shared, its instance attributes point wherever the last user wanted
+        arena->useInstanceBuffer(instanceBuffer);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT,
+                                          (void*)((allocation.firstIndex + lod.indexOffset) * sizeof(unsigned int)),
+                                          instanceCount, allocation.baseVertex);
+        return;
+    }
+    RenderState::shared().bindVertexArray(VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT, (void*)(lod.indexOffset * sizeof(unsigned int)), instanceCount);
+}
+
+void Mesh::setInstanceBuffer(unsigned int buffer)
+{
+    instanceBuffer = buffer;
+    if (arena)
+        return;
+    RenderState::shared().bindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    setupInstanceAttributes(0);
+    RenderState::shared().bindVertexArray(0);
+}
+
+// points INSTANCE_MATRIX_LOCATION of the bound VAO at the glm::mat4s in the bound GL_ARRAY_BUFFER
+void Mesh::setupInstanceAttributes(size_t firstInstance)
+{
+    size_t offset = firstInstance * sizeof(glm::mat4);
+    // a mat4 attribute takes 4 locations, one vec4 column each
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+        glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + column, 1);
+    }
+}
+
+GeometryArena *Mesh::getArena() const
+{
+    return arena;
+}
+
+const ArenaAllocation &Mesh::getAllocation() const
+{
+    return allocation;
+}
+
 void Mesh::DrawNoPresentTexture(Shader &shader)
 {
     
@@ -14,8 +14,12 @@
 #include <GLFW/glfw3.h>
 
 #include "Shader.h"
+#include "VertexPacking.h"
+#include "GeometryArena.h"
 
 #define MAX_BONE_INFLUENCE 4
+// first of the 4 attribute locations (one per column) of the per instance model matrix
+#define INSTANCE_MATRIX_LOCATION 7
 
 struct Vertex {
     // position
@@ -34,12 +38,55 @@ struct Vertex {
 	float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// how the vertices are stored in the VBO
+enum class VertexLayout {
+    // struct Vertex as is, 88 bytes per vertex
+    Full,
+    // struct CompactVertex, 20 bytes per vertex (+8 bytes of bone data only
+    // when the mesh has bones). Needs a vertex shader that decodes it, see
+    // Shaders/material_vertex_compact.vs
+    Compact
+};
+
+struct CompactVertex {
+    // half float position, w holds the bitangent sign (+1/-1)
+    uint16_t Position[4];
+    // octahedral encoded normal, snorm16
+    int16_t Normal[2];
+    // half float texCoords
+    uint16_t TexCoords[2];
+    // octahedral encoded tangent, snorm16. bitangent = cross(normal, tangent) * Position.w
+    int16_t Tangent[2];
+};
+
+// second vertex stream of the compact layout, only uploaded for meshes with bones
+struct CompactBoneData {
+    uint8_t m_BoneIDs[MAX_BONE_INFLUENCE];
+    uint8_t m_Weights[MAX_BONE_INFLUENCE]; // unorm8
+};
+
 struct Texture {
     unsigned int id;
     std::string type;
     std::string path;
 };
 
+// everything Draw needs to bind one texture, built once in setupMesh
+struct TextureBinding {
+    unsigned int unit;        // texture unit index, GL_TEXTURE0 + unit
+    unsigned int textureID;
+    std::string uniformName;  // "material.texture_diffuseN" etc.
+    GLint location;           // location of uniformName in bindingProgram
+};
+
+// one level of detail: a range of Mesh::indices, all levels share the same vertices
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    // largest distance between this level and the full mesh, in object space units
+    float error;
+};
+
 struct Framebufufer {
     unsigned int id;
     int type;
@@ -53,24 +100,95 @@ class Mesh {
         std::vector<unsigned int> indices;
         std::vector<Texture>      textures;
         std::vector<Framebufufer> framebuffers;
+        // LOD 0 is the full mesh, every next one is coarser. indices holds all of them back to back
+        std::vector<MeshLod>      lods;
+        // bounding sphere and box in object space
+        glm::vec3 boundsCenter;
+        float boundsRadius;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
         
         
-        Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+        // an empty lods means indices is a single full detail level. with an arena the
+        // buffers are a range of the arena's and VAO is the arena's (not for compact
+        // meshes with bones, they keep their own)
+        Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+             VertexLayout layout = VertexLayout::Full, std::vector<MeshLod> lods = std::vector<MeshLod>(),
+             GeometryArena *arena = nullptr);
+        // uploads straight from memory that only has to outlive the call, e.g. a mapped
+        // MeshCache file. vertices and indices of the Mesh stay empty
+        Mesh(const Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount,
+             std::vector<Texture> textures, VertexLayout layout = VertexLayout::Full,
+             std::vector<MeshLod> lods = std::vector<MeshLod>(), GeometryArena *arena = nullptr);
+        // draws the full detail level
         void Draw(Shader &shader);
+        // draws the given level of detail
+        void DrawLod(Shader &shader, unsigned int lod);
+        // draws instanceCount copies of the given level of detail in one call, the model
+        // matrices come from the buffer given to setInstanceBuffer (attribute divisor 1)
+        void DrawInstanced(Shader &shader, unsigned int lod, unsigned int instanceCount);
+        // points the INSTANCE_MATRIX_LOCATION attributes of the VAO at a buffer of glm::mat4
+        void setInstanceBuffer(unsigned int buffer);
+        // the level to draw at after current. pixelsPerUnit is how many pixels one object
+        // space unit covers at the mesh distance, the coarsest level whose error stays under
+        // maxPixelError wins. hysteresis (a fraction of maxPixelError) keeps the level
+        // from flickering when the mesh sits right at a switch distance. the caller keeps
+        // current, one per place the mesh is drawn (see LodState in Model.h)
+        unsigned int selectLod(unsigned int current, float pixelsPerUnit, float maxPixelError = 1.0f,
+                               float hysteresis = 0.25f) const;
+        // the level selectLod would pick without hysteresis
+        unsigned int lodFor(float pixelsPerUnit, float maxPixelError = 1.0f) const;
+        // tells materials apart for sorting draws: a hash of every texture and its unit,
+        // 0 without textures. equal keys can still be different sets, see hasSameTextures
+        unsigned int getMaterialKey() const;
+        // same textures on the same units, drawing one after the other binds nothing
+        bool hasSameTextures(const Mesh &other) const;
         void DrawNoPresentTexture(Shader &shader);
         unsigned int getFrameBuffer();
 
         unsigned int getVAO();
+        // nullptr when the mesh has buffers of its own
+        GeometryArena *getArena() const;
+        const ArenaAllocation &getAllocation() const;
+        // binds the textures on their units and points the samplers at them
+        void bindTextures(Shader &shader);
+
+        // bytes per vertex in the VBO
+        static size_t vertexSize(VertexLayout layout);
+        // points the vertex attributes of the bound VAO at the bound GL_ARRAY_BUFFER
+        static void setupVertexAttributes(VertexLayout layout);
+        // same for the instance matrices, skipping firstInstance matrices
+        static void setupInstanceAttributes(size_t firstInstance);
+        static std::vector<CompactVertex> packCompact(const Vertex *vertices, size_t vertexCount);
 
 
     private:
         //  render data
         unsigned int VAO, VBO, EBO, FBO;
+        // only used by the compact layout when the mesh has bones
+        unsigned int boneVBO;
+        VertexLayout layout;
+        GeometryArena *arena;
+        ArenaAllocation allocation;
+        // what setInstanceBuffer got, arena meshes point the shared VAO at it per draw
+        unsigned int instanceBuffer;
         unsigned int framebuffer;
         unsigned int textureColorbuffer;
+        // material binding table, the uniform locations are resolved again only
+        // when the mesh gets drawn with a different shader program
+        std::vector<TextureBinding> textureBindings;
+        unsigned int bindingProgram;
+        unsigned int materialKey;
         const unsigned int SCR_WIDTH = 800;
         const unsigned int SCR_HEIGHT = 600;
-        void setupMesh();
+        void init(const Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount,
+                  std::vector<Texture> textures, VertexLayout layout, std::vector<MeshLod> lods, GeometryArena *arena);
+        void setupMesh(const Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount);
+        void setupFullLayout(const Vertex *vertices, size_t vertexCount);
+        void setupCompactLayout(const Vertex *vertices, size_t vertexCount);
+        static bool hasBones(const Vertex *vertices, size_t vertexCount);
+        void setupTextureBindings();
+        void computeBounds(const Vertex *vertices, size_t vertexCount);
 };
 
 
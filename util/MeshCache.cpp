@@ -0,0 +1,279 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const char MESH_CACHE_MAGIC[4] = {'M', 'C', 'H', 'E'};
+
+    // every block of vertices/indices starts on an 8 byte boundary of the file,
+    // mmap gives us a page aligned base so the pointers we hand out are aligned too
+    size_t alignUp(size_t value)
+    {
+        return (value + 7) & ~size_t(7);
+    }
+
+    void writePadding(std::ofstream &file)
+    {
+        static const char zeros[8] = {0};
+        size_t position = (size_t)file.tellp();
+        file.write(zeros, alignUp(position) - position);
+    }
+
+    template <typename T>
+    void writeValue(std::ofstream &file, const T &value)
+    {
+        file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void writeString(std::ofstream &file, const std::string &value)
+    {
+        writeValue(file, (uint32_t)value.size());
+        file.write(value.data(), value.size());
+    }
+
+    // bounds checked reader over the mapped file
+    struct Cursor
+    {
+        const unsigned char *data;
+        size_t size;
+        size_t offset;
+
+        bool has(size_t bytes) const { return offset + bytes <= size; }
+
+        template <typename T>
+        bool read(T &value)
+        {
+            if (!has(sizeof(T)))
+                return false;
+            std::memcpy(&value, data + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        }
+
+        bool readString(std::string &value)
+        {
+            uint32_t length;
+            if (!read(length) || !has(length))
+                return false;
+            value.assign(reinterpret_cast<const char *>(data + offset), length);
+            offset += length;
+            return true;
+        }
+
+        const unsigned char *take(size_t bytes)
+        {
+            offset = alignUp(offset);
+            if (!has(bytes))
+                return nullptr;
+            const unsigned char *block = data + offset;
+            offset += bytes;
+            return block;
+        }
+    };
+}
+
+MeshCache::MeshCache() : mapped(nullptr), mappedSize(0)
+{
+}
+
+MeshCache::~MeshCache()
+{
+    close();
+}
+
+std::string MeshCache::getCachePath(const std::string &sourcePath)
+{
+    return sourcePath + ".meshcache";
+}
+
+int64_t MeshCache::getModificationTime(const std::string &path)
+{
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error)
+        return -1;
+    return (int64_t)time.time_since_epoch().count();
+}
+
+const std::vector<CachedMesh> &MeshCache::getMeshes() const
+{
+    return meshes;
+}
+
+bool MeshCache::open(const std::string &sourcePath, unsigned int importFlags, unsigned int processingFlags)
+{
+    close();
+
+    int fd = ::open(getCachePath(sourcePath).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // a single mapping of the whole file, the pages get faulted in while
+    // the meshes upload their buffers
+    mappedSize = (size_t)info.st_size;
+    mapped = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        mapped = nullptr;
+        mappedSize = 0;
+        return false;
+    }
+
+    if (!parse(sourcePath, importFlags, processingFlags))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MeshCache::close()
+{
+    meshes.clear();
+    if (mapped)
+    {
+        munmap(mapped, mappedSize);
+        mapped = nullptr;
+        mappedSize = 0;
+    }
+}
+
+bool MeshCache::parse(const std::string &sourcePath, unsigned int importFlags, unsigned int processingFlags)
+{
+    Cursor cursor{static_cast<const unsigned char *>(mapped), mappedSize, 0};
+
+    char magic[4];
+    uint32_t version, vertexSize, flags, processing, meshCount;
+    int64_t modificationTime;
+    std::string cachedSource;
+    if (!cursor.read(magic) || std::memcmp(magic, MESH_CACHE_MAGIC, sizeof(magic)) != 0)
+        return false;
+    if (!cursor.read(version) || version != MESH_CACHE_VERSION)
+        return false;
+    if (!cursor.read(vertexSize) || vertexSize != sizeof(Vertex))
+        return false;
+    if (!cursor.read(flags) || flags != importFlags)
+        return false;
+    if (!cursor.read(processing) || processing != processingFlags)
+        return false;
+    if (!cursor.read(modificationTime) || modificationTime != getModificationTime(sourcePath))
+        return false;
+    if (!cursor.readString(cachedSource) || cachedSource != sourcePath)
+        return false;
+    if (!cursor.read(meshCount))
+        return false;
+
+    meshes.reserve(meshCount);
+    for (uint32_t i = 0; i < meshCount; i++)
+    {
+        CachedMesh mesh;
+        uint32_t lodCount, textureCount;
+        if (!cursor.read(mesh.numVertices) || !cursor.read(mesh.numIndices) || !cursor.read(lodCount) || !cursor.read(textureCount))
+            return false;
+
+        for (uint32_t j = 0; j < lodCount; j++)
+        {
+            MeshLod lod;
+            if (!cursor.read(lod.indexOffset) || !cursor.read(lod.indexCount) || !cursor.read(lod.error))
+                return false;
+            if ((uint64_t)lod.indexOffset + lod.indexCount > mesh.numIndices)
+                return false;
+            mesh.lods.push_back(lod);
+        }
+
+        for (uint32_t j = 0; j < textureCount; j++)
+        {
+            Texture texture;
+            texture.id = 0;
+            if (!cursor.readString(texture.type) || !cursor.readString(texture.path))
+                return false;
+            mesh.textures.push_back(texture);
+        }
+
+        mesh.vertices = reinterpret_cast<const Vertex *>(cursor.take((size_t)mesh.numVertices * sizeof(Vertex)));
+        mesh.indices = reinterpret_cast<const unsigned int *>(cursor.take((size_t)mesh.numIndices * sizeof(unsigned int)));
+        if (!mesh.vertices || !mesh.indices)
+            return false;
+
+        meshes.push_back(std::move(mesh));
+    }
+    return true;
+}
+
+bool MeshCache::write(const std::string &sourcePath, unsigned int importFlags, unsigned int processingFlags,
+                      const std::vector<Mesh> &meshes)
+{
+    int64_t modificationTime = getModificationTime(sourcePath);
+    if (modificationTime < 0)
+        return false;
+
+    // write to a temporary file first and rename it, so a crash half way
+    // through never leaves a truncated cache that looks valid
+    std::string cachePath = getCachePath(sourcePath);
+    std::string temporaryPath = cachePath + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cout << "WARNING::MESH_CACHE:: could not write " << cachePath << std::endl;
+        return false;
+    }
+
+    file.write(MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    writeValue(file, (uint32_t)MESH_CACHE_VERSION);
+    writeValue(file, (uint32_t)sizeof(Vertex));
+    writeValue(file, (uint32_t)importFlags);
+    writeValue(file, (uint32_t)processingFlags);
+    writeValue(file, modificationTime);
+    writeString(file, sourcePath);
+    writeValue(file, (uint32_t)meshes.size());
+
+    for (const Mesh &mesh : meshes)
+    {
+        writeValue(file, (uint32_t)mesh.vertices.size());
+        writeValue(file, (uint32_t)mesh.indices.size());
+        writeValue(file, (uint32_t)mesh.lods.size());
+        writeValue(file, (uint32_t)mesh.textures.size());
+        for (const MeshLod &lod : mesh.lods)
+        {
+            writeValue(file, lod.indexOffset);
+            writeValue(file, lod.indexCount);
+            writeValue(file, lod.error);
+        }
+        for (const Texture &texture : mesh.textures)
+        {
+            writeString(file, texture.type);
+            writeString(file, texture.path);
+        }
+
+        writePadding(file);
+        file.write(reinterpret_cast<const char *>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+        writePadding(file);
+        file.write(reinterpret_cast<const char *>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+    }
+
+    file.close();
+    if (!file)
+    {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    return !error;
+}
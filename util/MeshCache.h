@@ -0,0 +1,60 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Mesh.h"
+
+// bump this every time the layout of the file (or of struct Vertex) changes,
+// old cache files are then simply ignored and rebuilt from the source asset
+#define MESH_CACHE_VERSION 3
+
+// one mesh as it is stored inside the cache file.
+// vertices and indices point straight into the mapped file, so they are only
+// valid as long as the MeshCache that produced them is open
+struct CachedMesh
+{
+    const Vertex *vertices;
+    uint32_t numVertices;
+    const unsigned int *indices;
+    uint32_t numIndices;
+    std::vector<MeshLod> lods;
+    // only type and path are meaningful, the GL id is resolved by the Model
+    std::vector<Texture> textures;
+};
+
+// Binary on-disk cache of the already flattened meshes of a Model.
+// The file lives next to the source asset and is keyed by the source path,
+// its modification time, the assimp post-process flags used to import it and
+// the flags of our own post-import passes (see Model::getProcessingFlags),
+// so a change to any of them invalidates the cache.
+class MeshCache
+{
+public:
+    MeshCache();
+    ~MeshCache();
+
+    // maps the cache file of sourcePath, returns false if it's missing or stale
+    bool open(const std::string &sourcePath, unsigned int importFlags, unsigned int processingFlags);
+    void close();
+    const std::vector<CachedMesh> &getMeshes() const;
+
+    // writes the cache file of sourcePath from the meshes produced by assimp
+    static bool write(const std::string &sourcePath, unsigned int importFlags, unsigned int processingFlags,
+                      const std::vector<Mesh> &meshes);
+    static std::string getCachePath(const std::string &sourcePath);
+
+private:
+    void *mapped;
+    size_t mappedSize;
+    std::vector<CachedMesh> meshes;
+
+    // returns the modification time of the file, or -1 if it doesn't exist
+    static int64_t getModificationTime(const std::string &path);
+    bool parse(const std::string &sourcePath, unsigned int importFlags, unsigned int processingFlags);
+};
+
+#endif
@@ -0,0 +1,313 @@
+#include "MeshOptimizer.h"
+
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+namespace
+{
+    // constants of Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+    const int FORSYTH_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    // how much we want to use this vertex next: high when it's already in the
+    // cache, and high when few triangles are left using it (finish it off)
+    float vertexScore(int cachePosition, unsigned int remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            // the 3 vertices of the last triangle get a fixed score, so we don't
+            // just keep going around the same fan
+            if (cachePosition < 3)
+                score = LAST_TRIANGLE_SCORE;
+            else
+                score = std::pow(1.0f - (cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+        score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    glm::vec3 triangleNormal(const std::vector<Vertex> &vertices, const unsigned int *triangle)
+    {
+        const glm::vec3 &a = vertices[triangle[0]].Position;
+        const glm::vec3 &b = vertices[triangle[1]].Position;
+        const glm::vec3 &c = vertices[triangle[2]].Position;
+        // length is twice the area, so summing these gives area weighted normals
+        return glm::cross(b - a, c - a);
+    }
+}
+
+VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                                        unsigned int cacheSize)
+{
+    VertexCacheStatistics statistics = {};
+    statistics.triangles = (unsigned int)(indices.size() / 3);
+
+    // a vertex is in a FIFO cache if it was inserted less than cacheSize misses ago
+    std::vector<unsigned int> insertedAt(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    unsigned int time = cacheSize + 1;
+    for (unsigned int index : indices)
+    {
+        if (time - insertedAt[index] > cacheSize)
+        {
+            insertedAt[index] = time++;
+            statistics.misses++;
+        }
+        if (!used[index])
+        {
+            used[index] = true;
+            statistics.vertices++;
+        }
+    }
+
+    statistics.acmr = statistics.triangles ? (float)statistics.misses / statistics.triangles : 0.0f;
+    statistics.atvr = statistics.vertices ? (float)statistics.misses / statistics.vertices : 0.0f;
+    return statistics;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // triangles using each vertex, as one flat array with per vertex offsets.
+    // remaining[v] is the number of not yet emitted triangles at the front of its list
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+        remaining[index]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        scores[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    size_t best = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+        if (triangleScores[t] > triangleScores[best])
+            best = t;
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+    size_t scanCursor = 0;
+
+    while (true)
+    {
+        emitted[best] = true;
+        const unsigned int *triangle = &indices[best * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // take the triangle out of the adjacency of its vertices
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = triangle[k];
+            unsigned int *list = &adjacency[offsets[v]];
+            for (unsigned int i = 0; i < remaining[v]; i++)
+            {
+                if (list[i] == best)
+                {
+                    std::swap(list[i], list[remaining[v] - 1]);
+                    remaining[v]--;
+                    break;
+                }
+            }
+        }
+
+        // LRU cache: the triangle's vertices go to the front
+        nextCache.assign(triangle, triangle + 3);
+        for (unsigned int v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        }
+        for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); i++)
+            cachePosition[nextCache[i]] = -1;
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            unsigned int v = nextCache[i];
+            if (i < (size_t)FORSYTH_CACHE_SIZE)
+                cachePosition[v] = (int)i;
+
+            // rescore the vertex and push the difference to the triangles still using it
+            float score = vertexScore(cachePosition[v], remaining[v]);
+            float delta = score - scores[v];
+            scores[v] = score;
+            for (unsigned int i2 = 0; i2 < remaining[v]; i2++)
+                triangleScores[adjacency[offsets[v] + i2]] += delta;
+        }
+        if (nextCache.size() > (size_t)FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+
+        // the next triangle is the best one touching the cache
+        bool found = false;
+        float bestScore = -1.0f;
+        for (unsigned int v : cache)
+        {
+            for (unsigned int i = 0; i < remaining[v]; i++)
+            {
+                unsigned int t = adjacency[offsets[v] + i];
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    best = t;
+                    found = true;
+                }
+            }
+        }
+        if (found)
+            continue;
+
+        // dead end (the island is finished), restart from the next triangle not emitted yet
+        while (scanCursor < triangleCount && emitted[scanCursor])
+            scanCursor++;
+        if (scanCursor == triangleCount)
+            break;
+        best = scanCursor;
+    }
+
+    indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices,
+                                     float threshold)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    const unsigned int cacheSize = 16;
+    float baseline = analyzeVertexCache(indices, vertices.size(), cacheSize).acmr;
+
+    // 1. split the cache optimized order into clusters, a new one starts wherever a
+    // triangle misses the cache on all 3 vertices: moving clusters around only
+    // costs cache misses we are already paying at those points
+    struct Cluster
+    {
+        size_t start;
+        size_t count;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters;
+    std::vector<unsigned int> insertedAt(vertices.size(), 0);
+    unsigned int time = cacheSize + 1;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int index = indices[t * 3 + k];
+            if (time - insertedAt[index] > cacheSize)
+            {
+                insertedAt[index] = time++;
+                misses++;
+            }
+        }
+        if (misses == 3 || clusters.empty())
+            clusters.push_back({t, 0, 0.0f});
+        clusters.back().count++;
+    }
+    if (clusters.size() < 2)
+        return;
+
+    // 2. area weighted centroid of the whole mesh
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const unsigned int *triangle = &indices[t * 3];
+        float area = glm::length(triangleNormal(vertices, triangle));
+        meshCentroid += (vertices[triangle[0]].Position + vertices[triangle[1]].Position + vertices[triangle[2]].Position) * (area / 3.0f);
+        meshArea += area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // 3. clusters facing away from the center are the outer surface: draw them
+    // first so they occlude what is behind them and the early depth test kicks in
+    for (Cluster &cluster : clusters)
+    {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = cluster.start; t < cluster.start + cluster.count; t++)
+        {
+            const unsigned int *triangle = &indices[t * 3];
+            glm::vec3 n = triangleNormal(vertices, triangle);
+            float a = glm::length(n);
+            centroid += (vertices[triangle[0]].Position + vertices[triangle[1]].Position + vertices[triangle[2]].Position) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+        float normalLength = glm::length(normal);
+        if (area > 0.0f && normalLength > 0.0f)
+            cluster.sortKey = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b)
+                     { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (const Cluster &cluster : clusters)
+        result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + (cluster.start + cluster.count) * 3);
+
+    // keep the cache friendly order if the new one costs too many extra vertex shader runs
+    if (analyzeVertexCache(result, vertices.size(), cacheSize).acmr <= baseline * threshold)
+        indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    std::vector<unsigned int> remap(vertices.size(), UINT_MAX);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (unsigned int &index : indices)
+    {
+        if (remap[index] == UINT_MAX)
+        {
+            remap[index] = (unsigned int)reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+}
+
+void MeshOptimizer::optimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                                 VertexCacheStatistics *before, VertexCacheStatistics *after)
+{
+    if (before)
+        *before = analyzeVertexCache(indices, vertices.size());
+
+    optimizeVertexCache(indices, vertices.size());
+    optimizeOverdraw(indices, vertices);
+    optimizeVertexFetch(vertices, indices);
+
+    if (after)
+        *after = analyzeVertexCache(indices, vertices.size());
+}
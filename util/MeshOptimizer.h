@@ -0,0 +1,44 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+#include <cstddef>
+
+#include "Mesh.h"
+
+// ACMR: average cache miss ratio, vertex shader runs per triangle (0.5 is the best a
+// regular grid can do, 3.0 means no reuse at all).
+// ATVR: average transformed vertex ratio, vertex shader runs per unique vertex (1.0 is perfect).
+struct VertexCacheStatistics
+{
+    unsigned int triangles;
+    unsigned int vertices;
+    unsigned int misses;
+    float acmr;
+    float atvr;
+};
+
+// Post-import mesh optimization, CPU only so it can run on the loader worker threads.
+// The three passes are meant to run in this order:
+// 1. optimizeVertexCache: reorders triangles for post-transform cache reuse (Forsyth)
+// 2. optimizeOverdraw: reorders clusters of triangles so the outer surfaces are drawn
+//    first, as long as the cache efficiency doesn't drop more than threshold
+// 3. optimizeVertexFetch: reorders the vertices in order of first use
+class MeshOptimizer
+{
+public:
+    // simulates a FIFO post-transform cache of cacheSize entries
+    static VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                                    unsigned int cacheSize = 16);
+    static void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount);
+    static void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices,
+                                 float threshold = 1.05f);
+    // drops vertices no triangle references
+    static void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+
+    // all of the above, before/after can be null
+    static void optimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                             VertexCacheStatistics *before = nullptr, VertexCacheStatistics *after = nullptr);
+};
+
+#endif
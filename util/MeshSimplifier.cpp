@@ -0,0 +1,419 @@
+#include "MeshSimplifier.h"
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+#include "MeshOptimizer.h"
+
+namespace
+{
+    // symmetric 4x4 error quadric, stored as its 10 unique terms, plus the total weight
+    // so evaluating it gives an average squared distance instead of an area weighted sum
+    struct Quadric
+    {
+        float a00, a01, a02, a11, a12, a22;
+        float b0, b1, b2;
+        float c;
+        float weight;
+
+        void add(const Quadric &other)
+        {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12; a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+        }
+
+        // squared distance of p from the planes that built this quadric
+        float evaluate(const glm::vec3 &p) const
+        {
+            float rx = a00 * p.x + a01 * p.y + a02 * p.z;
+            float ry = a01 * p.x + a11 * p.y + a12 * p.z;
+            float rz = a02 * p.x + a12 * p.y + a22 * p.z;
+            float error = p.x * rx + p.y * ry + p.z * rz + 2.0f * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return weight > 0.0f ? std::fabs(error) / weight : 0.0f;
+        }
+    };
+
+    Quadric planeQuadric(const glm::vec3 &n, float d, float weight)
+    {
+        Quadric q;
+        q.a00 = weight * n.x * n.x; q.a01 = weight * n.x * n.y; q.a02 = weight * n.x * n.z;
+        q.a11 = weight * n.y * n.y; q.a12 = weight * n.y * n.z; q.a22 = weight * n.z * n.z;
+        q.b0 = weight * n.x * d; q.b1 = weight * n.y * d; q.b2 = weight * n.z * d;
+        q.c = weight * d * d;
+        q.weight = weight;
+        return q;
+    }
+
+    // from moves onto to. on a seam the other copies move along, partnerFrom onto partnerTo
+    struct Collapse
+    {
+        unsigned int from;
+        unsigned int to;
+        unsigned int partnerFrom;
+        unsigned int partnerTo;
+        float cost;
+    };
+
+    uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return ((uint64_t)a << 32) | b;
+    }
+
+    // groups vertices sharing the exact same position (the split copies assimp makes
+    // along UV and normal seams) and returns the group of every vertex
+    std::vector<unsigned int> buildPositionGroups(const std::vector<Vertex> &vertices)
+    {
+        struct PositionHash
+        {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                uint32_t bits[3];
+                std::memcpy(bits, &p, sizeof(bits));
+                return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+            }
+        };
+        struct PositionEqual
+        {
+            bool operator()(const glm::vec3 &a, const glm::vec3 &b) const
+            {
+                return a.x == b.x && a.y == b.y && a.z == b.z;
+            }
+        };
+
+        std::unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual> groups;
+        groups.reserve(vertices.size());
+        std::vector<unsigned int> group(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            group[i] = groups.emplace(vertices[i].Position, (unsigned int)i).first->second;
+        return group;
+    }
+
+    const unsigned int NO_VERTEX = ~0u;
+
+    enum class VertexKind
+    {
+        Manifold, // interior vertex with a single copy, collapses along any edge
+        Seam,     // one of the 2 copies on a UV/normal seam, collapses along the seam only
+        Locked    // border, non-manifold or where 3+ copies meet, never moves
+    };
+
+    // what the simplifier knows about the vertices before it starts
+    struct VertexInfo
+    {
+        std::vector<VertexKind> kind;
+        // the other copy of a vertex on a seam, NO_VERTEX for single copies
+        std::vector<unsigned int> partner;
+    };
+
+    // triangles using the edge a-b, in vertex space
+    std::unordered_map<uint64_t, unsigned int> countEdges(const std::vector<unsigned int> &indices,
+                                                          const std::vector<unsigned int> *group)
+    {
+        std::unordered_map<uint64_t, unsigned int> edgeUse;
+        edgeUse.reserve(indices.size());
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = indices[t + k], b = indices[t + (k + 1) % 3];
+                if (group)
+                    edgeUse[edgeKey((*group)[a], (*group)[b])]++;
+                else
+                    edgeUse[edgeKey(a, b)]++;
+            }
+        }
+        return edgeUse;
+    }
+
+    // seam vertices come in pairs at one position: the mesh is closed there in position
+    // space but open in vertex space. border and non-manifold edges lock their vertices,
+    // and so do positions with more than 2 copies (where seams cross)
+    VertexInfo classifyVertices(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                const std::vector<unsigned int> &group)
+    {
+        VertexInfo info;
+        info.kind.assign(vertices.size(), VertexKind::Manifold);
+        info.partner.assign(vertices.size(), NO_VERTEX);
+
+        std::vector<unsigned int> groupSize(vertices.size(), 0);
+        for (size_t i = 0; i < vertices.size(); i++)
+            groupSize[group[i]]++;
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            if (groupSize[group[i]] > 2)
+                info.kind[i] = VertexKind::Locked;
+            else if (groupSize[group[i]] == 2)
+            {
+                info.kind[i] = VertexKind::Seam;
+                // group[i] is the first copy, i the second one when they differ
+                if (group[i] != i)
+                {
+                    info.partner[i] = group[i];
+                    info.partner[group[i]] = i;
+                }
+            }
+        }
+
+        // count the triangles on every edge in position space, so seams don't look like borders
+        std::unordered_map<uint64_t, unsigned int> edgeUse = countEdges(indices, &group);
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = indices[t + k];
+                unsigned int b = indices[t + (k + 1) % 3];
+                if (edgeUse[edgeKey(group[a], group[b])] != 2)
+                    info.kind[a] = info.kind[b] = VertexKind::Locked;
+            }
+        }
+        // both copies of a seam vertex move together or not at all
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            unsigned int partner = info.partner[i];
+            if (partner != NO_VERTEX && (info.kind[i] == VertexKind::Locked || info.kind[partner] == VertexKind::Locked))
+                info.kind[i] = info.kind[partner] = VertexKind::Locked;
+        }
+        return info;
+    }
+}
+
+std::vector<unsigned int> MeshSimplifier::simplify(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                                   size_t targetIndexCount, float *error)
+{
+    std::vector<unsigned int> result(indices);
+    float maxError = 0.0f;
+    const size_t vertexCount = vertices.size();
+
+    std::vector<unsigned int> group = buildPositionGroups(vertices);
+    VertexInfo info = classifyVertices(vertices, indices, group);
+
+    // every vertex starts with the planes of the triangles around it, weighted by area
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        const glm::vec3 &p0 = vertices[indices[t]].Position;
+        glm::vec3 n = glm::cross(vertices[indices[t + 1]].Position - p0, vertices[indices[t + 2]].Position - p0);
+        float area = glm::length(n) * 0.5f;
+        if (area <= 0.0f)
+            continue;
+        n /= (area * 2.0f);
+        Quadric q = planeQuadric(n, -glm::dot(n, p0), area);
+        for (int k = 0; k < 3; k++)
+            quadrics[indices[t + k]].add(q);
+    }
+
+    // seam edges also get the plane through them at a right angle to their triangle, so
+    // a seam vertex only slides along the seam where that keeps the seam's shape
+    std::unordered_map<uint64_t, unsigned int> edgeUse = countEdges(indices, nullptr);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        const glm::vec3 &p0 = vertices[indices[t]].Position;
+        glm::vec3 normal = glm::cross(vertices[indices[t + 1]].Position - p0, vertices[indices[t + 2]].Position - p0);
+        if (glm::length(normal) <= 0.0f)
+            continue;
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = indices[t + k], b = indices[t + (k + 1) % 3];
+            if (info.kind[a] != VertexKind::Seam || info.kind[b] != VertexKind::Seam || edgeUse[edgeKey(a, b)] != 1)
+                continue;
+            glm::vec3 edge = vertices[b].Position - vertices[a].Position;
+            glm::vec3 side = glm::cross(edge, normal);
+            float length = glm::length(side);
+            if (length <= 0.0f)
+                continue;
+            side /= length;
+            Quadric q = planeQuadric(side, -glm::dot(side, vertices[a].Position), glm::dot(edge, edge));
+            quadrics[a].add(q);
+            quadrics[b].add(q);
+        }
+    }
+
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<unsigned int> triangleOffsets(vertexCount + 1);
+    std::vector<unsigned int> vertexTriangles;
+    std::vector<Collapse> collapses;
+
+    // every pass collapses a batch of the cheapest edges whose neighbourhoods don't
+    // overlap, so the costs and flip checks of a pass are all computed on the same mesh
+    while (result.size() > targetIndexCount)
+    {
+        const size_t triangleCount = result.size() / 3;
+
+        // triangles around each vertex
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (unsigned int index : result)
+            triangleOffsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            triangleOffsets[v + 1] += triangleOffsets[v];
+        vertexTriangles.resize(result.size());
+        std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+                vertexTriangles[fill[result[t * 3 + k]]++] = (unsigned int)t;
+        }
+
+        // triangles of the current mesh using the edge a-b
+        auto trianglesOnEdge = [&](unsigned int a, unsigned int b)
+        {
+            unsigned int count = 0;
+            for (unsigned int i = triangleOffsets[a]; i < triangleOffsets[a + 1]; i++)
+            {
+                const unsigned int *triangle = &result[vertexTriangles[i] * 3];
+                count += triangle[0] == b || triangle[1] == b || triangle[2] == b;
+            }
+            return count;
+        };
+        auto addCollapse = [&](unsigned int from, unsigned int to)
+        {
+            if (info.kind[from] == VertexKind::Manifold)
+            {
+                collapses.push_back({from, to, NO_VERTEX, NO_VERTEX, quadrics[from].evaluate(vertices[to].Position)});
+                return;
+            }
+            if (info.kind[from] != VertexKind::Seam)
+                return;
+            // along the seam: open edge here, and the same edge open between the other copies
+            unsigned int partnerFrom = info.partner[from], partnerTo = info.partner[to];
+            if (partnerTo == NO_VERTEX || trianglesOnEdge(from, to) != 1 || trianglesOnEdge(partnerFrom, partnerTo) != 1)
+                return;
+            const glm::vec3 &target = vertices[to].Position;
+            collapses.push_back({from, to, partnerFrom, partnerTo,
+                                 quadrics[from].evaluate(target) + quadrics[partnerFrom].evaluate(target)});
+        };
+
+        collapses.clear();
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[t * 3 + k];
+                unsigned int b = result[t * 3 + (k + 1) % 3];
+                addCollapse(a, b);
+                addCollapse(b, a);
+            }
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y)
+                  { return x.cost < y.cost; });
+
+        // an interior collapse removes 2 triangles
+        size_t budget = std::max<size_t>(1, (result.size() - targetIndexCount) / 6);
+        size_t performed = 0;
+        for (unsigned int v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+
+        // moving "from" onto "to" must not flip any of the triangles that survive
+        auto flips = [&](unsigned int from, unsigned int to)
+        {
+            const glm::vec3 &target = vertices[to].Position;
+            for (unsigned int i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+            {
+                const unsigned int *triangle = &result[vertexTriangles[i] * 3];
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                    continue; // this one degenerates and goes away
+                glm::vec3 p[3], moved[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    p[k] = vertices[triangle[k]].Position;
+                    moved[k] = triangle[k] == from ? target : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                if (glm::dot(before, after) <= 0.0f)
+                    return true;
+            }
+            return false;
+        };
+        auto apply = [&](unsigned int from, unsigned int to)
+        {
+            remap[from] = to;
+            quadrics[to].add(quadrics[from]);
+            // the whole neighbourhood of the collapse is off limits for the rest of the pass
+            for (unsigned int i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+            {
+                const unsigned int *triangle = &result[vertexTriangles[i] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+        };
+
+        for (const Collapse &collapse : collapses)
+        {
+            bool seam = collapse.partnerFrom != NO_VERTEX;
+            if (touched[collapse.from] || touched[collapse.to] ||
+                (seam && (touched[collapse.partnerFrom] || touched[collapse.partnerTo])))
+                continue;
+            if (flips(collapse.from, collapse.to) || (seam && flips(collapse.partnerFrom, collapse.partnerTo)))
+                continue;
+
+            // both sides of a seam collapse onto the same position, so it never opens
+            apply(collapse.from, collapse.to);
+            if (seam)
+                apply(collapse.partnerFrom, collapse.partnerTo);
+            maxError = std::max(maxError, collapse.cost);
+
+            if (++performed >= budget)
+                break;
+        }
+        if (performed == 0)
+            break;
+
+        // apply the collapses and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            unsigned int a = remap[result[t * 3]], b = remap[result[t * 3 + 1]], c = remap[result[t * 3 + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (error)
+        *error = std::sqrt(maxError);
+    return result;
+}
+
+void MeshSimplifier::generateLods(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                                  std::vector<MeshLod> &lods, unsigned int maxLods, size_t minTriangles)
+{
+    lods.clear();
+    lods.push_back({0, (unsigned int)indices.size(), 0.0f});
+
+    std::vector<unsigned int> previous(indices);
+    float previousError = 0.0f;
+    while (lods.size() < maxLods)
+    {
+        size_t target = (previous.size() / 3 / 2) * 3;
+        if (target / 3 < minTriangles)
+            break;
+
+        // simplify the previous level, not LOD 0: cheaper and the chain stays nested
+        float error = 0.0f;
+        std::vector<unsigned int> lod = simplify(vertices, previous, target, &error);
+        // not worth a level if it didn't get at least 20% smaller
+        if (lod.size() * 5 > previous.size() * 4)
+            break;
+
+        MeshOptimizer::optimizeVertexCache(lod, vertices.size());
+        // errors add up along the chain
+        previousError += error;
+        lods.push_back({(unsigned int)indices.size(), (unsigned int)lod.size(), previousError});
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        previous.swap(lod);
+    }
+}
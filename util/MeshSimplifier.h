@@ -0,0 +1,32 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <vector>
+#include <cstddef>
+
+#include "Mesh.h"
+
+// Quadric error metric simplification (Garland & Heckbert) by half edge collapse.
+// Vertices are only ever collapsed onto other existing vertices, so the result is a new
+// index buffer over the same vertex buffer: every LOD of a Mesh shares its VBO.
+// A UV/normal seam (two vertices at the same position) is collapsed along itself only,
+// both copies onto the same next seam vertex at once, so it never tears and attributes
+// never smear across it. Open borders and points where seams meet are locked.
+class MeshSimplifier
+{
+public:
+    // collapses edges until at most targetIndexCount indices are left, but stops early
+    // (returning more) when every remaining collapse would break a seam or flip a
+    // triangle. error receives the largest geometric
+    // deviation introduced, in the same units as the vertex positions
+    static std::vector<unsigned int> simplify(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                              size_t targetIndexCount, float *error = nullptr);
+
+    // builds a LOD chain in place: indices becomes LOD 0 followed by every coarser LOD,
+    // each about half the triangles of the previous one, and lods describes the ranges.
+    // stops at maxLods levels or when a level would drop under minTriangles
+    static void generateLods(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                             std::vector<MeshLod> &lods, unsigned int maxLods = 5, size_t minTriangles = 64);
+};
+
+#endif
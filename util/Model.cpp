@@ -1,16 +1,29 @@
 
 #include "Model.h"
+#include "RenderState.h"
+
+#include <chrono>
 
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
 // constructor, expects a filepath to a 3D model.
-Model::Model(std::string const &path, bool gamma) : gammaCorrection(gamma)
+Model::Model(std::string const &path, bool gamma, ModelLoadOptions options) : gammaCorrection(gamma), options(options), instanceVBO(0), instanceCapacity(0)
 {
     loadModel(path);
 }
 
+Model::~Model()
+{
+    // only CPU side bookkeeping, fine after the context is gone too
+    for (Mesh &mesh : meshes)
+    {
+        if (mesh.getArena())
+            mesh.getArena()->free(mesh.getAllocation());
+    }
+}
+
 
 std::vector<Mesh> Model::getMeshes()
 {
@@ -24,107 +37,339 @@ void Model::Draw(Shader &shader)
         meshes[i].Draw(shader);
 }
 
+void Model::DrawInstanced(Shader &shader, const glm::mat4 *instances, size_t count)
+{
+    if (count == 0)
+        return;
+
+    if (instanceVBO == 0)
+    {
+        glGenBuffers(1, &instanceVBO);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].setInstanceBuffer(instanceVBO);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    // grow by doubling so a slowly growing count doesn't reallocate every frame
+    if (count > instanceCapacity)
+        instanceCapacity = std::max(count, instanceCapacity * 2);
+    // orphan the old storage: the driver hands out a fresh one instead of waiting
+    // for the draws of the previous frame that still read it
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), instances);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (unsigned int i = 0; i < meshes.size(); i++)
+        meshes[i].DrawInstanced(shader, 0, (unsigned int)count);
+}
+
+void Model::DrawInstanced(Shader &shader, const std::vector<glm::mat4> &instances)
+{
+    DrawInstanced(shader, instances.data(), instances.size());
+}
+
+void Model::DrawInstanced(Shader &shader, const glm::mat4 *instances, size_t count, Frustum &frustum)
+{
+    if (meshes.empty())
+        return;
+    // one box and sphere around every mesh, a copy is drawn whole or not at all
+    glm::vec3 boundsMin = meshes[0].boundsMin, boundsMax = meshes[0].boundsMax;
+    for (unsigned int i = 1; i < meshes.size(); i++)
+    {
+        boundsMin = glm::min(boundsMin, meshes[i].boundsMin);
+        boundsMax = glm::max(boundsMax, meshes[i].boundsMax);
+    }
+    glm::vec3 boundsCenter = (boundsMin + boundsMax) * 0.5f;
+    float boundsRadius = glm::length(boundsMax - boundsCenter);
+
+    visibleInstances.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        const glm::mat4 &model = instances[i];
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        glm::vec3 center = glm::vec3(model * glm::vec4(boundsCenter, 1.0f));
+        bool visible = frustum.isSphereVisible(center, boundsRadius * scale) &&
+                       frustum.isBoxVisible(boundsMin, boundsMax, model);
+        if (frustum.record(visible))
+            visibleInstances.push_back(model);
+    }
+    DrawInstanced(shader, visibleInstances.data(), visibleInstances.size());
+}
+
+void Model::DrawInstanced(Shader &shader, const std::vector<glm::mat4> &instances, Frustum &frustum)
+{
+    DrawInstanced(shader, instances.data(), instances.size(), frustum);
+}
+
+void Model::Draw(Shader &shader, const Camera &camera, const glm::mat4 &model, float viewportHeight, float maxPixelError,
+                 LodState *lodState)
+{
+    unsigned int lod;
+    float distance;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        if (placeMesh(i, camera, model, viewportHeight, nullptr, maxPixelError, lodState, lod, distance))
+            meshes[i].DrawLod(shader, lod);
+    }
+}
+void Model::Draw(Shader &shader, const Camera &camera, const glm::mat4 &model, float viewportHeight, Frustum &frustum,
+                 float maxPixelError, LodState *lodState)
+{
+    unsigned int lod;
+    float distance;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        if (placeMesh(i, camera, model, viewportHeight, &frustum, maxPixelError, lodState, lod, distance))
+            meshes[i].DrawLod(shader, lod);
+    }
+}
+
+void Model::Submit(RenderQueue::Bucket &bucket, Shader &shader, const Material *material, const Camera &camera,
+                   const glm::mat4 &model, float viewportHeight, Frustum &frustum, unsigned int pass, float maxPixelError)
+{
+    unsigned int lod;
+    float distance;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        if (placeMesh(i, camera, model, viewportHeight, &frustum, maxPixelError, nullptr, lod, distance))
+            bucket.submit(meshes[i], shader, material, model, lod, pass, distance);
+    }
+}
+
+void Model::Submit(IndirectBatch &batch, const Camera &camera, const glm::mat4 &model, float viewportHeight,
+                   Frustum &frustum, float maxPixelError)
+{
+    unsigned int lod;
+    float distance;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        if (placeMesh(i, camera, model, viewportHeight, &frustum, maxPixelError, nullptr, lod, distance))
+            batch.add(meshes[i], lod, model);
+    }
+}
+
+bool Model::placeMesh(unsigned int i, const Camera &camera, const glm::mat4 &model, float viewportHeight, Frustum *frustum,
+                      float maxPixelError, LodState *lodState, unsigned int &lod, float &distance) const
+{
+    const Mesh &mesh = meshes[i];
+    // largest scale of the model matrix, object space errors grow with it
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    glm::vec3 center = glm::vec3(model * glm::vec4(mesh.boundsCenter, 1.0f));
+    if (frustum)
+    {
+        // the sphere is the cheap test, the box only runs for what the sphere let through
+        bool visible = frustum->isSphereVisible(center, mesh.boundsRadius * scale) &&
+                       frustum->isBoxVisible(mesh.boundsMin, mesh.boundsMax, model);
+        if (!frustum->record(visible))
+            return false;
+    }
+
+    // distance to the closest point of the bounding sphere, clamped so we never divide by ~0
+    distance = std::max(glm::length(center - camera.Position) - mesh.boundsRadius * scale, 0.1f);
+    // pixels covered by one world unit at distance 1, for the camera's vertical field of view
+    float pixelsPerUnitAtOne = viewportHeight / (2.0f * std::tan(glm::radians(camera.Zoom) * 0.5f));
+    float pixelsPerUnit = pixelsPerUnitAtOne * scale / distance;
+
+    if (!lodState)
+    {
+        lod = mesh.lodFor(pixelsPerUnit, maxPixelError);
+        return true;
+    }
+    // a new state starts every mesh at full detail
+    if (lodState->size() != meshes.size())
+        lodState->resize(meshes.size(), 0);
+    unsigned int &level = (*lodState)[i];
+    level = mesh.selectLod(level, pixelsPerUnit, maxPixelError);
+    lod = level;
+    return true;
+}
+
 void Model::Framebuffer()
 {
     for (unsigned int i = 0; i < meshes.size(); i++)
-        glBindFramebuffer(GL_FRAMEBUFFER, meshes[i].getFrameBuffer());
+        RenderState::shared().bindFramebuffer(GL_FRAMEBUFFER, meshes[i].getFrameBuffer());
 }
 
 // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+// if a valid mesh cache exists next to the file, assimp is skipped altogether.
 void Model::loadModel(std::string const &path)
 {
+    auto start = std::chrono::steady_clock::now();
+    // retrieve the directory path of the filepath
+    directory = path.substr(0, path.find_last_of('/'));
+
+    if (options.useCache && loadFromCache(path))
+    {
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        cout << "Model " << path << " loaded from cache in " << elapsed << " ms" << endl;
+        return;
+    }
+
     // read file via ASSIMP
     Assimp::Importer importer;
-    const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    const aiScene *scene = importer.ReadFile(path, IMPORT_FLAGS);
     // check for errors
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
     {
         cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
         return;
     }
-    // retrieve the directory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
+    auto imported = std::chrono::steady_clock::now();
+
+    // 1. walk ASSIMP's node tree to know which meshes we need and in which order
+    std::vector<aiMesh *> nodeMeshes;
+    processNode(scene->mRootNode, scene, nodeMeshes);
+
+    // 2. convert (and optimize) the meshes on the worker threads, one task per aiMesh.
+    // every task writes only its own slot, so the results stay in node order
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<MeshData> meshData(nodeMeshes.size());
+    pool.parallelFor(nodeMeshes.size(), [&](size_t i)
+                     { convertMesh(nodeMeshes[i], meshData[i], options); });
+    auto converted = std::chrono::steady_clock::now();
+
+    // 3. textures and buffers are GL calls, so they stay on this thread (the one owning the context)
+    meshes.reserve(meshes.size() + nodeMeshes.size());
+    for (size_t i = 0; i < nodeMeshes.size(); i++)
+        meshes.push_back(processMesh(nodeMeshes[i], meshData[i], scene));
+    auto uploaded = std::chrono::steady_clock::now();
 
-    // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
+    auto milliseconds = [](std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+    { return std::chrono::duration<double, std::milli>(to - from).count(); };
+    cout << "Model " << path << " imported with assimp in " << milliseconds(start, uploaded) << " ms"
+         << " (assimp " << milliseconds(start, imported) << " ms, convert " << nodeMeshes.size() << " meshes on "
+         << pool.size() + 1 << " threads " << milliseconds(imported, converted) << " ms, textures and upload "
+         << milliseconds(converted, uploaded) << " ms)" << endl;
+
+    if (options.optimizeMeshes)
+    {
+        // totals over all meshes, for a FIFO cache of 16 entries
+        unsigned int triangles = 0, vertices = 0, missesBefore = 0, missesAfter = 0;
+        for (const MeshData &data : meshData)
+        {
+            triangles += data.before.triangles;
+            vertices += data.after.vertices;
+            missesBefore += data.before.misses;
+            missesAfter += data.after.misses;
+        }
+        if (triangles > 0 && vertices > 0)
+            cout << "Model " << path << " vertex cache: ACMR " << (float)missesBefore / triangles << " -> " << (float)missesAfter / triangles
+                 << ", ATVR " << (float)missesBefore / vertices << " -> " << (float)missesAfter / vertices << endl;
+    }
+
+    // store the flattened (and optimized) meshes so the next start can skip assimp and the optimizer
+    if (options.useCache)
+        MeshCache::write(path, IMPORT_FLAGS, getProcessingFlags(), meshes);
 }
 
-// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-void Model::processNode(aiNode *node, const aiScene *scene)
+// builds the meshes straight from the mapped cache file, returns false if the cache is missing or stale
+bool Model::loadFromCache(std::string const &path)
 {
-    // process each mesh located at the current node
+    MeshCache cache;
+    if (!cache.open(path, IMPORT_FLAGS, getProcessingFlags()))
+        return false;
+
+    meshes.reserve(cache.getMeshes().size());
+    for (const CachedMesh &cached : cache.getMeshes())
+    {
+        std::vector<Texture> textures;
+        for (const Texture &reference : cached.textures)
+            textures.push_back(loadTexture(reference.path, reference.type));
+
+        // uploaded from the mapping itself, no copy of the vertices on the way
+        meshes.push_back(Mesh(cached.vertices, cached.numVertices, cached.indices, cached.numIndices,
+                              textures, options.layout, cached.lods, getArena()));
+    }
+    return true;
+}
+
+// processes a node in a recursive fashion. Collects each individual mesh located at the node and repeats this process on its children nodes (if any).
+void Model::processNode(aiNode *node, const aiScene *scene, std::vector<aiMesh *> &nodeMeshes)
+{
+    // collect each mesh located at the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         // the node object only contains indices to index the actual objects in the scene.
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        nodeMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
-    // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+    // after we've collected all of the meshes (if any) we then recursively process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, nodeMeshes);
     }
 }
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
+unsigned int Model::getProcessingFlags() const
 {
-    // data to fill
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+    return (options.optimizeMeshes ? PROCESS_OPTIMIZE_MESHES : 0) | (options.generateLods ? PROCESS_GENERATE_LODS : 0);
+}
+
+GeometryArena *Model::getArena() const
+{
+    return options.useArena ? &GeometryArena::shared(options.layout) : nullptr;
+}
+
+// converts the vertices and faces of an aiMesh into our own layout.
+// runs on a worker thread, so it must not touch GL or any member of the Model
+void Model::convertMesh(const aiMesh *mesh, MeshData &data, const ModelLoadOptions &options)
+{
+    const bool hasNormals = mesh->HasNormals();
+    // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
+    // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+    const aiVector3D *texCoords = mesh->mTextureCoords[0];
+    const bool hasTangents = texCoords && mesh->mTangents && mesh->mBitangents;
 
-    // walk through each of the mesh's vertices
+    // size the vectors once and write every vertex in place, no push_back growth
+    data.vertices.resize(mesh->mNumVertices);
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
-        Vertex vertex;
-        glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-        // positions
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.Position = vector;
-        // normals
-        if (mesh->HasNormals())
+        Vertex &vertex = data.vertices[i];
+        // assimp uses its own vector class that doesn't directly convert to glm's vec3
+        vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+        vertex.Normal = hasNormals ? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f);
+        vertex.TexCoords = texCoords ? glm::vec2(texCoords[i].x, texCoords[i].y) : glm::vec2(0.0f, 0.0f);
+        if (hasTangents)
         {
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.Normal = vector;
+            vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+            vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
         }
-        // texture coordinates
-        if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+        else
         {
-            glm::vec2 vec;
-            // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
-            // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.TexCoords = vec;
-            // tangent
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
-            // bitangent
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
+            vertex.Tangent = glm::vec3(0.0f);
+            vertex.Bitangent = glm::vec3(0.0f);
+        }
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+        {
+            vertex.m_BoneIDs[j] = 0;
+            vertex.m_Weights[j] = 0.0f;
         }
-        else
-            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-        vertices.push_back(vertex);
     }
-    // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+
+    // now walk through each of the mesh's faces (a face is a mesh its triangle) and flatten the vertex indices.
+    size_t indexCount = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        indexCount += mesh->mFaces[i].mNumIndices;
+    data.indices.resize(indexCount);
+    unsigned int *index = data.indices.data();
     for (unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
-        // retrieve all indices of the face and store them in the indices vector
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
+        const aiFace &face = mesh->mFaces[i];
+        index = std::copy(face.mIndices, face.mIndices + face.mNumIndices, index);
     }
+
+    if (options.optimizeMeshes)
+        MeshOptimizer::optimizeMesh(data.vertices, data.indices, &data.before, &data.after);
+    // the coarser levels get appended to indices, they all share the vertices
+    if (options.generateLods)
+        MeshSimplifier::generateLods(data.vertices, data.indices, data.lods);
+}
+
+// loads the textures of an already converted mesh and uploads it, must run on the GL thread
+Mesh Model::processMesh(aiMesh *mesh, MeshData &data, const aiScene *scene)
+{
+    std::vector<Texture> textures;
+
     // process materials
     aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
     // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -148,7 +393,7 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
     textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
     // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+    return Mesh(std::move(data.vertices), std::move(data.indices), textures, options.layout, std::move(data.lods), getArena());
 }
 
 // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -160,66 +405,35 @@ vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type,
     {
         aiString str;
         mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++)
-        {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
-        }
-        if (!skip)
-        { // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture); // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-        }
+        textures.push_back(loadTexture(str.C_Str(), typeName));
     }
     return textures;
 }
 
+// returns the texture with the given path, loading it only if it hasn't been loaded before by this model
+Texture Model::loadTexture(const std::string &path, const std::string &typeName)
+{
+    // check if texture was loaded before and if so, reuse it: skip loading a new texture
+    for (unsigned int j = 0; j < textures_loaded.size(); j++)
+    {
+        if (textures_loaded[j].path == path)
+            return textures_loaded[j]; // a texture with the same filepath has already been loaded (optimization)
+    }
+    // if texture hasn't been loaded already, load it
+    Texture texture;
+    texture.id = TextureFromFile(path.c_str(), this->directory);
+    texture.type = typeName;
+    texture.path = path;
+    textures_loaded.push_back(texture); // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+    return texture;
+}
+
+// returns at once with a placeholder texture, the image is decoded on the worker threads and
+// uploaded by TextureStreamer::update(), which the render loop calls every frame
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureStreamer::shared().request(filename);
 }
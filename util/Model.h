@@ -18,14 +18,85 @@
 #include <assimp/postprocess.h>
 #include <stb_image.h>
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
+#include "TextureStreamer.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Camera.h"
+#include "Frustum.h"
+#include "RenderQueue.h"
+#include "IndirectBatch.h"
+
+// how a Model gets loaded, the defaults are what every sample wants
+struct ModelLoadOptions
+{
+    // read/write the binary mesh cache next to the asset (see MeshCache)
+    bool useCache = true;
+    VertexLayout layout = VertexLayout::Full;
+    // reorder triangles and vertices for the vertex cache, overdraw and vertex fetch (see MeshOptimizer)
+    bool optimizeMeshes = true;
+    // build a chain of simplified levels of detail for every mesh (see MeshSimplifier)
+    bool generateLods = true;
+    // put the meshes into the shared GeometryArena of the layout instead of buffers
+    // of their own, needed to draw them through an IndirectBatch
+    bool useArena = false;
+};
 
 
 
+// the levels of detail one copy of a model was drawn at last time, one per mesh. the
+// hysteresis of Mesh::selectLod needs it, keep one per copy a Model is drawn as
+typedef std::vector<unsigned int> LodState;
+
 class Model
 {
 public:
-    Model(std::string const &path,bool gamma = false);
+    // post-process steps applied by assimp, part of the mesh cache key
+    static const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    // bits of getProcessingFlags(), part of the mesh cache key
+    static const unsigned int PROCESS_OPTIMIZE_MESHES = 1;
+    static const unsigned int PROCESS_GENERATE_LODS = 2;
+
+    Model(std::string const &path,bool gamma = false, ModelLoadOptions options = ModelLoadOptions());
+    // gives the arena ranges of the meshes back (useArena), copies from getMeshes()
+    // must not be drawn after that
+    ~Model();
+
+    // the meshes own their arena ranges through the model, a copy would free them twice
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
     void Draw(Shader &shader);
+    // draws every mesh at the level of detail its size on screen calls for.
+    // model is the matrix the shader gets, viewportHeight is in pixels. with a lodState
+    // the levels switch with hysteresis, without one they are picked fresh every call
+    void Draw(Shader &shader, const Camera &camera, const glm::mat4 &model, float viewportHeight,
+              float maxPixelError = 1.0f, LodState *lodState = nullptr);
+    // same, but meshes outside the frustum are skipped before any GL call.
+    // frustum must have been updated with this frame's projection * view
+    void Draw(Shader &shader, const Camera &camera, const glm::mat4 &model, float viewportHeight,
+              Frustum &frustum, float maxPixelError = 1.0f, LodState *lodState = nullptr);
+    // queues the meshes Draw(shader, camera, model, viewportHeight, frustum) would draw, sorted
+    // and drawn later by the queue. touches no GL and no Model state, so threads can submit
+    // at once, each into its own bucket and with its own copy of the frustum (it counts).
+    // levels of detail are picked without hysteresis, as Draw without a LodState does
+    void Submit(RenderQueue::Bucket &bucket, Shader &shader, const Material *material, const Camera &camera,
+                const glm::mat4 &model, float viewportHeight, Frustum &frustum, unsigned int pass = 0,
+                float maxPixelError = 1.0f);
+    // same, into a batch drawn with multi draw indirect. needs useArena
+    void Submit(IndirectBatch &batch, const Camera &camera, const glm::mat4 &model, float viewportHeight,
+                Frustum &frustum, float maxPixelError = 1.0f);
+    // draws count copies of the model with one draw call per mesh, instances holds their
+    // model matrices. needs a vertex shader reading them from INSTANCE_MATRIX_LOCATION,
+    // see Shaders/material_vertex_instanced.vs. all copies are drawn at full detail
+    void DrawInstanced(Shader &shader, const glm::mat4 *instances, size_t count);
+    void DrawInstanced(Shader &shader, const std::vector<glm::mat4> &instances);
+    // same, but copies whose bounds (all meshes together) are outside the frustum are
+    // dropped before the upload. records one result per copy in the frustum
+    void DrawInstanced(Shader &shader, const glm::mat4 *instances, size_t count, Frustum &frustum);
+    void DrawInstanced(Shader &shader, const std::vector<glm::mat4> &instances, Frustum &frustum);
     void Framebuffer();
     bool gammaCorrection;
 
@@ -39,12 +110,38 @@ private:
     // using the path passed to the constructor
     std::string directory;
     std::vector<Texture> textures_loaded;
+    ModelLoadOptions options;
+    // per instance model matrices, shared by the VAOs of all meshes. created by the first DrawInstanced
+    unsigned int instanceVBO;
+    size_t instanceCapacity;
+    // the copies the frustum let through, kept so culling doesn't allocate every frame
+    std::vector<glm::mat4> visibleInstances;
+
+    // CPU side result of converting one aiMesh, filled on the worker threads
+    struct MeshData
+    {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        VertexCacheStatistics before;
+        VertexCacheStatistics after;
+        std::vector<MeshLod> lods;
+    };
 
     void loadModel(std::string const &path);
-    void processNode(aiNode *node, const aiScene *scene);
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene);
+    bool loadFromCache(std::string const &path);
+    void processNode(aiNode *node, const aiScene *scene, std::vector<aiMesh *> &nodeMeshes);
+    static void convertMesh(const aiMesh *mesh, MeshData &data, const ModelLoadOptions &options);
+    unsigned int getProcessingFlags() const;
+    GeometryArena *getArena() const;
+    // culls meshes[i] of the copy at model (when there is a frustum, which records the
+    // result) and picks its level of detail, through lodState when there is one.
+    // distance is from the camera to its bounding sphere. false when it is culled
+    bool placeMesh(unsigned int i, const Camera &camera, const glm::mat4 &model, float viewportHeight, Frustum *frustum,
+                   float maxPixelError, LodState *lodState, unsigned int &lod, float &distance) const;
+    Mesh processMesh(aiMesh *mesh, MeshData &data, const aiScene *scene);
     std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type,
                                               std::string typeName);
+    Texture loadTexture(const std::string &path, const std::string &typeName);
 };
 
 #endif
\ No newline at end of file
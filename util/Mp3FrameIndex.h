@@ -0,0 +1,342 @@
+#ifndef MP3FRAMEINDEX_H
+#define MP3FRAMEINDEX_H
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// declarations only, MusicPlayer.h compiles the implementation
+#include "minimp3.h"
+#include "ThreadPool.h"
+
+// Where every MPEG audio frame of an MP3 file starts and which samples it decodes to,
+// found in one pass over the frame headers without decoding anything. ID3v2 tags
+// (leading or appended), the Xing/Info/VBRI frame of VBR files and ID3v1/APE tags at
+// the end are skipped, and garbage between frames is resynced over.
+//
+// Layer III frames borrow up to 511 bytes of the previous frames' data (the bit
+// reservoir) and the synthesis filter carries state from the previous frame, so the
+// index also keeps how far back each frame reaches: decoding from decodeStart(f)
+// gives frame f exactly as a decode from the start of the file would.
+class Mp3FrameIndex
+{
+public:
+    struct Frame
+    {
+        size_t offset;          // of the frame header in the file
+        size_t sample;          // first sample (per channel) the frame decodes to
+        uint16_t bytes;         // header included
+        uint16_t mainDataBegin; // bytes of its data in the previous frames
+        uint16_t mainDataBytes; // bytes of data after its side info
+    };
+
+    // scans the file in memory, false if it holds no MPEG audio frame
+    bool build(const uint8_t *data, size_t size)
+    {
+        frames.clear();
+        sampleRate = channels = samplesPerFrame = 0;
+        dataEnd = 0;
+
+        unsigned char reference[4] = {0, 0, 0, 0};
+        bool haveReference = false;
+        // false after garbage, a header then also needs the next one to agree
+        bool inSync = false;
+        size_t pos = 0;
+        while (pos + 4 <= size)
+        {
+            const uint8_t *at = data + pos;
+            if (std::memcmp(at, "ID3", 3) == 0 && pos + 10 <= size)
+            {
+                pos += id3v2Size(at);
+                inSync = false;
+                continue;
+            }
+            if (isTrailer(data, pos, size))
+                break;
+
+            Header header;
+            if (!parseHeader(at, size - pos, header) || pos + header.bytes > size ||
+                (haveReference && !sameStream(reference, at)) ||
+                (!inSync && !confirmed(data, pos, size, haveReference ? 1 : 3)))
+            {
+                pos++;
+                inSync = false;
+                continue;
+            }
+
+            if (!haveReference)
+            {
+                std::memcpy(reference, at, 4);
+                haveReference = true;
+                sampleRate = header.sampleRate;
+                channels = header.channels;
+                samplesPerFrame = header.samples;
+                // the VBR info frame of the encoder, it holds no audio
+                if (isVbrInfoFrame(at, header))
+                {
+                    pos += header.bytes;
+                    inSync = true;
+                    continue;
+                }
+            }
+
+            Frame frame;
+            frame.offset = pos;
+            frame.sample = frames.size() * (size_t)samplesPerFrame;
+            frame.bytes = (uint16_t)header.bytes;
+            frame.mainDataBegin = (uint16_t)header.mainDataBegin;
+            frame.mainDataBytes = (uint16_t)header.mainDataBytes;
+            frames.push_back(frame);
+            pos += header.bytes;
+            dataEnd = pos;
+            inSync = true;
+        }
+        return !frames.empty();
+    }
+
+    // maps the file for the scan only, nothing of it stays in memory
+    bool buildFromFile(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        size_t size = (size_t)info.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        bool found = build(static_cast<const uint8_t *>(mapped), size);
+        munmap(mapped, size);
+        return found;
+    }
+
+    bool empty() const { return frames.empty(); }
+    size_t getFrameCount() const { return frames.size(); }
+    const Frame &getFrame(size_t index) const { return frames[index]; }
+    int getSampleRate() const { return sampleRate; }
+    int getChannels() const { return channels; }
+    int getSamplesPerFrame() const { return samplesPerFrame; }
+    size_t getTotalSamples() const { return frames.size() * (size_t)samplesPerFrame; }
+    // end of the last frame, trailing tags start here
+    size_t getDataEnd() const { return dataEnd; }
+
+    // the frame that decodes to this sample, O(1): every frame of a stream holds as many samples
+    size_t frameForSample(size_t sample) const
+    {
+        if (frames.empty())
+            return 0;
+        return std::min(sample / (size_t)samplesPerFrame, frames.size() - 1);
+    }
+
+    // first frame to feed the decoder so that frame comes out exactly: the frames before
+    // it that carry the filter history (one, two for MPEG-2/2.5 layer III where a frame
+    // is a single granule) and everything their reservoirs and its own reach back to.
+    // Frames before the requested one may decode to nothing
+    size_t decodeStart(size_t frame) const
+    {
+        size_t history = samplesPerFrame == 576 ? 2 : 1;
+        size_t start = frame > history ? frame - history : 0;
+        for (size_t k = start; k <= frame; k++)
+        {
+            size_t reach = k;
+            int needed = frames[k].mainDataBegin;
+            while (needed > 0 && reach > 0)
+            {
+                reach--;
+                needed -= frames[reach].mainDataBytes;
+            }
+            start = std::min(start, reach);
+        }
+        return start;
+    }
+
+    // decodes frames [first, end) of the file data the index was built from into out,
+    // interleaved, (frames[end].sample - frames[first].sample) * channels samples
+    void decodeRange(const uint8_t *data, size_t first, size_t end, short *out) const
+    {
+        mp3dec_t decoder;
+        mp3dec_frame_info_t info;
+        mp3dec_init(&decoder);
+        short pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+        size_t base = frames[first].sample;
+
+        for (size_t k = decodeStart(first); k < end; k++)
+        {
+            const Frame &frame = frames[k];
+            // exactly one frame: minimp3 then takes it as it is, instead of checking it
+            // against what follows (a tag, garbage) and resyncing somewhere else
+            int samples = mp3dec_decode_frame(&decoder, data + frame.offset, frame.bytes, pcm, &info);
+            // warm-up frames fill the reservoir only, a frame that fails stays silent
+            if (k < first || samples <= 0 || info.channels != channels)
+                continue;
+            std::memcpy(out + (frame.sample - base) * channels, pcm, (size_t)samples * channels * sizeof(short));
+        }
+    }
+
+    // decodes the whole stream into out, chunks of frames in parallel on the pool
+    void decodeParallel(const uint8_t *data, std::vector<short> &out, size_t chunkFrames = 256,
+                        ThreadPool &pool = ThreadPool::shared()) const
+    {
+        out.assign(getTotalSamples() * channels, 0);
+        size_t chunks = (frames.size() + chunkFrames - 1) / chunkFrames;
+        pool.parallelFor(chunks, [&](size_t chunk)
+                         {
+                             size_t first = chunk * chunkFrames;
+                             size_t end = std::min(frames.size(), first + chunkFrames);
+                             decodeRange(data, first, end, out.data() + frames[first].sample * channels); });
+    }
+
+private:
+    struct Header
+    {
+        int layer;
+        int sampleRate;
+        int channels;
+        int samples;
+        int bytes;
+        bool crc;
+        bool mpeg1;
+        int sideInfoBytes;
+        int mainDataBegin;
+        int mainDataBytes;
+    };
+
+    std::vector<Frame> frames;
+    int sampleRate = 0;
+    int channels = 0;
+    int samplesPerFrame = 0;
+    size_t dataEnd = 0;
+
+    // kbps by [MPEG-1 ? 0 : 1][layer - 1][bitrate index]
+    static int bitrateKbps(bool mpeg1, int layer, int index)
+    {
+        static const short table[2][3][15] = {
+            {{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+             {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+             {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}},
+            {{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+             {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+             {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}}};
+        return table[mpeg1 ? 0 : 1][layer - 1][index];
+    }
+
+    // false for anything that is not a frame header minimp3 decodes (free format included),
+    // and when the left bytes at h end before the part of the side info that is read
+    static bool parseHeader(const uint8_t *h, size_t left, Header &header)
+    {
+        if (left < 4 || h[0] != 0xFF || (h[1] & 0xE0) != 0xE0)
+            return false;
+        int version = (h[1] >> 3) & 3; // 3 MPEG-1, 2 MPEG-2, 0 MPEG-2.5
+        int layerBits = (h[1] >> 1) & 3;
+        int bitrateIndex = h[2] >> 4;
+        int rateIndex = (h[2] >> 2) & 3;
+        if (version == 1 || layerBits == 0 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+            return false;
+
+        static const int baseRates[3] = {44100, 48000, 32000};
+        header.layer = 4 - layerBits;
+        header.mpeg1 = version == 3;
+        header.sampleRate = baseRates[rateIndex] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+        header.channels = (h[3] >> 6) == 3 ? 1 : 2;
+        header.crc = !(h[1] & 1);
+        int padding = (h[2] >> 1) & 1;
+        int bitrate = bitrateKbps(header.mpeg1, header.layer, bitrateIndex) * 1000;
+
+        if (header.layer == 1)
+        {
+            header.samples = 384;
+            header.bytes = (12 * bitrate / header.sampleRate + padding) * 4;
+        }
+        else
+        {
+            header.samples = header.layer == 3 && !header.mpeg1 ? 576 : 1152;
+            header.bytes = header.samples / 8 * bitrate / header.sampleRate + padding;
+        }
+
+        header.sideInfoBytes = 0;
+        header.mainDataBegin = 0;
+        header.mainDataBytes = 0;
+        if (header.layer == 3)
+        {
+            bool mono = header.channels == 1;
+            header.sideInfoBytes = header.mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+            size_t sideOffset = 4 + (header.crc ? 2 : 0);
+            if (sideOffset + 2 > left)
+                return false;
+            const uint8_t *side = h + sideOffset;
+            header.mainDataBegin = header.mpeg1 ? (side[0] << 1) | (side[1] >> 7) : side[0];
+            header.mainDataBytes = std::max(0, header.bytes - 4 - (header.crc ? 2 : 0) - header.sideInfoBytes);
+        }
+        return header.bytes > 4;
+    }
+
+    // same version, layer and sample rate, what minimp3 expects of consecutive frames
+    static bool sameStream(const uint8_t *a, const uint8_t *b)
+    {
+        return ((a[1] ^ b[1]) & 0xFE) == 0 && ((a[2] ^ b[2]) & 0x0C) == 0;
+    }
+
+    // a header found after garbage counts if the next ones (more of them for the very
+    // first frame) belong to the same stream, or the data or the stream ends first
+    static bool confirmed(const uint8_t *data, size_t pos, size_t size, int following)
+    {
+        const uint8_t *first = data + pos;
+        Header header;
+        while (following-- > 0)
+        {
+            if (!parseHeader(data + pos, size - pos, header))
+                return false;
+            pos += header.bytes;
+            if (pos == size || isTrailer(data, pos, size))
+                return true;
+            if (pos + 4 > size || !parseHeader(data + pos, size - pos, header) || !sameStream(first, data + pos) ||
+                pos + header.bytes > size)
+                return false;
+        }
+        return true;
+    }
+
+    static bool isTrailer(const uint8_t *data, size_t pos, size_t size)
+    {
+        size_t left = size - pos;
+        return (left >= 3 && std::memcmp(data + pos, "TAG", 3) == 0) ||
+               (left >= 8 && std::memcmp(data + pos, "APETAGEX", 8) == 0) ||
+               (left >= 6 && std::memcmp(data + pos, "LYRICS", 6) == 0) ||
+               (left >= 3 && std::memcmp(data + pos, "ID3", 3) == 0);
+    }
+
+    // header, syncsafe size and the optional footer
+    static size_t id3v2Size(const uint8_t *tag)
+    {
+        size_t size = ((size_t)(tag[6] & 0x7F) << 21) | ((size_t)(tag[7] & 0x7F) << 14) |
+                      ((size_t)(tag[8] & 0x7F) << 7) | (size_t)(tag[9] & 0x7F);
+        return 10 + size + ((tag[5] & 0x10) ? 10 : 0);
+    }
+
+    // "Xing"/"Info" right after the side info, "VBRI" 32 bytes after the header
+    static bool isVbrInfoFrame(const uint8_t *frame, const Header &header)
+    {
+        if (header.layer != 3)
+            return false;
+        int xing = 4 + (header.crc ? 2 : 0) + header.sideInfoBytes;
+        if (xing + 4 <= header.bytes &&
+            (std::memcmp(frame + xing, "Xing", 4) == 0 || std::memcmp(frame + xing, "Info", 4) == 0))
+            return true;
+        return 36 + 4 <= header.bytes && std::memcmp(frame + 36, "VBRI", 4) == 0;
+    }
+};
+
+#endif
@@ -17,26 +17,34 @@
 #include <algorithm>
 #include <cmath>
 #include <complex>
+#include <atomic>
+#include <mutex>
+#include <memory>
 #include "SimpleFFT.h"
+#include "TripleBuffer.h"
+#include "StftAnalyzer.h"
+#include "AudioFeatures.h"
+#include "AnalysisCache.h"
+#include "BeatTracker.h"
 
 // Minimp3 header-only library for MP3 support
 #define MINIMP3_IMPLEMENTATION
 #include "minimp3.h"
+#include "AudioDecoder.h"
 
 // M4A/AAC support - using alternative approach without mp4v2
 // We'll use a simplified version that works with basic M4A files
 #include <fstream>
 #include <map>
 
-struct AudioAnalysis
+// what the audio thread hands to the render thread
+struct PlaybackState
 {
-    double bassLevel;                   // 20-250 Hz
-    double midLevel;                    // 250-4000 Hz
-    double trebleLevel;                 // 4000-20000 Hz
-    double overallRMS;                  // Root Mean Square (volume)
-    double peakLevel;                   // Peak amplitude
-    double dynamicRange;                // Difference between peak and average
-    std::vector<double> frequencyBands; // 10 frequency bands
+    double seconds;         // playback position
+    bool playing;           // false once the track is over or stopped
+    bool hasAnalysis;       // false until the first STFT frame
+    AudioAnalysis analysis; // of the latest STFT frame, ending at the playback position
+    BeatState beat;         // onsets and beats up to the playback position
 };
 
 class MusicPlayer
@@ -52,8 +60,6 @@ private:
     SF_INFO audioInfo;
 
     // For MP3 files
-    mp3dec_t mp3Decoder;
-    mp3dec_frame_info_t mp3FrameInfo;
     std::ifstream mp3FileStream;
     std::vector<uint8_t> mp3Buffer;
     bool isMp3File;
@@ -79,14 +85,84 @@ private:
     size_t analysisBufferSize;
     size_t currentPlayPosition;
 
+    // FFT work buffers, reused by every analysis so the per-frame path does not allocate
+    AudioSimd::AlignedVector<float> fftInput;
+    std::vector<std::complex<float>> fftBins;
+    std::vector<float> fftMagnitudes;
+
+    // Streaming mode: a decoder thread keeps STREAM_BUFFER_COUNT buffers of
+    // STREAM_BUFFER_MS each queued on the source, so memory and the time to the
+    // first sound do not depend on the length of the track. The analysis reads the
+    // last STREAM_HISTORY_SECONDS of decoded samples instead of audioData
+    static const int STREAM_BUFFER_COUNT = 4;
+    static const int STREAM_BUFFER_MS = 100;
+    static const int STREAM_HISTORY_SECONDS = 4;
+    bool streaming;
+    std::unique_ptr<AudioDecoder> streamDecoder;
+    ALuint streamBuffers[STREAM_BUFFER_COUNT];
+    size_t streamBufferFrames[STREAM_BUFFER_COUNT];
+    ALenum streamFormat;
+    std::vector<short> streamChunk;
+    // guards streamPlayedFrames against the source offset and the history ring
+    std::mutex streamMutex;
+    size_t streamPlayedFrames; // frames of the buffers already played and unqueued
+    std::vector<short> streamHistory;
+    size_t streamHistoryEnd; // absolute index of the sample after the newest one
+    std::vector<short> segmentScratch;
+
+    // Playback runs on its own audio thread: it refills the stream, watches the source,
+    // feeds the samples played since its last pass to the STFT and publishes a
+    // PlaybackState after new frames, which the render thread picks up without
+    // locking (see TripleBuffer)
+    std::thread audioThread;
+    std::atomic<bool> audioRunning;
+    std::atomic<bool> playbackActive;
+    TripleBuffer<PlaybackState> published;
+
+    // runtime analysis: one STFT frame per hop of played samples
+    double analysisRate;
+    size_t analysisFrameSize;
+    WindowFunction analysisWindow;
+    StftAnalyzer stft;
+    size_t stftFedFrame; // first frame not given to the STFT yet
+    AudioSimd::AlignedVector<float> stftMono;
+    AudioAnalysis stftAnalysis;
+    bool analysisReady; // a first frame was analyzed since start()
+
+    // onsets and beats, one onset strength per STFT frame (live or from the sidecar)
+    BeatTracker beats;
+    std::vector<float> onsetPrevious;
+    size_t stftSkipped; // frames never given to the STFT, frame n ends at stftSkipped + n * hop
+
+    // band layout of AudioAnalysis::frequencyBands, changeable while playing: the
+    // audio thread picks a new one up on its next pass
+    std::mutex bandMutex;
+    FilterbankConfig bandConfig;
+    std::atomic<bool> bandsChanged;
+    BandAnalyzer segmentBands; // analyzeAudioSegment, caller's thread
+    BandAnalyzer stftBands;    // audio thread
+
+    // precomputed analysis from the sidecar file, replaces the STFT when open
+    bool usePrecomputedAnalysis;
+    AnalysisCache analysisCache;
+    const AnalysisFrame *lastCachedFrame;
+    bool cacheHasBands; // the sidecar was built with the band layout in use
+
 public:
     MusicPlayer() : device(nullptr), context(nullptr), source(0), buffer(0),
                     audioFile(nullptr), isMp3File(false), isM4aFile(false),
                     isInitialized(false), sampleRate(0), channels(0), totalFrames(0), duration(0.0),
-                    analysisBufferSize(2048), currentPlayPosition(0)
+                    analysisBufferSize(2048), currentPlayPosition(0),
+                    streaming(false), streamFormat(0),
+                    streamPlayedFrames(0), streamHistoryEnd(0),
+                    audioRunning(false), playbackActive(false),
+                    analysisRate(60.0), analysisFrameSize(2048), analysisWindow(WindowFunction::Hann),
+                    stftFedFrame(0), analysisReady(false), stftSkipped(0), bandsChanged(false),
+                    usePrecomputedAnalysis(false), lastCachedFrame(nullptr), cacheHasBands(false)
     {
+        memset(streamBuffers, 0, sizeof(streamBuffers));
+        memset(streamBufferFrames, 0, sizeof(streamBufferFrames));
         memset(&audioInfo, 0, sizeof(audioInfo));
-        memset(&mp3FrameInfo, 0, sizeof(mp3FrameInfo));
         memset(&currentAnalysis, 0, sizeof(currentAnalysis));
     }
 
@@ -128,118 +204,92 @@ public:
         return true;
     }
 
+private:
+    // segmentSamples hands out segmentScratch, which feedAnalysis reuses on the audio
+    // thread: a caller outside would race it. loadMusic analyzes before start()
     AudioAnalysis analyzeAudioSegment(size_t startSample, size_t numSamples)
     {
         AudioAnalysis analysis;
         memset(&analysis, 0, sizeof(analysis));
 
-        if (startSample >= audioData.size() || numSamples == 0)
+        if (numSamples == 0)
         {
             return analysis;
         }
 
         // Ensure we don't go beyond audio data
-        numSamples = std::min(numSamples, audioData.size() - startSample);
-
-        // Convert to mono if stereo for analysis
-        std::vector<double> monoData;
-        for (size_t i = startSample; i < startSample + numSamples; i += channels)
+        const short *segment = segmentSamples(startSample, numSamples);
+        if (!segment)
         {
-            if (channels == 1)
-            {
-                monoData.push_back(audioData[i] / 32768.0); // Normalize to [-1, 1]
-            }
-            else
-            {
-                // Average stereo channels
-                double sample = audioData[i] / 32768.0;
-                if (i + 1 < audioData.size())
-                {
-                    sample = (sample + audioData[i + 1] / 32768.0) / 2.0;
-                }
-                monoData.push_back(sample);
-            }
+            return analysis;
         }
 
-        if (monoData.empty())
+        // mono floats straight into the FFT input, padded to a power of 2
+        size_t frames = numSamples / channels;
+        if (frames == 0)
             return analysis;
+        size_t fftSize = 1;
+        while (fftSize < frames)
+            fftSize *= 2;
+        fftInput.resize(fftSize);
+        const AudioKernels &kernels = AudioSimd::kernels();
+        kernels.toMono(segment, fftInput.data(), frames, channels);
+        std::fill(fftInput.begin() + frames, fftInput.end(), 0.0f);
 
         // Calculate RMS (volume level)
         double sumSquares = 0.0;
-        double peak = 0.0;
-        for (double sample : monoData)
-        {
-            sumSquares += sample * sample;
-            peak = std::max(peak, std::abs(sample));
-        }
-        analysis.overallRMS = sqrt(sumSquares / monoData.size());
+        float peak = 0.0f;
+        kernels.levels(fftInput.data(), frames, &sumSquares, &peak);
+        analysis.overallRMS = sqrt(sumSquares / frames);
         analysis.peakLevel = peak;
         analysis.dynamicRange = peak - analysis.overallRMS;
 
-        // Pad to power of 2 for FFT
-        size_t fftSize = 1;
-        while (fftSize < monoData.size())
-            fftSize *= 2;
+        // Perform FFT, the input is real so only bins 0..fftSize/2 are computed
+        const RealFFTPlanFloat &plan = SimpleFFT::realPlan<float>(fftSize);
+        fftBins.resize(plan.bins());
+        fftMagnitudes.resize(plan.bins());
+        plan.forward(fftInput.data(), fftBins.data());
+        SimpleFFT::getMagnitudes(fftBins.data(), fftBins.size(), fftMagnitudes.data());
+        segmentBands.configure(getFrequencyBands(), sampleRate, fftSize);
+        segmentBands.analyze(fftMagnitudes.data(), analysis);
 
-        std::vector<std::complex<double>> fftData(fftSize);
-        for (size_t i = 0; i < monoData.size(); i++)
-        {
-            fftData[i] = std::complex<double>(monoData[i], 0.0);
-        }
-
-        // Perform FFT
-        SimpleFFT::fft(fftData);
-        std::vector<double> magnitudes = SimpleFFT::getMagnitudes(fftData);
-
-        // Calculate frequency bins
-        double binSize = (double)sampleRate / fftSize;
-
-        // Define frequency ranges
-        int bassEnd = (int)(250.0 / binSize);
-        int midEnd = (int)(4000.0 / binSize);
-        int trebleEnd = std::min((int)(20000.0 / binSize), (int)(magnitudes.size() / 2));
-
-        // Calculate bass level (20-250 Hz)
-        double bassSum = 0.0;
-        for (int i = 1; i < bassEnd && i < magnitudes.size() / 2; i++)
-        {
-            bassSum += magnitudes[i];
-        }
-        analysis.bassLevel = bassSum / std::max(1, bassEnd - 1);
-
-        // Calculate mid level (250-4000 Hz)
-        double midSum = 0.0;
-        for (int i = bassEnd; i < midEnd && i < magnitudes.size() / 2; i++)
-        {
-            midSum += magnitudes[i];
-        }
-        analysis.midLevel = midSum / std::max(1, midEnd - bassEnd);
+        return analysis;
+    }
 
-        // Calculate treble level (4000-20000 Hz)
-        double trebleSum = 0.0;
-        for (int i = midEnd; i < trebleEnd && i < magnitudes.size() / 2; i++)
+    // the interleaved samples [startSample, startSample + numSamples), numSamples is cut
+    // to what is there. A stream only has its history ring, copied out under the lock
+    const short *segmentSamples(size_t startSample, size_t &numSamples)
+    {
+        if (!streaming)
         {
-            trebleSum += magnitudes[i];
+            if (startSample >= audioData.size())
+                return nullptr;
+            numSamples = std::min(numSamples, audioData.size() - startSample);
+            return audioData.data() + startSample;
         }
-        analysis.trebleLevel = trebleSum / std::max(1, trebleEnd - midEnd);
-
-        // Calculate 10 frequency bands for detailed analysis
-        analysis.frequencyBands.resize(10);
-        int bandsPerBin = (magnitudes.size() / 2) / 10;
-        for (int band = 0; band < 10; band++)
-        {
-            double bandSum = 0.0;
-            int startBin = band * bandsPerBin + 1; // Skip DC component
-            int endBin = std::min((band + 1) * bandsPerBin, (int)(magnitudes.size() / 2));
 
-            for (int i = startBin; i < endBin; i++)
-            {
-                bandSum += magnitudes[i];
-            }
-            analysis.frequencyBands[band] = bandSum / std::max(1, endBin - startBin);
-        }
+        std::lock_guard<std::mutex> lock(streamMutex);
+        size_t capacity = streamHistory.size();
+        size_t oldest = streamHistoryEnd > capacity ? streamHistoryEnd - capacity : 0;
+        if (capacity == 0 || startSample < oldest || startSample >= streamHistoryEnd)
+            return nullptr;
+        numSamples = std::min(numSamples, streamHistoryEnd - startSample);
+        segmentScratch.resize(numSamples);
+        size_t first = startSample % capacity;
+        size_t head = std::min(numSamples, capacity - first);
+        memcpy(segmentScratch.data(), streamHistory.data() + first, head * sizeof(short));
+        memcpy(segmentScratch.data() + head, streamHistory.data(), (numSamples - head) * sizeof(short));
+        return segmentScratch.data();
+    }
 
-        return analysis;
+public:
+    // one past the last sample the analysis can read
+    size_t availableSamples()
+    {
+        if (!streaming)
+            return audioData.size();
+        std::lock_guard<std::mutex> lock(streamMutex);
+        return streamHistoryEnd;
     }
 
     void printAudioAnalysis(const AudioAnalysis &analysis)
@@ -254,12 +304,17 @@ public:
         std::cout << "Dynamic Range: " << analysis.dynamicRange << std::endl;
 
         // Visual frequency bands display
-        std::cout << "\nFrequency Bands (10 bands): " << std::endl;
+        const Filterbank &bands = segmentBands.getBands();
+        bool labeled = bands.getBandCount() == analysis.frequencyBands.size();
+        std::cout << "\nFrequency Bands (" << analysis.frequencyBands.size() << " bands): " << std::endl;
         for (int i = 0; i < analysis.frequencyBands.size(); i++)
         {
             double normalized = std::min(analysis.frequencyBands[i] * 100, 50.0); // Scale for display
             int barLength = (int)(normalized);
-            std::cout << "Band " << std::setw(2) << (i + 1) << ": ";
+            std::cout << "Band " << std::setw(2) << (i + 1);
+            if (labeled)
+                std::cout << " " << std::setw(7) << std::setprecision(0) << bands.getCenterHz(i) << " Hz";
+            std::cout << ": ";
             for (int j = 0; j < barLength && j < 50; j++)
             {
                 std::cout << "█";
@@ -314,49 +369,21 @@ public:
         mp3FileStream.read(reinterpret_cast<char *>(mp3Buffer.data()), fileSize);
         mp3FileStream.close();
 
-        // Initialize MP3 decoder
-        mp3dec_init(&mp3Decoder);
-
-        // Decode MP3 data
-        audioData.clear();
-        size_t offset = 0;
-        short pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
-        int samples = 0;
-        int totalSamples = 0;
-        bool firstFrame = true;
-
-        while (offset < mp3Buffer.size())
+        // one pass over the frame headers, then chunks of frames decode on all cores
+        Mp3FrameIndex frameIndex;
+        if (!frameIndex.build(mp3Buffer.data(), mp3Buffer.size()))
         {
-            samples = mp3dec_decode_frame(&mp3Decoder, mp3Buffer.data() + offset,
-                                          mp3Buffer.size() - offset, pcm, &mp3FrameInfo);
-
-            if (samples == 0)
-            {
-                // Skip non-audio data
-                offset += 1;
-                continue;
-            }
-
-            if (firstFrame)
-            {
-                // Set audio properties from first frame
-                sampleRate = mp3FrameInfo.hz;
-                channels = mp3FrameInfo.channels;
-                formatName = "MP3";
-                firstFrame = false;
-            }
-
-            // Add decoded samples to audio data
-            for (int i = 0; i < samples * channels; i++)
-            {
-                audioData.push_back(pcm[i]);
-            }
-
-            totalSamples += samples;
-            offset += mp3FrameInfo.frame_bytes;
+            std::cerr << "Error: No audio data decoded from MP3 file" << std::endl;
+            return false;
         }
-
-        totalFrames = totalSamples;
+        sampleRate = frameIndex.getSampleRate();
+        channels = frameIndex.getChannels();
+        formatName = "MP3";
+        frameIndex.decodeParallel(mp3Buffer.data(), audioData);
+        mp3Buffer.clear();
+        mp3Buffer.shrink_to_fit();
+
+        totalFrames = frameIndex.getTotalSamples();
         duration = (double)totalFrames / sampleRate;
 
         if (audioData.empty())
@@ -421,6 +448,341 @@ public:
         return true;
     }
 
+    // 0 for channel counts OpenAL can not play. Surround formats come with the
+    // AL_EXT_MCFORMATS extension (OpenAL Soft has it), their values are looked up
+    static ALenum openALFormat(int channelCount)
+    {
+        if (channelCount == 1)
+            return AL_FORMAT_MONO16;
+        if (channelCount == 2)
+            return AL_FORMAT_STEREO16;
+        const char *name = channelCount == 4   ? "AL_FORMAT_QUAD16"
+                           : channelCount == 6 ? "AL_FORMAT_51CHN16"
+                           : channelCount == 7 ? "AL_FORMAT_61CHN16"
+                           : channelCount == 8 ? "AL_FORMAT_71CHN16"
+                                               : nullptr;
+        if (!name || !alIsExtensionPresent("AL_EXT_MCFORMATS"))
+            return 0;
+        ALenum format = alGetEnumValue(name);
+        return format > 0 ? format : 0;
+    }
+
+    // decode while playing instead of loading the whole track, call before loadMusic
+    void setStreaming(bool enabled)
+    {
+        streaming = enabled;
+    }
+
+    bool isStreaming() const
+    {
+        return streaming;
+    }
+
+    // decodes the next STREAM_BUFFER_MS into stream buffer slot, false at the end of the track
+    bool fillStreamBuffer(int slot)
+    {
+        size_t frames = streamDecoder->read(streamChunk.data(), streamChunk.size() / channels);
+        streamBufferFrames[slot] = frames;
+        if (frames == 0)
+            return false;
+
+        size_t count = frames * channels;
+        {
+            std::lock_guard<std::mutex> lock(streamMutex);
+            size_t capacity = streamHistory.size();
+            for (size_t i = 0; i < count; i++)
+                streamHistory[(streamHistoryEnd + i) % capacity] = streamChunk[i];
+            streamHistoryEnd += count;
+        }
+        alBufferData(streamBuffers[slot], streamFormat, streamChunk.data(), (ALsizei)(count * sizeof(short)), sampleRate);
+        return true;
+    }
+
+    int streamSlot(ALuint streamBuffer) const
+    {
+        for (int i = 0; i < STREAM_BUFFER_COUNT; i++)
+        {
+            if (streamBuffers[i] == streamBuffer)
+                return i;
+        }
+        return 0;
+    }
+
+    // opens the decoder and queues the first buffers, the rest is decoded by serviceStream
+    bool loadStream(const std::string &filePath)
+    {
+        if (isM4aFile)
+        {
+            return loadM4A(filePath);
+        }
+        streamDecoder = openAudioDecoder(filePath);
+        if (!streamDecoder)
+        {
+            return false;
+        }
+
+        sampleRate = streamDecoder->getSampleRate();
+        channels = streamDecoder->getChannels();
+        totalFrames = (int)streamDecoder->getTotalFrames();
+        duration = (double)totalFrames / sampleRate;
+        formatName = streamDecoder->getFormatName();
+
+        printMusicInfo(filePath);
+
+        streamFormat = openALFormat(channels);
+        if (!streamFormat)
+        {
+            // no OpenAL format for this layout, the stream is folded down to stereo as it is decoded
+            std::cerr << "Warning: No OpenAL format for " << channels << " channels, downmixing to stereo" << std::endl;
+            streamDecoder.reset(new DownmixDecoder(std::move(streamDecoder)));
+            channels = 2;
+            streamFormat = AL_FORMAT_STEREO16;
+        }
+
+        streamChunk.resize((size_t)sampleRate * STREAM_BUFFER_MS / 1000 * channels);
+        streamHistory.assign((size_t)sampleRate * channels * STREAM_HISTORY_SECONDS, 0);
+        streamHistoryEnd = 0;
+        streamPlayedFrames = 0;
+
+        alGenBuffers(STREAM_BUFFER_COUNT, streamBuffers);
+        int primed = 0;
+        while (primed < STREAM_BUFFER_COUNT && fillStreamBuffer(primed))
+            primed++;
+        if (primed == 0)
+        {
+            std::cerr << "Error: No audio data decoded from " << filePath << std::endl;
+            return false;
+        }
+        alSourceQueueBuffers(source, primed, streamBuffers);
+
+        if (alGetError() != AL_NO_ERROR)
+        {
+            std::cerr << "Error: Failed to queue the stream buffers" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // refills every buffer the source finished with and restarts the source if it
+    // ran dry. false once the last buffer has been played
+    bool serviceStream()
+    {
+        ALint processed = 0;
+        alGetSourcei(source, AL_BUFFERS_PROCESSED, &processed);
+        for (; processed > 0; processed--)
+        {
+            ALuint done = 0;
+            int slot = 0;
+            {
+                // unqueueing moves the source offset back, keep both in step
+                std::lock_guard<std::mutex> lock(streamMutex);
+                alSourceUnqueueBuffers(source, 1, &done);
+                slot = streamSlot(done);
+                streamPlayedFrames += streamBufferFrames[slot];
+            }
+            if (fillStreamBuffer(slot))
+                alSourceQueueBuffers(source, 1, &done);
+        }
+
+        ALint queued = 0, state = 0;
+        alGetSourcei(source, AL_BUFFERS_QUEUED, &queued);
+        alGetSourcei(source, AL_SOURCE_STATE, &state);
+        if (queued == 0)
+            return false;
+        if (state != AL_PLAYING && state != AL_PAUSED)
+            alSourcePlay(source);
+        return true;
+    }
+
+    // gives the STFT the frames played since the last call, true if that completed a frame
+    bool feedAnalysis(double seconds)
+    {
+        size_t playedFrame = (size_t)(seconds * sampleRate);
+        size_t frameSize = stft.getFrameSize();
+        // after a stall or at the start only the last frame matters
+        if (playedFrame > stftFedFrame + frameSize)
+        {
+            stftSkipped += playedFrame - frameSize - stftFedFrame;
+            stftFedFrame = playedFrame - frameSize;
+        }
+        if (playedFrame <= stftFedFrame)
+        {
+            return false;
+        }
+
+        size_t numSamples = (playedFrame - stftFedFrame) * channels;
+        const short *segment = segmentSamples(stftFedFrame * channels, numSamples);
+        if (!segment)
+        {
+            // not decoded or already dropped from the stream history
+            stftSkipped += playedFrame - stftFedFrame;
+            stftFedFrame = playedFrame;
+            return false;
+        }
+        size_t frames = numSamples / channels;
+        stftFedFrame += frames;
+
+        stftMono.resize(frames);
+        AudioSimd::kernels().toMono(segment, stftMono.data(), frames, channels);
+
+        unsigned long long before = stft.getFrameCount();
+        size_t hop = stft.getHopSize();
+        stft.push(stftMono.data(), frames, [&](const StftAnalyzer &analyzer)
+                  {
+                      double strength = AudioFeatures::onsetStrength(analyzer.getMagnitudes().data(), onsetPrevious.data(), frameSize);
+                      double centre = (stftSkipped + analyzer.getFrameCount() * hop - frameSize / 2.0) / sampleRate;
+                      beats.process(strength, centre); });
+        if (stft.getFrameCount() == before)
+        {
+            return false;
+        }
+
+        stftAnalysis.overallRMS = stft.getRMS();
+        stftAnalysis.peakLevel = stft.getPeak();
+        stftAnalysis.dynamicRange = stftAnalysis.peakLevel - stftAnalysis.overallRMS;
+        stftBands.analyze(stft.getMagnitudes().data(), stftAnalysis);
+        analysisReady = true;
+        return true;
+    }
+
+    // takes the precomputed hop of the playback position, true if it is a new one
+    bool lookupAnalysis(double seconds)
+    {
+        const AnalysisFrame *frame = analysisCache.at(seconds);
+        if (!frame || frame == lastCachedFrame)
+        {
+            return false;
+        }
+        // the tracker gets every hop since the last pass, at most the seconds it looks back
+        size_t hop = analysisCache.getHopSize();
+        size_t index = analysisCache.indexOf(frame);
+        size_t catchUp = (size_t)(8.0 * beats.getFramesPerSecond());
+        size_t first = index >= catchUp ? index - catchUp : 0;
+        if (lastCachedFrame && lastCachedFrame < frame)
+            first = std::max(first, analysisCache.indexOf(lastCachedFrame) + 1);
+        else
+            beats.reset();
+        for (size_t i = first; i <= index; i++)
+        {
+            double centre = ((i + 1) * hop - stft.getFrameSize() / 2.0) / sampleRate;
+            beats.process(frame[(ptrdiff_t)i - (ptrdiff_t)index].onset, centre);
+        }
+        lastCachedFrame = frame;
+
+        stftAnalysis.bassLevel = frame->bass;
+        stftAnalysis.midLevel = frame->mid;
+        stftAnalysis.trebleLevel = frame->treble;
+        stftAnalysis.overallRMS = frame->rms;
+        stftAnalysis.peakLevel = frame->peak;
+        stftAnalysis.dynamicRange = frame->peak - frame->rms;
+        const float *bands = analysisCache.bandsAt(frame);
+        stftAnalysis.frequencyBands.assign(bands, bands + analysisCache.getBandCount());
+        analysisReady = true;
+        return true;
+    }
+
+    // opens (or builds) the sidecar analysis when asked to, the live STFT is the fallback
+    bool loadPrecomputedAnalysis(const std::string &filePath)
+    {
+        if (!usePrecomputedAnalysis)
+        {
+            return true;
+        }
+        size_t hop = StftAnalyzer::hopForRate(sampleRate, analysisRate);
+        auto begin = std::chrono::steady_clock::now();
+        if (!analysisCache.openOrBuild(filePath, analysisFrameSize, hop, analysisWindow, getFrequencyBands()))
+        {
+            std::cerr << "Warning: No precomputed analysis for " << filePath << ", analyzing live" << std::endl;
+            return true;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "Precomputed analysis: " << analysisCache.getFrameCount() << " hops ("
+                  << std::fixed << std::setprecision(1) << ms << " ms)" << std::endl;
+        return true;
+    }
+
+    // audio thread (or start()): rebuilds the live filterbank for the current band
+    // layout, the sidecar is only used while it was made with the same one
+    void applyFrequencyBands()
+    {
+        FilterbankConfig config = getFrequencyBands();
+        stftBands.configure(config, sampleRate, stft.getFrameSize());
+        cacheHasBands = analysisCache.isOpen() && analysisCache.getBands() == config;
+    }
+
+    void publishState(double seconds, bool playing)
+    {
+        PlaybackState &state = published.back();
+        state.seconds = seconds;
+        state.playing = playing;
+        state.hasAnalysis = analysisReady;
+        state.analysis = stftAnalysis;
+        state.beat = beats.getState();
+        published.publish();
+    }
+
+    // audio thread: the only place that talks to OpenAL while playing
+    void audioLoop()
+    {
+        // wake up about twice per hop, so frames go out close to when they were played
+        double hopMs = 1000.0 * stft.getHopSize() / sampleRate;
+        auto tick = std::chrono::microseconds((long long)(std::min(10.0, std::max(1.0, hopMs / 2.0)) * 1000.0));
+
+        while (audioRunning)
+        {
+            bool playing;
+            if (streaming)
+            {
+                playing = serviceStream();
+            }
+            else
+            {
+                ALint state;
+                alGetSourcei(source, AL_SOURCE_STATE, &state);
+                playing = state == AL_PLAYING;
+            }
+
+            double seconds = getPlaybackSeconds();
+            if (bandsChanged.exchange(false))
+            {
+                applyFrequencyBands();
+            }
+            bool fresh = cacheHasBands ? lookupAnalysis(seconds) : feedAnalysis(seconds);
+            if (fresh || !playing)
+            {
+                publishState(seconds, playing);
+            }
+            if (!playing)
+                break;
+            std::this_thread::sleep_for(tick);
+        }
+        playbackActive = false;
+    }
+
+    // seconds played, in both modes
+    double getPlaybackSeconds()
+    {
+        if (!streaming)
+        {
+            ALfloat offsetSeconds = 0.0f;
+            alGetSourcef(source, AL_SEC_OFFSET, &offsetSeconds);
+            return offsetSeconds;
+        }
+        if (sampleRate == 0)
+            return 0.0;
+        // the offset counts from the first buffer still queued
+        std::lock_guard<std::mutex> lock(streamMutex);
+        ALint sampleOffset = 0;
+        alGetSourcei(source, AL_SAMPLE_OFFSET, &sampleOffset);
+        return (double)(streamPlayedFrames + sampleOffset) / sampleRate;
+    }
+
+    // between start() and the end of the track or stop()
+    bool isPlaying() const
+    {
+        return playbackActive;
+    }
+
     bool loadMusic(const std::string &filePath)
     {
         if (!isInitialized)
@@ -433,6 +795,11 @@ public:
         isMp3File = isMP3File(filePath);
         isM4aFile = isM4AFile(filePath);
 
+        if (streaming)
+        {
+            return loadStream(filePath) && loadPrecomputedAnalysis(filePath);
+        }
+
         bool loadSuccess = false;
         if (isMp3File)
         {
@@ -461,20 +828,17 @@ public:
         printAudioAnalysis(currentAnalysis);
 
         // Determine OpenAL format
-        ALenum format;
-        if (channels == 1)
-        {
-            format = AL_FORMAT_MONO16;
-        }
-        else if (channels == 2)
+        ALenum format = openALFormat(channels);
+        if (!format)
         {
+            std::cerr << "Warning: No OpenAL format for " << channels << " channels, downmixing to stereo" << std::endl;
+            size_t frames = audioData.size() / channels;
+            StereoDownmix(channels).apply(audioData.data(), audioData.data(), frames);
+            audioData.resize(frames * 2);
+            audioData.shrink_to_fit();
+            channels = 2;
             format = AL_FORMAT_STEREO16;
         }
-        else
-        {
-            std::cerr << "Error: Unsupported channel count: " << channels << std::endl;
-            return false;
-        }
 
         // Upload audio data to OpenAL buffer
         alBufferData(buffer, format, audioData.data(),
@@ -489,7 +853,7 @@ public:
         // Attach buffer to source
         alSourcei(source, AL_BUFFER, buffer);
 
-        return true;
+        return loadPrecomputedAnalysis(filePath);
     }
 
     void printMusicInfo(const std::string &filePath)
@@ -503,7 +867,11 @@ public:
         std::cout << "Duration: " << std::fixed << std::setprecision(2)
                   << duration << " seconds" << std::endl;
 
-        if (isMp3File)
+        if (streaming)
+        {
+            std::cout << "Streaming: " << STREAM_BUFFER_COUNT << " buffers of " << STREAM_BUFFER_MS << " ms" << std::endl;
+        }
+        else if (isMp3File)
         {
             std::cout << "MP3 Info: " << audioData.size() << " total samples decoded" << std::endl;
         }
@@ -512,40 +880,130 @@ public:
                   << std::endl;
     }
 
-    void play()
+    // runtime analysis settings, used by the next start().
+    // updatesPerSecond sets the STFT hop, 60 to 240 follows the video frame rate
+    void setAnalysisRate(double updatesPerSecond)
+    {
+        analysisRate = updatesPerSecond;
+    }
+
+    // frameSize must be a power of 2
+    void setAnalysisWindow(size_t frameSize, WindowFunction window)
+    {
+        analysisFrameSize = frameSize;
+        analysisWindow = window;
+    }
+
+    // band layout of AudioAnalysis::frequencyBands (log spaced 20 Hz - 20 kHz, 10 bands
+    // by default). Takes effect right away, also while playing; a sidecar made with
+    // another layout is then left aside for the live STFT
+    void setFrequencyBands(const FilterbankConfig &config)
+    {
+        std::lock_guard<std::mutex> lock(bandMutex);
+        bandConfig = config;
+        bandsChanged = true;
+    }
+
+    FilterbankConfig getFrequencyBands()
+    {
+        std::lock_guard<std::mutex> lock(bandMutex);
+        return bandConfig;
+    }
+
+    // read the analysis from a sidecar file computed ahead of time (built on all cores
+    // if missing) instead of running the STFT while playing. Call before loadMusic,
+    // after the analysis settings
+    void setPrecomputedAnalysis(bool enabled)
+    {
+        usePrecomputedAnalysis = enabled;
+    }
+
+    // open when precomputed analysis is in use: the render thread can look up
+    // any position directly, e.g. getAnalysisCache().at(state.seconds)
+    const AnalysisCache &getAnalysisCache() const
+    {
+        return analysisCache;
+    }
+
+    // starts playback and the audio thread and returns right away,
+    // so it can be called from a render loop
+    bool start()
     {
         if (!isInitialized)
         {
             std::cerr << "Error: Player not initialized" << std::endl;
-            return;
+            return false;
         }
+        if (audioThread.joinable())
+        {
+            return true;
+        }
+
+        stft.configure(analysisFrameSize, StftAnalyzer::hopForRate(sampleRate, analysisRate), analysisWindow);
+        stftFedFrame = 0;
+        stftSkipped = 0;
+        beats.configure((double)sampleRate / stft.getHopSize());
+        onsetPrevious.assign(analysisFrameSize / 2 + 1, 0.0f);
+        lastCachedFrame = nullptr;
+        bandsChanged = false;
+        applyFrequencyBands();
+        analysisReady = false;
+        stftAnalysis = AudioAnalysis();
 
         alSourcePlay(source);
         startTime = std::chrono::steady_clock::now();
+        playbackActive = true;
+        audioRunning = true;
+        audioThread = std::thread(&MusicPlayer::audioLoop, this);
+        return true;
+    }
+
+    // stops playback and waits for the audio thread
+    void stop()
+    {
+        audioRunning = false;
+        if (audioThread.joinable())
+            audioThread.join();
+        if (source)
+            alSourceStop(source);
+        playbackActive = false;
+    }
+
+    // render thread side: copies the newest state the audio thread published.
+    // Never blocks, true if state changed since the last call
+    bool poll(PlaybackState &state)
+    {
+        if (!published.update())
+            return false;
+        state = published.front();
+        return true;
+    }
+
+    // plays the whole track, printing the runtime information on the console
+    void play()
+    {
+        if (!start())
+        {
+            return;
+        }
 
         std::cout << "Playing music... Press Ctrl+C to stop\n"
                   << std::endl;
 
         // Runtime information loop
-        while (true)
+        PlaybackState state = PlaybackState();
+        while (isPlaying())
         {
-            ALint state;
-            alGetSourcei(source, AL_SOURCE_STATE, &state);
-
-            if (state != AL_PLAYING)
+            if (poll(state))
             {
-                std::cout << "\nPlayback finished!" << std::endl;
-                break;
+                printRuntimeInfo(state);
             }
-
-            printRuntimeInfo();
             std::this_thread::sleep_for(std::chrono::milliseconds(500));
         }
+        std::cout << "\nPlayback finished!" << std::endl;
     }
 
-    void
-
-    void printRuntimeInfo()
+    void printRuntimeInfo(const PlaybackState &state)
     {
         auto currentTime = std::chrono::steady_clock::now();
         auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -554,19 +1012,11 @@ public:
                        1000.0;
 
         double progress = (elapsed / duration) * 100.0;
+        double offsetSeconds = state.seconds;
 
-        // Get current playback position
-        ALfloat offsetSeconds;
-        alGetSourcef(source, AL_SEC_OFFSET, &offsetSeconds);
-
-        // Update current play position for analysis
-        currentPlayPosition = (size_t)(offsetSeconds * sampleRate * channels);
-
-        // Analyze current audio segment (1 second window)
-        size_t windowSize = sampleRate * channels; // 1 second
-        if (currentPlayPosition + windowSize < audioData.size())
+        if (state.hasAnalysis)
         {
-            AudioAnalysis realTimeAnalysis = analyzeAudioSegment(currentPlayPosition, windowSize);
+            const AudioAnalysis &realTimeAnalysis = state.analysis;
 
             // Clear screen and show runtime info with audio analysis
             std::cout << "\r\033[K"; // Clear current line
@@ -588,13 +1038,12 @@ public:
                       << "[Format: " << formatName << "] "
                       << std::flush;
         }
-
-
-        
     }
 
     void cleanup()
     {
+        stop();
+
         if (source)
         {
             alSourceStop(source);
@@ -608,6 +1057,15 @@ public:
             buffer = 0;
         }
 
+        if (streamBuffers[0])
+        {
+            alDeleteBuffers(STREAM_BUFFER_COUNT, streamBuffers);
+            memset(streamBuffers, 0, sizeof(streamBuffers));
+        }
+        streamDecoder.reset();
+        streamHistory.clear();
+        analysisCache.close();
+
         if (audioFile)
         {
             sf_close(audioFile);
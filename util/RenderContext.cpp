@@ -0,0 +1,414 @@
+#include "RenderContext.h"
+#include "RenderState.h"
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <dlfcn.h>
+
+// the EGL types and enums only, every function comes from dlsym
+#define EGL_EGL_PROTOTYPES 0
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// what is needed of osmesa.h, so it does not have to be installed
+#define OSMESA_FORMAT 0x22
+#define OSMESA_DEPTH_BITS 0x30
+#define OSMESA_STENCIL_BITS 0x31
+#define OSMESA_PROFILE 0x33
+#define OSMESA_CORE_PROFILE 0x34
+#define OSMESA_CONTEXT_MAJOR_VERSION 0x36
+#define OSMESA_CONTEXT_MINOR_VERSION 0x37
+typedef void *(*PFNOSMESACREATECONTEXTATTRIBSPROC)(const int *attributes, void *sharelist);
+typedef unsigned char (*PFNOSMESAMAKECURRENTPROC)(void *context, void *buffer, GLenum type, GLsizei width, GLsizei height);
+typedef void (*PFNOSMESADESTROYCONTEXTPROC)(void *context);
+typedef void *(*PFNOSMESAGETPROCADDRESSPROC)(const char *name);
+
+namespace
+{
+    // glad asks for the GL functions through a plain function pointer
+    PFNEGLGETPROCADDRESSPROC eglProc = nullptr;
+    PFNOSMESAGETPROCADDRESSPROC osmesaProc = nullptr;
+    // what the current context loaded glad with, for getProcAddress
+    GLADloadproc currentLoader = nullptr;
+
+    void *eglLoader(const char *name)
+    {
+        return reinterpret_cast<void *>(eglProc(name));
+    }
+
+    void *osmesaLoader(const char *name)
+    {
+        return osmesaProc(name);
+    }
+
+    void *openLibrary(const char *const names[])
+    {
+        for (int i = 0; names[i]; i++)
+        {
+            if (void *library = dlopen(names[i], RTLD_NOW | RTLD_LOCAL))
+                return library;
+        }
+        return nullptr;
+    }
+
+    template <typename Function>
+    Function symbol(void *library, const char *name)
+    {
+        return reinterpret_cast<Function>(dlsym(library, name));
+    }
+
+    bool hasEglExtension(const char *extensions, const char *name)
+    {
+        if (!extensions)
+            return false;
+        size_t length = std::strlen(name);
+        for (const char *found = std::strstr(extensions, name); found; found = std::strstr(found + length, name))
+        {
+            if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+                return true;
+        }
+        return false;
+    }
+}
+
+RenderContext::RenderContext() : backend(ContextBackend::Window), width(0), height(0), window(nullptr), library(nullptr),
+                                 eglDisplay(nullptr), eglContext(nullptr), eglSurface(nullptr), osmesaContext(nullptr)
+{
+}
+
+RenderContext::~RenderContext()
+{
+    destroy();
+}
+
+ContextBackend RenderContext::backendFromArguments(int argc, char *argv[])
+{
+    std::string requested;
+    if (const char *environment = std::getenv("GL_HEADLESS"))
+        requested = environment[0] ? environment : "egl";
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--headless") != 0)
+            continue;
+        requested = "egl";
+        if (i + 1 < argc && (std::strcmp(argv[i + 1], "egl") == 0 || std::strcmp(argv[i + 1], "osmesa") == 0))
+            requested = argv[i + 1];
+    }
+    if (requested == "osmesa")
+        return ContextBackend::OSMesa;
+    if (requested.empty() || requested == "0" || requested == "window")
+        return ContextBackend::Window;
+    return ContextBackend::Egl;
+}
+
+const char *RenderContext::backendName(ContextBackend backend)
+{
+    switch (backend)
+    {
+    case ContextBackend::Egl:
+        return "EGL";
+    case ContextBackend::OSMesa:
+        return "OSMesa";
+    default:
+        return "window";
+    }
+}
+
+bool RenderContext::create(ContextBackend newBackend, unsigned int newWidth, unsigned int newHeight, const char *title)
+{
+    destroy();
+    backend = newBackend;
+    width = newWidth;
+    height = newHeight;
+    created = std::chrono::steady_clock::now();
+
+    bool ready = false;
+    switch (backend)
+    {
+    case ContextBackend::Egl:
+        ready = createEgl();
+        break;
+    case ContextBackend::OSMesa:
+        ready = createOSMesa();
+        break;
+    default:
+        ready = createWindow(title);
+        break;
+    }
+    if (!ready || !loadGL())
+    {
+        destroy();
+        return false;
+    }
+    // a new context starts from the GL defaults, not from what the last one had bound
+    RenderState::shared().invalidate();
+    std::cout << "OpenGL " << glGetString(GL_VERSION) << " on " << glGetString(GL_RENDERER)
+              << " (" << backendName(backend) << ")" << std::endl;
+    return true;
+}
+
+bool RenderContext::createWindow(const char *title)
+{
+    if (!glfwInit())
+    {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return false;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    window = glfwCreateWindow(width, height, title, NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    return true;
+}
+
+bool RenderContext::createEgl()
+{
+    const char *const names[] = {"libEGL.so.1", "libEGL.so", nullptr};
+    library = openLibrary(names);
+    if (!library)
+    {
+        std::cout << "ERROR::RENDER_CONTEXT:: libEGL not found" << std::endl;
+        return false;
+    }
+    eglProc = symbol<PFNEGLGETPROCADDRESSPROC>(library, "eglGetProcAddress");
+    auto getDisplay = symbol<PFNEGLGETDISPLAYPROC>(library, "eglGetDisplay");
+    auto initialize = symbol<PFNEGLINITIALIZEPROC>(library, "eglInitialize");
+    auto queryString = symbol<PFNEGLQUERYSTRINGPROC>(library, "eglQueryString");
+    auto bindApi = symbol<PFNEGLBINDAPIPROC>(library, "eglBindAPI");
+    auto chooseConfig = symbol<PFNEGLCHOOSECONFIGPROC>(library, "eglChooseConfig");
+    auto createPbuffer = symbol<PFNEGLCREATEPBUFFERSURFACEPROC>(library, "eglCreatePbufferSurface");
+    auto createContext = symbol<PFNEGLCREATECONTEXTPROC>(library, "eglCreateContext");
+    auto makeCurrent = symbol<PFNEGLMAKECURRENTPROC>(library, "eglMakeCurrent");
+    if (!eglProc || !getDisplay || !initialize || !queryString || !bindApi || !chooseConfig || !createPbuffer ||
+        !createContext || !makeCurrent)
+    {
+        std::cout << "ERROR::RENDER_CONTEXT:: libEGL is missing EGL 1.4 functions" << std::endl;
+        return false;
+    }
+
+    // Mesa renders without any window system on its surfaceless platform, NVIDIA on a device
+    EGLDisplay display = EGL_NO_DISPLAY;
+    const char *clientExtensions = queryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglProc("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay && hasEglExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY && getPlatformDisplay && hasEglExtension(clientExtensions, "EGL_EXT_platform_device"))
+    {
+        auto queryDevices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(eglProc("eglQueryDevicesEXT"));
+        EGLDeviceEXT device;
+        EGLint deviceCount = 0;
+        if (queryDevices && queryDevices(1, &device, &deviceCount) && deviceCount > 0)
+            display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY)
+        display = getDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major = 0, minor = 0;
+    if (display == EGL_NO_DISPLAY || !initialize(display, &major, &minor))
+    {
+        std::cout << "ERROR::RENDER_CONTEXT:: no EGL display" << std::endl;
+        return false;
+    }
+    eglDisplay = display;
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8,
+        EGL_NONE};
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!bindApi(EGL_OPENGL_API) || !chooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+    {
+        std::cout << "ERROR::RENDER_CONTEXT:: no EGL config for desktop OpenGL with a pbuffer" << std::endl;
+        return false;
+    }
+
+    const EGLint surfaceAttributes[] = {EGL_WIDTH, (EGLint)width, EGL_HEIGHT, (EGLint)height, EGL_NONE};
+    eglSurface = createPbuffer(display, config, surfaceAttributes);
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    eglContext = createContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (eglSurface == EGL_NO_SURFACE || eglContext == EGL_NO_CONTEXT ||
+        !makeCurrent(display, eglSurface, eglSurface, eglContext))
+    {
+        std::cout << "ERROR::RENDER_CONTEXT:: could not create an OpenGL 3.3 core context on EGL" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool RenderContext::createOSMesa()
+{
+    const char *const names[] = {"libOSMesa.so.8", "libOSMesa.so.6", "libOSMesa.so", nullptr};
+    library = openLibrary(names);
+    if (!library)
+    {
+        std::cout << "ERROR::RENDER_CONTEXT:: libOSMesa not found" << std::endl;
+        return false;
+    }
+    auto createContext = symbol<PFNOSMESACREATECONTEXTATTRIBSPROC>(library, "OSMesaCreateContextAttribs");
+    auto makeCurrent = symbol<PFNOSMESAMAKECURRENTPROC>(library, "OSMesaMakeCurrent");
+    osmesaProc = symbol<PFNOSMESAGETPROCADDRESSPROC>(library, "OSMesaGetProcAddress");
+    if (!createContext || !makeCurrent || !osmesaProc)
+    {
+        std::cout << "ERROR::RENDER_CONTEXT:: libOSMesa is too old for core profile contexts" << std::endl;
+        return false;
+    }
+
+    const int attributes[] = {
+        OSMESA_FORMAT, GL_RGBA,
+        OSMESA_DEPTH_BITS, 24,
+        OSMESA_STENCIL_BITS, 8,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, 3,
+        OSMESA_CONTEXT_MINOR_VERSION, 3,
+        0};
+    osmesaContext = createContext(attributes, nullptr);
+    // the default framebuffer is this block of memory
+    osmesaBuffer.assign((size_t)width * height * 4, 0);
+    if (!osmesaContext || !makeCurrent(osmesaContext, osmesaBuffer.data(), GL_UNSIGNED_BYTE, width, height))
+    {
+        std::cout << "ERROR::RENDER_CONTEXT:: could not create an OpenGL 3.3 core context on OSMesa" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool RenderContext::loadGL()
+{
+    GLADloadproc loader = backend == ContextBackend::Egl      ? (GLADloadproc)eglLoader
+                          : backend == ContextBackend::OSMesa ? (GLADloadproc)osmesaLoader
+                                                              : (GLADloadproc)glfwGetProcAddress;
+    if (!gladLoadGLLoader(loader))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+    currentLoader = loader;
+    return true;
+}
+
+void *RenderContext::getProcAddress(const char *name)
+{
+    // samples that open their window with GLFW themselves never went through loadGL
+    if (!currentLoader)
+        return (void *)glfwGetProcAddress(name);
+    return currentLoader(name);
+}
+
+bool RenderContext::isVersionAtLeast(int major, int minor)
+{
+    GLint contextMajor = 0, contextMinor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+    glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+    return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+bool RenderContext::hasExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void RenderContext::destroy()
+{
+    if (window)
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        window = nullptr;
+    }
+    if (library && eglDisplay)
+    {
+        auto makeCurrent = symbol<PFNEGLMAKECURRENTPROC>(library, "eglMakeCurrent");
+        auto destroyContext = symbol<PFNEGLDESTROYCONTEXTPROC>(library, "eglDestroyContext");
+        auto destroySurface = symbol<PFNEGLDESTROYSURFACEPROC>(library, "eglDestroySurface");
+        auto terminate = symbol<PFNEGLTERMINATEPROC>(library, "eglTerminate");
+        makeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (eglContext)
+            destroyContext(eglDisplay, eglContext);
+        if (eglSurface)
+            destroySurface(eglDisplay, eglSurface);
+        terminate(eglDisplay);
+    }
+    if (library && osmesaContext)
+        symbol<PFNOSMESADESTROYCONTEXTPROC>(library, "OSMesaDestroyContext")(osmesaContext);
+    // the driver stays loaded: unloading it under a live GL dispatch table is asking for trouble
+    library = nullptr;
+    eglDisplay = eglContext = eglSurface = osmesaContext = nullptr;
+    currentLoader = nullptr;
+    osmesaBuffer.clear();
+}
+
+ContextBackend RenderContext::getBackend() const
+{
+    return backend;
+}
+
+bool RenderContext::isHeadless() const
+{
+    return backend != ContextBackend::Window;
+}
+
+GLFWwindow *RenderContext::getWindow() const
+{
+    return window;
+}
+
+unsigned int RenderContext::getWidth() const
+{
+    return width;
+}
+
+unsigned int RenderContext::getHeight() const
+{
+    return height;
+}
+
+bool RenderContext::shouldClose() const
+{
+    return window && glfwWindowShouldClose(window);
+}
+
+void RenderContext::endFrame()
+{
+    if (!window)
+        return;
+    glfwSwapBuffers(window);
+    glfwPollEvents();
+}
+
+void RenderContext::setSwapInterval(int interval)
+{
+    if (window)
+        glfwSwapInterval(interval);
+}
+
+double RenderContext::getTime() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - created).count();
+}
@@ -0,0 +1,82 @@
+#ifndef RENDERCONTEXT_H
+#define RENDERCONTEXT_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <vector>
+
+// where the GL context lives
+enum class ContextBackend
+{
+    Window, // a GLFW window, what every sample used so far
+    Egl,    // EGL pbuffer on the surfaceless (Mesa) or device (NVIDIA) platform, no display needed
+    OSMesa  // Mesa's software rasterizer rendering straight into memory
+};
+
+// Creates the OpenGL 3.3 core context a program renders with and loads glad for it.
+// The headless backends let the render paths run on build boxes without a display
+// or GPU (Mesa llvmpipe): libEGL / libOSMesa are opened at runtime, so nothing new
+// is needed at link time and a missing library only fails create().
+// Headless contexts still have a default framebuffer of width x height (a pbuffer or
+// a block of memory), so code that binds framebuffer 0 runs unchanged.
+class RenderContext
+{
+public:
+    RenderContext();
+    ~RenderContext();
+
+    // --headless [egl|osmesa] on the command line or GL_HEADLESS=egl|osmesa in the
+    // environment pick a headless backend (egl when no name is given), else Window
+    static ContextBackend backendFromArguments(int argc, char *argv[]);
+    static const char *backendName(ContextBackend backend);
+    // a GL function glad does not load (it is generated for 3.3 core), e.g. a 4.x
+    // entry point used after checking the version. nullptr when the driver has none
+    static void *getProcAddress(const char *name);
+    // about the current context: at least GL major.minor, and whether it has an extension
+    static bool isVersionAtLeast(int major, int minor);
+    static bool hasExtension(const char *name);
+
+    // makes the context current on this thread and loads the GL functions
+    bool create(ContextBackend backend, unsigned int width, unsigned int height, const char *title = "LearnOpenGL");
+    void destroy();
+
+    ContextBackend getBackend() const;
+    bool isHeadless() const;
+    // nullptr when headless
+    GLFWwindow *getWindow() const;
+    unsigned int getWidth() const;
+    unsigned int getHeight() const;
+
+    // true once the window was closed, never for a headless context
+    bool shouldClose() const;
+    // presents the frame: swaps and polls a window, nothing to do headless
+    void endFrame();
+    // 0 renders as fast as possible instead of waiting for vsync
+    void setSwapInterval(int interval);
+    // seconds since create(), without needing GLFW
+    double getTime() const;
+
+private:
+    ContextBackend backend;
+    unsigned int width;
+    unsigned int height;
+    std::chrono::steady_clock::time_point created;
+
+    GLFWwindow *window;
+
+    // libEGL or libOSMesa
+    void *library;
+    void *eglDisplay;
+    void *eglContext;
+    void *eglSurface;
+    void *osmesaContext;
+    std::vector<unsigned char> osmesaBuffer;
+
+    bool createWindow(const char *title);
+    bool createEgl();
+    bool createOSMesa();
+    bool loadGL();
+};
+
+#endif
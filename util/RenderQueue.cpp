@@ -0,0 +1,262 @@
+#include "RenderQueue.h"
+#include "RenderState.h"
+#include "UniformBlocks.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const unsigned int PASS_BITS = 4;
+    const unsigned int PROGRAM_BITS = 10;
+    const unsigned int MATERIAL_BITS = 14;
+    const unsigned int VERTEX_ARRAY_BITS = 14;
+    const unsigned int DEPTH_BITS = 22;
+
+    // keeps the low bits of an id, with the high ones xored in so large ids still spread
+    uint64_t fold(uint64_t id, unsigned int bits)
+    {
+        uint64_t mask = ((uint64_t)1 << bits) - 1;
+        uint64_t folded = 0;
+        for (; id != 0; id >>= bits)
+            folded ^= id & mask;
+        return folded;
+    }
+
+    // the top bits of a positive float keep its order: exponent first, then mantissa
+    uint64_t depthBits(float depth)
+    {
+        if (!(depth > 0.0f))
+            return 0;
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> (32 - DEPTH_BITS);
+    }
+}
+
+void RenderQueue::Bucket::submit(Mesh &mesh, Shader &shader, const Material *material, const glm::mat4 &model,
+                                 unsigned int lod, unsigned int pass, float depth)
+{
+    pass = std::min(pass, MAX_PASSES - 1);
+    // the material uniforms and the textures of the mesh together make the material
+    uint64_t materialId = (uint64_t)(uintptr_t)material * 0x9E3779B97F4A7C15ull ^ mesh.getMaterialKey();
+
+    DrawCommand command;
+    command.key = makeKey(pass, passOrders[pass], shader.ID, (unsigned int)fold(materialId, 32), mesh.getVAO(), depth);
+    command.mesh = &mesh;
+    command.shader = &shader;
+    command.material = material;
+    command.transform = (uint32_t)transforms.size();
+    command.lod = lod;
+    commands.push_back(command);
+    transforms.push_back(model);
+}
+
+size_t RenderQueue::Bucket::size() const
+{
+    return commands.size();
+}
+
+RenderQueue::RenderQueue(size_t bucketCount) : buckets(std::max((size_t)1, bucketCount)), uniformRing(nullptr)
+{
+    for (unsigned int pass = 0; pass < MAX_PASSES; pass++)
+        passOrders[pass] = PassOrder::State;
+    for (Bucket &bucket : buckets)
+        bucket.passOrders = passOrders;
+}
+
+size_t RenderQueue::getBucketCount() const
+{
+    return buckets.size();
+}
+
+RenderQueue::Bucket &RenderQueue::getBucket(size_t index)
+{
+    return buckets[index];
+}
+
+void RenderQueue::setPassOrder(unsigned int pass, PassOrder order)
+{
+    if (pass < MAX_PASSES)
+        passOrders[pass] = order;
+}
+
+void RenderQueue::setPassSetup(unsigned int pass, std::function<void()> setup)
+{
+    if (pass < MAX_PASSES)
+        passSetups[pass] = std::move(setup);
+}
+
+void RenderQueue::setUniformRing(UniformRing *ring)
+{
+    uniformRing = ring;
+}
+
+uint64_t RenderQueue::makeKey(unsigned int pass, PassOrder order, unsigned int program, unsigned int material,
+                              unsigned int vertexArray, float depth)
+{
+    uint64_t key = (uint64_t)(pass & (MAX_PASSES - 1)) << (64 - PASS_BITS);
+    uint64_t state = fold(program, PROGRAM_BITS) << (MATERIAL_BITS + VERTEX_ARRAY_BITS) |
+                     fold(material, MATERIAL_BITS) << VERTEX_ARRAY_BITS |
+                     fold(vertexArray, VERTEX_ARRAY_BITS);
+    uint64_t distance = depthBits(depth);
+    if (order == PassOrder::BackToFront)
+    {
+        // farthest first: the inverted depth sorts ascending
+        uint64_t inverted = ((uint64_t)1 << DEPTH_BITS) - 1 - distance;
+        return key | inverted << (PROGRAM_BITS + MATERIAL_BITS + VERTEX_ARRAY_BITS) | state;
+    }
+    return key | state << DEPTH_BITS | distance;
+}
+
+void RenderQueue::clear()
+{
+    for (Bucket &bucket : buckets)
+    {
+        bucket.commands.clear();
+        bucket.transforms.clear();
+    }
+    commands.clear();
+    transforms.clear();
+    order.clear();
+}
+
+void RenderQueue::sort()
+{
+    commands.clear();
+    transforms.clear();
+    for (const Bucket &bucket : buckets)
+    {
+        // the transform indices of a bucket are local to it
+        uint32_t base = (uint32_t)transforms.size();
+        for (DrawCommand command : bucket.commands)
+        {
+            command.transform += base;
+            commands.push_back(command);
+        }
+        transforms.insert(transforms.end(), bucket.transforms.begin(), bucket.transforms.end());
+    }
+
+    order.resize(commands.size());
+    for (size_t i = 0; i < commands.size(); i++)
+        order[i] = SortItem{commands[i].key, (uint32_t)i};
+    radixSort(order, scratch);
+}
+
+// LSD radix sort, 8 bits per pass. All 8 histograms are built in one read of the
+// keys, and digits every key shares (the pass bits of a one pass frame, the high
+// bits of small ids) are skipped. Stable, so equal keys keep their submission order
+void RenderQueue::radixSort(std::vector<SortItem> &items, std::vector<SortItem> &scratch)
+{
+    size_t count = items.size();
+    if (count < 2)
+        return;
+
+    size_t histograms[8][256] = {};
+    for (const SortItem &item : items)
+    {
+        for (int digit = 0; digit < 8; digit++)
+            histograms[digit][(item.key >> (digit * 8)) & 0xFF]++;
+    }
+
+    scratch.resize(count);
+    for (int digit = 0; digit < 8; digit++)
+    {
+        size_t *histogram = histograms[digit];
+        if (histogram[(items[0].key >> (digit * 8)) & 0xFF] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int value = 0; value < 256; value++)
+        {
+            size_t bucketSize = histogram[value];
+            histogram[value] = offset;
+            offset += bucketSize;
+        }
+        for (const SortItem &item : items)
+            scratch[histogram[(item.key >> (digit * 8)) & 0xFF]++] = item;
+        items.swap(scratch);
+    }
+}
+
+void RenderQueue::execute()
+{
+    RenderState &state = RenderState::shared();
+    unsigned int pass = MAX_PASSES;
+    Shader *shader = nullptr;
+    const Material *material = nullptr;
+    MaterialLocations locations = {-1, -1, -1, -1, -1};
+    materialOffsets.clear();
+
+    for (const SortItem &item : order)
+    {
+        const DrawCommand &command = commands[item.command];
+
+        unsigned int commandPass = (unsigned int)(item.key >> (64 - PASS_BITS));
+        if (commandPass != pass)
+        {
+            pass = commandPass;
+            if (passSetups[pass])
+                passSetups[pass]();
+        }
+
+        if (command.shader != shader)
+        {
+            shader = command.shader;
+            state.useProgram(shader->ID);
+            locations.model = shader->getUniformLocation("model");
+            locations.ambient = shader->getUniformLocation("material.ambient");
+            locations.diffuse = shader->getUniformLocation("material.diffuse");
+            locations.specular = shader->getUniformLocation("material.specular");
+            locations.shininess = shader->getUniformLocation("material.shininess");
+            // uniforms belong to the program, the new one may hold another material.
+            // the block binding doesn't, it stays
+            if (!uniformRing)
+                material = nullptr;
+        }
+
+        if (command.material != nullptr && command.material != material)
+        {
+            material = command.material;
+            if (uniformRing)
+            {
+                // the sort keeps a material's draws together, so few materials come back
+                // and a linear search is enough
+                GLintptr offset = -1;
+                for (const std::pair<const Material *, GLintptr> &written : materialOffsets)
+                {
+                    if (written.first == material)
+                        offset = written.second;
+                }
+                if (offset < 0)
+                {
+                    // -1 when the frame's region is full, the ring reports that
+                    offset = uniformRing->write(MaterialBlock(*material));
+                    materialOffsets.push_back(std::make_pair(material, offset));
+                }
+                if (offset >= 0)
+                    uniformRing->bindRange(MATERIAL_BLOCK_BINDING, offset, sizeof(MaterialBlock));
+            }
+            else
+            {
+                shader->setVec3(locations.ambient, material->ambient);
+                shader->setVec3(locations.diffuse, material->diffuse);
+                shader->setVec3(locations.specular, material->specular);
+                shader->setFloat(locations.shininess, material->shininess);
+            }
+        }
+
+        shader->setMat4(locations.model, transforms[command.transform]);
+        command.mesh->DrawLod(*shader, command.lod);
+    }
+}
+
+size_t RenderQueue::size() const
+{
+    return order.size();
+}
+
+const DrawCommand &RenderQueue::getCommand(size_t index) const
+{
+    return commands[order[index].command];
+}
@@ -0,0 +1,131 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <utility>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "Material.h"
+#include "UniformRing.h"
+
+// how the draws inside one pass are ordered
+enum class PassOrder
+{
+    // by program, material and vertex array, then front to back: fewest state changes
+    // and early depth rejection, for opaque geometry
+    State,
+    // back to front first, state only breaks ties: for blended geometry
+    BackToFront
+};
+
+// one queued draw, executed later on the GL thread
+struct DrawCommand
+{
+    uint64_t key;
+    Mesh *mesh;
+    Shader *shader;
+    const Material *material; // nullptr leaves the material alone
+    uint32_t transform;       // index of the model matrix in the transforms of the queue
+    uint32_t lod;
+};
+
+// A frame's draws as commands with a 64 bit sort key instead of GL calls in call order.
+// From the most significant bit the key holds the pass (4 bits), the program (10),
+// the material (14), the vertex array (14) and the view depth (22); BackToFront
+// passes move the inverted depth right after the pass. Ids wider than their field
+// are folded, which can only cost a state change, never a wrong draw: execute()
+// compares the real shader, material and mesh.
+// Submission needs no lock: every submitting thread fills its own Bucket (bucket i
+// for thread/task i), sort() gathers and radix sorts them once they are all done,
+// execute() runs on the GL thread and binds through RenderState.
+class RenderQueue
+{
+public:
+    static const unsigned int MAX_PASSES = 16;
+
+    class Bucket
+    {
+    public:
+        // depth is the distance from the camera, only its order matters
+        void submit(Mesh &mesh, Shader &shader, const Material *material, const glm::mat4 &model,
+                    unsigned int lod, unsigned int pass = 0, float depth = 0.0f);
+        size_t size() const;
+
+    private:
+        friend class RenderQueue;
+        const PassOrder *passOrders;
+        std::vector<DrawCommand> commands;
+        std::vector<glm::mat4> transforms;
+    };
+
+    // buckets is how many threads may submit at the same time
+    explicit RenderQueue(size_t buckets = 1);
+
+    RenderQueue(const RenderQueue &) = delete;
+    RenderQueue &operator=(const RenderQueue &) = delete;
+
+    size_t getBucketCount() const;
+    Bucket &getBucket(size_t index);
+
+    // set before submitting, every pass starts as PassOrder::State
+    void setPassOrder(unsigned int pass, PassOrder order);
+    // runs when execute() reaches the first draw of pass, e.g. binds its framebuffer
+    void setPassSetup(unsigned int pass, std::function<void()> setup);
+    // materials go out as a MaterialBlock written into the ring instead of the
+    // material.* uniforms, for shaders declaring the block. nullptr goes back to uniforms.
+    // every execute() writes each material once, a switch back only rebinds its range
+    void setUniformRing(UniformRing *ring);
+
+    // drops the commands of the last frame, keeps the memory
+    void clear();
+    // gathers the buckets and sorts by key, call once all submitting threads are done
+    void sort();
+    // issues the sorted draws, on the thread owning the GL context
+    void execute();
+
+    size_t size() const;
+    // the i-th command in sorted order, valid until the next clear()
+    const DrawCommand &getCommand(size_t index) const;
+
+    static uint64_t makeKey(unsigned int pass, PassOrder order, unsigned int program, unsigned int material,
+                            unsigned int vertexArray, float depth);
+
+private:
+    std::vector<Bucket> buckets;
+    PassOrder passOrders[MAX_PASSES];
+    std::function<void()> passSetups[MAX_PASSES];
+    UniformRing *uniformRing;
+
+    // what gets sorted: 16 bytes per draw instead of the whole command
+    struct SortItem
+    {
+        uint64_t key;
+        uint32_t command;
+    };
+
+    std::vector<DrawCommand> commands; // gathered from the buckets, unsorted
+    std::vector<glm::mat4> transforms;
+    std::vector<SortItem> order;
+    std::vector<SortItem> scratch;
+    // where execute() wrote the blocks of the materials it met so far
+    std::vector<std::pair<const Material *, GLintptr>> materialOffsets;
+
+    // material uniforms of the current shader, looked up once per shader switch
+    struct MaterialLocations
+    {
+        GLint model;
+        GLint ambient;
+        GLint diffuse;
+        GLint specular;
+        GLint shininess;
+    };
+
+    static void radixSort(std::vector<SortItem> &items, std::vector<SortItem> &scratch);
+};
+
+#endif
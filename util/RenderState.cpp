@@ -0,0 +1,303 @@
+#include "RenderState.h"
+
+#include <iomanip>
+
+namespace
+{
+    // the enable flags worth shadowing, anything else goes straight to GL
+    const GLenum TRACKED_CAPABILITIES[] = {
+        GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_STENCIL_TEST, GL_SCISSOR_TEST,
+        GL_POLYGON_OFFSET_FILL, GL_MULTISAMPLE, GL_FRAMEBUFFER_SRGB, GL_PROGRAM_POINT_SIZE,
+        GL_TEXTURE_CUBE_MAP_SEAMLESS, GL_PRIMITIVE_RESTART};
+    const size_t CAPABILITY_COUNT = sizeof(TRACKED_CAPABILITIES) / sizeof(TRACKED_CAPABILITIES[0]);
+
+    const char *const CALL_NAMES[] = {"program", "vertex array", "active texture", "texture", "framebuffer", "enable"};
+}
+
+// std::array::fill takes it by reference, so it needs a definition
+const GLuint RenderState::UNKNOWN;
+
+size_t RenderStateStatistics::totalIssued() const
+{
+    size_t sum = 0;
+    for (size_t value : issued)
+        sum += value;
+    return sum;
+}
+
+size_t RenderStateStatistics::totalElided() const
+{
+    size_t sum = 0;
+    for (size_t value : elided)
+        sum += value;
+    return sum;
+}
+
+RenderState &RenderState::shared()
+{
+    static RenderState state;
+    return state;
+}
+
+RenderState::RenderState() : frames(0)
+{
+    invalidate();
+}
+
+void RenderState::invalidate()
+{
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    activeUnit = UNKNOWN;
+    units.clear();
+    drawFramebuffer = UNKNOWN;
+    readFramebuffer = UNKNOWN;
+    capabilities.assign(CAPABILITY_COUNT, -1);
+}
+
+void RenderState::count(StateCall call, bool issued)
+{
+    if (issued)
+        frame.issued[(size_t)call]++;
+    else
+        frame.elided[(size_t)call]++;
+}
+
+void RenderState::useProgram(GLuint newProgram)
+{
+    bool changed = newProgram != program;
+    if (changed)
+    {
+        glUseProgram(newProgram);
+        program = newProgram;
+    }
+    count(StateCall::Program, changed);
+}
+
+void RenderState::bindVertexArray(GLuint newVertexArray)
+{
+    bool changed = newVertexArray != vertexArray;
+    if (changed)
+    {
+        glBindVertexArray(newVertexArray);
+        vertexArray = newVertexArray;
+    }
+    count(StateCall::VertexArray, changed);
+}
+
+void RenderState::activeTexture(GLuint unit)
+{
+    bool changed = unit != activeUnit;
+    if (changed)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+    count(StateCall::ActiveTexture, changed);
+}
+
+void RenderState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int index = targetIndex(target);
+    if (index < 0)
+    {
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        count(StateCall::Texture, true);
+        return;
+    }
+
+    if (unit >= units.size())
+    {
+        std::array<GLuint, TEXTURE_TARGETS> unknown;
+        unknown.fill(UNKNOWN);
+        units.resize(unit + 1, unknown);
+    }
+    GLuint &bound = units[unit][index];
+    bool changed = texture != bound;
+    if (changed)
+    {
+        // only switch units when there is something to bind on the new one
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        bound = texture;
+    }
+    count(StateCall::Texture, changed);
+}
+
+void RenderState::bindTexture(GLenum target, GLuint texture)
+{
+    // nobody said which unit is active yet: pick 0 so the shadow knows
+    bindTexture(activeUnit == UNKNOWN ? 0 : activeUnit, target, texture);
+}
+
+void RenderState::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    bool changed;
+    if (target == GL_DRAW_FRAMEBUFFER)
+    {
+        changed = framebuffer != drawFramebuffer;
+        drawFramebuffer = framebuffer;
+    }
+    else if (target == GL_READ_FRAMEBUFFER)
+    {
+        changed = framebuffer != readFramebuffer;
+        readFramebuffer = framebuffer;
+    }
+    else
+    {
+        changed = framebuffer != drawFramebuffer || framebuffer != readFramebuffer;
+        drawFramebuffer = readFramebuffer = framebuffer;
+    }
+    if (changed)
+        glBindFramebuffer(target, framebuffer);
+    count(StateCall::Framebuffer, changed);
+}
+
+void RenderState::setEnabled(GLenum capability, bool enabled)
+{
+    int index = capabilityIndex(capability);
+    bool changed = index < 0 || capabilities[index] != (enabled ? 1 : 0);
+    if (changed)
+    {
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+        if (index >= 0)
+            capabilities[index] = enabled ? 1 : 0;
+    }
+    count(StateCall::Capability, changed);
+}
+
+void RenderState::enable(GLenum capability)
+{
+    setEnabled(capability, true);
+}
+
+void RenderState::disable(GLenum capability)
+{
+    setEnabled(capability, false);
+}
+
+void RenderState::forgetProgram(GLuint deleted)
+{
+    // a deleted program stays in use until another one is, but its name can be reused
+    if (program == deleted)
+        program = UNKNOWN;
+}
+
+void RenderState::forgetVertexArray(GLuint deleted)
+{
+    if (vertexArray == deleted)
+        vertexArray = UNKNOWN;
+}
+
+void RenderState::forgetTexture(GLuint deleted)
+{
+    for (std::array<GLuint, TEXTURE_TARGETS> &targets : units)
+    {
+        for (GLuint &bound : targets)
+        {
+            if (bound == deleted)
+                bound = UNKNOWN;
+        }
+    }
+}
+
+void RenderState::forgetFramebuffer(GLuint deleted)
+{
+    if (drawFramebuffer == deleted)
+        drawFramebuffer = UNKNOWN;
+    if (readFramebuffer == deleted)
+        readFramebuffer = UNKNOWN;
+}
+
+int RenderState::targetIndex(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:
+        return 0;
+    case GL_TEXTURE_CUBE_MAP:
+        return 1;
+    case GL_TEXTURE_2D_ARRAY:
+        return 2;
+    case GL_TEXTURE_3D:
+        return 3;
+    default:
+        return -1;
+    }
+}
+
+int RenderState::capabilityIndex(GLenum capability)
+{
+    for (size_t i = 0; i < CAPABILITY_COUNT; i++)
+    {
+        if (TRACKED_CAPABILITIES[i] == capability)
+            return (int)i;
+    }
+    return -1;
+}
+
+void RenderState::beginFrame()
+{
+    // whatever ran between frames (loading, setup) is not part of any frame
+    frame = RenderStateStatistics();
+}
+
+void RenderState::endFrame()
+{
+    for (size_t i = 0; i < (size_t)StateCall::Count; i++)
+    {
+        total.issued[i] += frame.issued[i];
+        total.elided[i] += frame.elided[i];
+    }
+    lastFrame = frame;
+    frames++;
+}
+
+const RenderStateStatistics &RenderState::getFrameStatistics() const
+{
+    return frame;
+}
+
+const RenderStateStatistics &RenderState::getLastFrameStatistics() const
+{
+    return lastFrame;
+}
+
+const RenderStateStatistics &RenderState::getTotalStatistics() const
+{
+    return total;
+}
+
+size_t RenderState::getFrames() const
+{
+    return frames;
+}
+
+void RenderState::resetStatistics()
+{
+    frame = lastFrame = total = RenderStateStatistics();
+    frames = 0;
+}
+
+void RenderState::report(std::ostream &out) const
+{
+    double perFrame = 1.0 / (double)(frames > 0 ? frames : 1);
+    out << std::left << std::setw(16) << "state call" << std::right << std::setw(10) << "issued"
+        << std::setw(10) << "elided" << std::setw(10) << "elided %" << "  (per frame)" << std::endl;
+    out << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < (size_t)StateCall::Count; i++)
+    {
+        size_t calls = total.issued[i] + total.elided[i];
+        out << std::left << std::setw(16) << CALL_NAMES[i] << std::right
+            << std::setw(10) << total.issued[i] * perFrame << std::setw(10) << total.elided[i] * perFrame
+            << std::setw(10) << (calls ? 100.0 * total.elided[i] / calls : 0.0) << std::endl;
+    }
+    size_t calls = total.totalIssued() + total.totalElided();
+    out << std::left << std::setw(16) << "all" << std::right
+        << std::setw(10) << total.totalIssued() * perFrame << std::setw(10) << total.totalElided() * perFrame
+        << std::setw(10) << (calls ? 100.0 * total.totalElided() / calls : 0.0) << std::endl;
+}
@@ -0,0 +1,105 @@
+#ifndef RENDERSTATE_H
+#define RENDERSTATE_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+#include <array>
+#include <vector>
+#include <ostream>
+
+// the kinds of calls RenderState filters
+enum class StateCall
+{
+    Program,       // glUseProgram
+    VertexArray,   // glBindVertexArray
+    ActiveTexture, // glActiveTexture
+    Texture,       // glBindTexture
+    Framebuffer,   // glBindFramebuffer
+    Capability,    // glEnable / glDisable
+    Count
+};
+
+// how many calls of each kind reached the driver and how many were skipped
+struct RenderStateStatistics
+{
+    std::array<size_t, (size_t)StateCall::Count> issued{};
+    std::array<size_t, (size_t)StateCall::Count> elided{};
+
+    size_t totalIssued() const;
+    size_t totalElided() const;
+};
+
+// A shadow of the GL binding state: the current program, vertex array, texture
+// units, framebuffers and enable flags. Every setter compares against the shadow
+// and only calls GL when something actually changes, so Mesh::Draw can bind what
+// it needs without unbinding afterwards and a frame loop can set its state every
+// frame for free.
+// The shadow is only right while every bind goes through here: code that calls
+// glBind*/glUseProgram/glEnable directly has to invalidate() afterwards. After
+// invalidate() (and at start) everything is unknown and the next call always issues.
+// One GL context per process, used from the render thread only.
+class RenderState
+{
+public:
+    static RenderState &shared();
+
+    // forget everything, e.g. after creating a context or after foreign GL code
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    // binds texture on unit, GL_TEXTURE_2D, CUBE_MAP, 2D_ARRAY and 3D are tracked
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    // binds texture on whatever unit is active, for uploads that don't care which
+    void bindTexture(GLenum target, GLuint texture);
+    // GL_FRAMEBUFFER binds both the draw and the read framebuffer
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void setEnabled(GLenum capability, bool enabled);
+
+    // deleting a bound object reverts its binding to 0 behind our back, and the
+    // name may come back from the next glGen*: call these next to glDelete*
+    void forgetProgram(GLuint program);
+    void forgetVertexArray(GLuint vertexArray);
+    void forgetTexture(GLuint texture);
+    void forgetFramebuffer(GLuint framebuffer);
+
+    // count the calls in between per frame
+    void beginFrame();
+    void endFrame();
+    // the calls of the frame so far, of the last ended frame, and of every ended
+    // frame since resetStatistics()
+    const RenderStateStatistics &getFrameStatistics() const;
+    const RenderStateStatistics &getLastFrameStatistics() const;
+    const RenderStateStatistics &getTotalStatistics() const;
+    size_t getFrames() const;
+    void resetStatistics();
+    // issued and elided calls per frame of getTotalStatistics(), by kind
+    void report(std::ostream &out) const;
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    static const size_t TEXTURE_TARGETS = 4;
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint activeUnit;
+    std::vector<std::array<GLuint, TEXTURE_TARGETS>> units;
+    GLuint drawFramebuffer;
+    GLuint readFramebuffer;
+    // -1 unknown, 0 disabled, 1 enabled, by capabilityIndex()
+    std::vector<signed char> capabilities;
+
+    RenderStateStatistics frame;
+    RenderStateStatistics lastFrame;
+    RenderStateStatistics total;
+    size_t frames;
+
+    RenderState();
+    void count(StateCall call, bool issued);
+    void activeTexture(GLuint unit);
+    static int targetIndex(GLenum target);
+    static int capabilityIndex(GLenum capability);
+};
+
+#endif
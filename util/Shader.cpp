@@ -1,5 +1,8 @@
 
 #include "Shader.h"
+#include "RenderState.h"
+
+#include <algorithm>
 
 // constructor generates the shader on the fly
 // ------------------------------------------------------------------------
@@ -53,6 +56,7 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
     glAttachShader(ID, fragment);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    cacheUniformLocations();
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
@@ -61,43 +65,117 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
 // ------------------------------------------------------------------------
 void Shader::use()
 {
-    glUseProgram(ID);
+    RenderState::shared().useProgram(ID);
+}
+// enumerates the active uniforms once, so the setters never call glGetUniformLocation
+// ------------------------------------------------------------------------
+void Shader::cacheUniformLocations()
+{
+    uniformLocations.clear();
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::string name(std::max(maxLength, 1), '\0');
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName(name.data(), length);
+        // uniforms living in a uniform block have no location
+        GLint location = glGetUniformLocation(ID, uniformName.c_str());
+        if (location < 0)
+            continue;
+        uniformLocations[uniformName] = location;
+
+        // arrays are reported as "name[0]", make "name" and every "name[i]" resolvable too
+        size_t bracket = uniformName.rfind("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+        {
+            std::string base = uniformName.substr(0, bracket);
+            uniformLocations[base] = location;
+            for (GLint element = 1; element < size; element++)
+            {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+            }
+        }
+    }
+}
+// returns -1 for unknown (or optimized away) uniforms, which glUniform* silently ignores
+// ------------------------------------------------------------------------
+GLint Shader::getUniformLocation(const std::string &name) const
+{
+    auto found = uniformLocations.find(name);
+    return found != uniformLocations.end() ? found->second : -1;
 }
 // utility uniform functions
 // ------------------------------------------------------------------------
 void Shader::setBool(const std::string &name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    setBool(getUniformLocation(name), value);
 }
 // ------------------------------------------------------------------------
 void Shader::setInt(const std::string &name, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    setInt(getUniformLocation(name), value);
 }
 // ------------------------------------------------------------------------
 void Shader::setFloat(const std::string &name, float value) const
 {
     // std::cout << name << " "<< value  << std::endl;
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    setFloat(getUniformLocation(name), value);
 }
 void Shader::setUniform(const std::string &name, vector3 value) const
 {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), value.r, value.g, value.b, 1.0f);
+    glUniform4f(getUniformLocation(name), value.r, value.g, value.b, 1.0f);
 }
 
 void Shader::setUniformTransformation(const std::string &name, const glm::mat4 transformation)
 {
-    unsigned int transformLoc = glGetUniformLocation(ID, name.c_str());
-    glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transformation));
+    setMat4(getUniformLocation(name), transformation);
 }
 void Shader::setVec3(const std::string &name, const glm::vec3 &value)
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+    setVec3(getUniformLocation(name), value);
 }
 void Shader::setMat4(const std::string &name, const glm::mat4 &value)
 {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1,GL_FALSE,glm::value_ptr(value));
-
+    setMat4(getUniformLocation(name), value);
+}
+// setters for pre-resolved locations
+// ------------------------------------------------------------------------
+void Shader::setBool(GLint location, bool value) const
+{
+    glUniform1i(location, (int)value);
+}
+void Shader::setInt(GLint location, int value) const
+{
+    glUniform1i(location, value);
+}
+void Shader::setFloat(GLint location, float value) const
+{
+    glUniform1f(location, value);
+}
+void Shader::setVec3(GLint location, const glm::vec3 &value) const
+{
+    glUniform3fv(location, 1, glm::value_ptr(value));
+}
+void Shader::setMat4(GLint location, const glm::mat4 &value) const
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+// uniform blocks
+// ------------------------------------------------------------------------
+bool Shader::bindUniformBlock(const std::string &name, GLuint binding) const
+{
+    GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+    if (index == GL_INVALID_INDEX)
+        return false;
+    glUniformBlockBinding(ID, index, binding);
+    return true;
 }
 
 // utility function for checking shader compilation/linking errors.
@@ -5,6 +5,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -36,7 +37,22 @@ public:
     void setUniformTransformation(const std::string &name,const glm::mat4 transformation);
     void setVec3(const std::string &name, const glm::vec3 &value);
     void setMat4(const std::string &name, const glm::mat4 &value);
+    // pre-resolved uniform handles: look the location up once with getUniformLocation
+    // and pass it to the setters below, no string is hashed per call
+    GLint getUniformLocation(const std::string &name) const;
+    void setBool(GLint location, bool value) const;
+    void setInt(GLint location, int value) const;
+    void setFloat(GLint location, float value) const;
+    void setVec3(GLint location, const glm::vec3 &value) const;
+    void setMat4(GLint location, const glm::mat4 &value) const;
+    // ties a uniform block of the program to a binding point, false when the
+    // program has no such block
+    bool bindUniformBlock(const std::string &name, GLuint binding) const;
 private:
+    // name -> location of every active uniform, filled once after linking.
+    // array uniforms are stored both as "name[0]" and "name"
+    std::unordered_map<std::string, GLint> uniformLocations;
+    void cacheUniformLocations();
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type);
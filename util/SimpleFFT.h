@@ -18,6 +18,9 @@
 #include <algorithm>
 #include <cmath>
 #include <complex>
+#include <cstdint>
+#include <memory>
+#include "AudioSimd.h"
 
 
 // M4A/AAC support - using alternative approach without mp4v2
@@ -26,38 +29,199 @@
 #include <map>
 
 
+// Tables for one FFT size: the bit reversal permutation and the n/2 twiddles.
+// Build it once and reuse it for every transform of that size, a transform
+// then does no allocation and no trig, just the in-place iterative butterflies.
+// n must be a power of 2
+template <typename T>
+class FFTPlan {
+public:
+    explicit FFTPlan(size_t n) : n(n) {
+        unsigned int bits = 0;
+        while (((size_t)1 << bits) < n) bits++;
+
+        bitReverse.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            size_t reversed = 0;
+            for (unsigned int b = 0; b < bits; b++) {
+                if (i & ((size_t)1 << b)) reversed |= (size_t)1 << (bits - 1 - b);
+            }
+            bitReverse[i] = (uint32_t)reversed;
+        }
+
+        // the twiddles of every stage stored one after the other, so a stage reads
+        // them contiguously (the stage of half h starts at h - 1, n - 1 in total).
+        // computed in double even for the float plan, so big sizes keep their precision
+        twiddles.resize(n > 1 ? n - 1 : 0);
+        for (size_t half = 1; half < n; half *= 2) {
+            for (size_t k = 0; k < half; k++) {
+                std::complex<double> w = std::polar(1.0, -2.0 * M_PI * (double)k / (double)(2 * half));
+                twiddles[half - 1 + k] = std::complex<T>((T)w.real(), (T)w.imag());
+            }
+        }
+    }
+
+    size_t size() const { return n; }
+
+    static bool isPowerOfTwo(size_t n) { return n != 0 && (n & (n - 1)) == 0; }
+
+    // forward transform of exactly size() values, in place
+    void forward(std::complex<T>* data) const {
+        for (size_t i = 0; i < n; i++) {
+            size_t j = bitReverse[i];
+            if (i < j) std::swap(data[i], data[j]);
+        }
+
+        for (size_t half = 1; half < n; half *= 2) {
+            const std::complex<T>* w = twiddles.data() + half - 1;
+            for (size_t start = 0; start < n; start += 2 * half) {
+                butterflies(data + start, data + start + half, w, half);
+            }
+        }
+    }
+
+    void forward(std::vector<std::complex<T>>& data) const {
+        if (data.size() != n) {
+            std::cerr << "ERROR::FFT:: plan of size " << n << " used on " << data.size() << " values" << std::endl;
+            return;
+        }
+        forward(data.data());
+    }
+
+private:
+    size_t n;
+    std::vector<uint32_t> bitReverse;
+    std::vector<std::complex<T>> twiddles;
+
+    // std::complex operator* checks for inf/nan on every product, do it by hand
+    static void butterflies(std::complex<T>* a, std::complex<T>* b, const std::complex<T>* w, size_t half) {
+        for (size_t k = 0; k < half; k++) {
+            T tr = w[k].real() * b[k].real() - w[k].imag() * b[k].imag();
+            T ti = w[k].real() * b[k].imag() + w[k].imag() * b[k].real();
+            T ur = a[k].real(), ui = a[k].imag();
+            a[k] = std::complex<T>(ur + tr, ui + ti);
+            b[k] = std::complex<T>(ur - tr, ui - ti);
+        }
+    }
+};
+
+// float stages go through the SIMD kernels picked for this CPU (see AudioSimd.h)
+template <>
+inline void FFTPlan<float>::butterflies(std::complex<float>* a, std::complex<float>* b, const std::complex<float>* w, size_t half) {
+    AudioSimd::kernels().butterflies(reinterpret_cast<float*>(a), reinterpret_cast<float*>(b),
+                                     reinterpret_cast<const float*>(w), half);
+}
+
+typedef FFTPlan<float> FFTPlanFloat;
+typedef FFTPlan<double> FFTPlanDouble;
+
+// FFT of n real values through one complex FFT of n/2 points: the even samples
+// go in the real parts and the odd ones in the imaginary parts, then one pass
+// splits the two interleaved spectra and merges them. Half the work of feeding
+// the samples with a zero imaginary part into an FFT of size n.
+// Only the n/2 + 1 bins 0..n/2 are produced, the others are their conjugates.
+// n must be a power of 2
+template <typename T>
+class RealFFTPlan {
+public:
+    explicit RealFFTPlan(size_t n) : n(n), complexPlan(n / 2) {
+        // W_n^k for k < n/2, again computed in double
+        twiddles.resize(n / 2);
+        for (size_t k = 0; k < n / 2; k++) {
+            std::complex<double> w = std::polar(1.0, -2.0 * M_PI * (double)k / (double)n);
+            twiddles[k] = std::complex<T>((T)w.real(), (T)w.imag());
+        }
+    }
+
+    size_t size() const { return n; }
+    size_t bins() const { return n / 2 + 1; }
+
+    // size() real samples in, bins() complex values out, no allocation.
+    // output doubles as the work buffer, so it must not alias input
+    void forward(const T* input, std::complex<T>* output) const {
+        size_t m = n / 2;
+        // z[k] = x[2k] + i x[2k+1] is just the samples read as complex values
+        std::memcpy(static_cast<void*>(output), input, n * sizeof(T));
+        complexPlan.forward(output);
+
+        // X[k] = E[k] + W^k O[k] with E[k] = (Z[k] + conj(Z[m-k])) / 2 and
+        // O[k] = -i (Z[k] - conj(Z[m-k])) / 2, while X[m-k] = conj(E[k] - W^k O[k]),
+        // so k and m - k are done together in place
+        T z0r = output[0].real(), z0i = output[0].imag();
+        output[0] = std::complex<T>(z0r + z0i, 0);
+        output[m] = std::complex<T>(z0r - z0i, 0);
+        for (size_t k = 1; k <= m / 2; k++) {
+            std::complex<T> zk = output[k];
+            std::complex<T> zm = output[m - k];
+            T er = (zk.real() + zm.real()) * (T)0.5;
+            T ei = (zk.imag() - zm.imag()) * (T)0.5;
+            T orr = (zk.imag() + zm.imag()) * (T)0.5;
+            T oi = (zm.real() - zk.real()) * (T)0.5;
+            const std::complex<T>& w = twiddles[k];
+            T tr = w.real() * orr - w.imag() * oi;
+            T ti = w.real() * oi + w.imag() * orr;
+            output[k] = std::complex<T>(er + tr, ei + ti);
+            output[m - k] = std::complex<T>(er - tr, -(ei - ti));
+        }
+    }
+
+    void forward(const std::vector<T>& input, std::vector<std::complex<T>>& output) const {
+        if (input.size() != n) {
+            std::cerr << "ERROR::FFT:: real plan of size " << n << " used on " << input.size() << " values" << std::endl;
+            return;
+        }
+        output.resize(bins());
+        forward(input.data(), output.data());
+    }
+
+private:
+    size_t n;
+    FFTPlan<T> complexPlan;
+    std::vector<std::complex<T>> twiddles;
+};
+
+typedef RealFFTPlan<float> RealFFTPlanFloat;
+typedef RealFFTPlan<double> RealFFTPlanDouble;
+
 // Simple FFT implementation for audio analysis
 class SimpleFFT {
 public:
+    // the plan of the last size asked for on this thread, rebuilt only when the size changes
+    template <typename T>
+    static const FFTPlan<T>& plan(size_t n) {
+        thread_local std::unique_ptr<FFTPlan<T>> cached;
+        if (!cached || cached->size() != n) cached.reset(new FFTPlan<T>(n));
+        return *cached;
+    }
+
+    // same for real input plans
+    template <typename T>
+    static const RealFFTPlan<T>& realPlan(size_t n) {
+        thread_local std::unique_ptr<RealFFTPlan<T>> cached;
+        if (!cached || cached->size() != n) cached.reset(new RealFFTPlan<T>(n));
+        return *cached;
+    }
+
+    // data.size() must be a power of 2
     static void fft(std::vector<std::complex<double>>& data) {
-        int n = data.size();
+        size_t n = data.size();
         if (n <= 1) return;
-        
-        // Divide
-        std::vector<std::complex<double>> even, odd;
-        for (int i = 0; i < n; i++) {
-            if (i % 2 == 0) even.push_back(data[i]);
-            else odd.push_back(data[i]);
-        }
-        
-        // Conquer
-        fft(even);
-        fft(odd);
-        
-        // Combine
-        for (int i = 0; i < n/2; i++) {
-            std::complex<double> t = std::polar(1.0, -2 * M_PI * i / n) * odd[i];
-            data[i] = even[i] + t;
-            data[i + n/2] = even[i] - t;
+        if (!FFTPlanDouble::isPowerOfTwo(n)) {
+            std::cerr << "ERROR::FFT:: size " << n << " is not a power of 2" << std::endl;
+            return;
         }
+        plan<double>(n).forward(data.data());
     }
     
-    static std::vector<double> getMagnitudes(const std::vector<std::complex<double>>& fftData) {
-        std::vector<double> magnitudes;
-        for (const auto& c : fftData) {
-            magnitudes.push_back(std::abs(c));
+    // magnitudes[k] = |fftData[k]| for count values, magnitudes must hold count floats
+    static void getMagnitudes(const std::complex<float>* fftData, size_t count, float* magnitudes) {
+        AudioSimd::kernels().magnitudes(reinterpret_cast<const float*>(fftData), magnitudes, count);
+    }
+
+    static void getMagnitudes(const std::complex<double>* fftData, size_t count, double* magnitudes) {
+        for (size_t k = 0; k < count; k++) {
+            magnitudes[k] = std::sqrt(fftData[k].real() * fftData[k].real() + fftData[k].imag() * fftData[k].imag());
         }
-        return magnitudes;
     }
 };
 #endif
\ No newline at end of file
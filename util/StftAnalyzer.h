@@ -0,0 +1,183 @@
+#ifndef STFTANALYZER_H
+#define STFTANALYZER_H
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include "SimpleFFT.h"
+
+enum class WindowFunction
+{
+    Hann,
+    Blackman
+};
+
+// Short-time Fourier transform over a mono stream. Samples are pushed as they
+// arrive; every hopSize samples the last frameSize samples are windowed and
+// transformed, so an update costs one real FFT of frameSize whatever the time
+// between updates. The sliding frame is a ring that overlaps the previous one by
+// frameSize - hopSize samples, and the RMS and peak of the frame are kept per hop,
+// so only the new hop is ever read.
+// frameSize must be a power of 2, hopSize at most frameSize
+class StftAnalyzer
+{
+public:
+    explicit StftAnalyzer(size_t frameSize = 2048, size_t hopSize = 512, WindowFunction window = WindowFunction::Hann)
+    {
+        configure(frameSize, hopSize, window);
+    }
+
+    // hop for updatesPerSecond frames per second, e.g. 60 to 240 for video frame rates
+    static size_t hopForRate(int sampleRate, double updatesPerSecond)
+    {
+        return std::max((size_t)1, (size_t)(sampleRate / updatesPerSecond));
+    }
+
+    // allocates everything, the push path never does
+    void configure(size_t newFrameSize, size_t newHopSize, WindowFunction newWindow)
+    {
+        frameSize = newFrameSize;
+        hopSize = std::min(std::max((size_t)1, newHopSize), frameSize);
+        windowFunction = newWindow;
+        plan.reset(new RealFFTPlanFloat(frameSize));
+
+        window.resize(frameSize);
+        double sum = 0.0;
+        for (size_t i = 0; i < frameSize; i++)
+        {
+            // periodic windows, they overlap-add to a constant at the usual hops
+            double phase = 2.0 * M_PI * (double)i / (double)frameSize;
+            double value = windowFunction == WindowFunction::Hann
+                               ? 0.5 - 0.5 * std::cos(phase)
+                               : 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+            window[i] = (float)value;
+            sum += value;
+        }
+        // a sine of amplitude A reads as A in its bin whatever the window and frame size
+        magnitudeScale = (float)(2.0 / sum);
+
+        ring.assign(frameSize, 0.0f);
+        frameInput.assign(frameSize, 0.0f);
+        bins.assign(plan->bins(), std::complex<float>());
+        spectrum.assign(plan->bins(), 0.0f);
+        hopCount = (frameSize + hopSize - 1) / hopSize;
+        hopEnergy.assign(hopCount, 0.0);
+        hopPeak.assign(hopCount, 0.0f);
+        reset();
+    }
+
+    // forget the signal, e.g. after a seek
+    void reset()
+    {
+        std::fill(ring.begin(), ring.end(), 0.0f);
+        std::fill(spectrum.begin(), spectrum.end(), 0.0f);
+        std::fill(hopEnergy.begin(), hopEnergy.end(), 0.0);
+        std::fill(hopPeak.begin(), hopPeak.end(), 0.0f);
+        writePosition = 0;
+        pendingInHop = 0;
+        currentEnergy = 0.0;
+        currentPeak = 0.0f;
+        hopSlot = 0;
+        frameEnergy = 0.0;
+        framePeak = 0.0f;
+        frames = 0;
+    }
+
+    // feeds count samples and calls onFrame(*this) after every frame they complete
+    template <typename OnFrame>
+    void push(const float *samples, size_t count, OnFrame onFrame)
+    {
+        while (count > 0)
+        {
+            size_t take = std::min(count, hopSize - pendingInHop);
+            size_t first = std::min(take, frameSize - writePosition);
+            std::memcpy(ring.data() + writePosition, samples, first * sizeof(float));
+            std::memcpy(ring.data(), samples + first, (take - first) * sizeof(float));
+            AudioSimd::kernels().levels(samples, take, &currentEnergy, &currentPeak);
+            writePosition = (writePosition + take) % frameSize;
+            pendingInHop += take;
+            samples += take;
+            count -= take;
+
+            if (pendingInHop == hopSize)
+            {
+                finishHop();
+                onFrame(*this);
+            }
+        }
+    }
+
+    void push(const float *samples, size_t count)
+    {
+        push(samples, count, [](const StftAnalyzer &) {});
+    }
+
+    // magnitudes of the latest frame, bins 0..frameSize/2, amplitude scaled
+    const std::vector<float> &getMagnitudes() const { return spectrum; }
+    // of the last frameSize samples (rounded up to whole hops)
+    float getRMS() const { return (float)std::sqrt(std::max(0.0, frameEnergy) / (double)(hopCount * hopSize)); }
+    float getPeak() const { return framePeak; }
+
+    size_t getFrameSize() const { return frameSize; }
+    size_t getHopSize() const { return hopSize; }
+    WindowFunction getWindow() const { return windowFunction; }
+    // frames produced since the last reset
+    unsigned long long getFrameCount() const { return frames; }
+
+private:
+    size_t frameSize = 0;
+    size_t hopSize = 0;
+    WindowFunction windowFunction = WindowFunction::Hann;
+    std::unique_ptr<RealFFTPlanFloat> plan;
+    AudioSimd::AlignedVector<float> window;
+    float magnitudeScale = 1.0f;
+
+    // the last frameSize samples, the oldest at writePosition
+    AudioSimd::AlignedVector<float> ring;
+    size_t writePosition = 0;
+    size_t pendingInHop = 0;
+
+    AudioSimd::AlignedVector<float> frameInput;
+    std::vector<std::complex<float>> bins;
+    std::vector<float> spectrum;
+
+    // sum of squares and peak of the hops the frame spans, replaced one hop at a time
+    size_t hopCount = 0;
+    std::vector<double> hopEnergy;
+    std::vector<float> hopPeak;
+    size_t hopSlot = 0;
+    double currentEnergy = 0.0;
+    float currentPeak = 0.0f;
+    double frameEnergy = 0.0;
+    float framePeak = 0.0f;
+    unsigned long long frames = 0;
+
+    void finishHop()
+    {
+        frameEnergy += currentEnergy - hopEnergy[hopSlot];
+        hopEnergy[hopSlot] = currentEnergy;
+        hopPeak[hopSlot] = currentPeak;
+        hopSlot = (hopSlot + 1) % hopCount;
+        framePeak = *std::max_element(hopPeak.begin(), hopPeak.end());
+        currentEnergy = 0.0;
+        currentPeak = 0.0f;
+        pendingInHop = 0;
+
+        // unroll the ring oldest first while windowing it
+        size_t tail = frameSize - writePosition;
+        const AudioKernels &kernels = AudioSimd::kernels();
+        kernels.multiply(ring.data() + writePosition, window.data(), frameInput.data(), tail);
+        kernels.multiply(ring.data(), window.data() + tail, frameInput.data() + tail, writePosition);
+
+        plan->forward(frameInput.data(), bins.data());
+        SimpleFFT::getMagnitudes(bins.data(), bins.size(), spectrum.data());
+        for (float &magnitude : spectrum)
+            magnitude *= magnitudeScale;
+        frames++;
+    }
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "TextureLoader.h"
+#include "RenderState.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../util/stb_image.h"
@@ -8,7 +9,7 @@ TextureLoader::TextureLoader(const char *name, const unsigned int ntexture)
     numtexture = ntexture;
     glGenTextures(1, &ID);
     // bind the texture with the GLTEXTURE
-    glBindTexture(GL_TEXTURE_2D, ID);
+    RenderState::shared().bindTexture(GL_TEXTURE_2D, ID);
     // set the texture wrapping/filtering options (on currently bound texture)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -35,8 +36,7 @@ TextureLoader::~TextureLoader() {}
 
 void TextureLoader::use()
 {
-    glActiveTexture(GL_TEXTURE0 + numtexture);
-    glBindTexture(GL_TEXTURE_2D, ID);
+    RenderState::shared().bindTexture(numtexture, GL_TEXTURE_2D, ID);
 }
 
 // utility function for loading a 2D texture from file
@@ -58,7 +58,7 @@ unsigned int TextureLoader::loadTexture(char const * path)
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        RenderState::shared().bindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
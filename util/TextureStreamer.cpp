@@ -0,0 +1,126 @@
+#include "TextureStreamer.h"
+#include "RenderState.h"
+
+#include <chrono>
+#include <thread>
+#include "stb_image.h"
+
+TextureStreamer::TextureStreamer() : pending(0)
+{
+}
+
+TextureStreamer &TextureStreamer::shared()
+{
+    // never destroyed: decode tasks still queued on the shared pool at exit
+    // keep pointing at it whatever the static destruction order is
+    static TextureStreamer *streamer = new TextureStreamer();
+    return *streamer;
+}
+
+size_t TextureStreamer::pendingCount() const
+{
+    return pending.load();
+}
+
+// a 1x1 mid grey texture, neutral enough for diffuse and specular maps
+unsigned int TextureStreamer::createPlaceholder()
+{
+    static const unsigned char grey[4] = {128, 128, 128, 255};
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    RenderState::shared().bindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+unsigned int TextureStreamer::request(const std::string &filename)
+{
+    unsigned int textureID = createPlaceholder();
+    pending++;
+
+    // decode on a worker, the result waits in the completed queue for update()
+    ThreadPool::shared().submit([this, textureID, filename]
+                                {
+        DecodedImage image;
+        image.textureID = textureID;
+        image.filename = filename;
+        image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+
+        std::lock_guard<std::mutex> lock(completedMutex);
+        completed.push_back(image); });
+
+    return textureID;
+}
+
+unsigned int TextureStreamer::update(double budgetMs)
+{
+    auto start = std::chrono::steady_clock::now();
+    unsigned int uploaded = 0;
+
+    while (true)
+    {
+        DecodedImage image;
+        {
+            std::lock_guard<std::mutex> lock(completedMutex);
+            if (completed.empty())
+                break;
+            image = completed.front();
+            completed.pop_front();
+        }
+
+        upload(image);
+        uploaded++;
+        pending--;
+
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= budgetMs)
+            break;
+    }
+    return uploaded;
+}
+
+void TextureStreamer::finish()
+{
+    while (pending.load() > 0)
+    {
+        if (update(1e9) == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void TextureStreamer::upload(DecodedImage &image)
+{
+    if (!image.data)
+    {
+        // keep the placeholder, the texture name stays valid
+        std::cout << "Texture failed to load at path: " << image.filename << std::endl;
+        return;
+    }
+
+    GLenum format = GL_RGB;
+    if (image.components == 1)
+        format = GL_RED;
+    else if (image.components == 3)
+        format = GL_RGB;
+    else if (image.components == 4)
+        format = GL_RGBA;
+
+    // rows of RED/RGB images are not always 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    RenderState::shared().bindTexture(GL_TEXTURE_2D, image.textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    stbi_image_free(image.data);
+}
@@ -0,0 +1,54 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+#include <string>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+
+#include "ThreadPool.h"
+
+// Loads 2D textures without stalling the render loop.
+// request() hands back a GL texture name at once, bound to a 1x1 grey placeholder,
+// while stbi_load runs on the worker threads. The decoded images are uploaded into
+// that same texture name by update(), on the GL thread and under a time budget, so
+// whoever stored the name (a Mesh, a Shader sampler...) gets the real image for free.
+class TextureStreamer
+{
+public:
+    static TextureStreamer &shared();
+
+    // returns the GL texture name that will hold the image at filename
+    unsigned int request(const std::string &filename);
+    // uploads finished decodes until budgetMs is spent (always at least one),
+    // call it once per frame from the thread owning the GL context.
+    // returns the number of textures uploaded
+    unsigned int update(double budgetMs = 2.0);
+    // blocks until every requested texture has been uploaded
+    void finish();
+    // textures requested but not uploaded yet
+    size_t pendingCount() const;
+
+private:
+    struct DecodedImage
+    {
+        unsigned int textureID;
+        std::string filename;
+        unsigned char *data;
+        int width;
+        int height;
+        int components;
+    };
+
+    std::mutex completedMutex;
+    std::deque<DecodedImage> completed;
+    std::atomic<size_t> pending;
+
+    TextureStreamer();
+    void upload(DecodedImage &image);
+    static unsigned int createPlaceholder();
+};
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <exception>
+
+// Fixed size pool of worker threads for CPU only work (no GL calls in here!
+// the GL context belongs to the thread that created the window).
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable condition;
+    bool stopping;
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                condition.wait(lock, [this]
+                               { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+    // 0 threads means one per hardware core
+    explicit ThreadPool(unsigned int threadCount = 0) : stopping(false)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this]
+                                 { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned int size() const
+    {
+        return (unsigned int)workers.size();
+    }
+
+    // queues a task and returns a future with its result
+    template <typename F>
+    auto submit(F &&function) -> std::future<decltype(function())>
+    {
+        using Result = decltype(function());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.emplace([task]
+                          { (*task)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+    // runs body(i) for every i in [0, count) across the pool and waits for all of them.
+    // the calling thread helps too, so this is safe to call with a busy pool
+    template <typename F>
+    void parallelFor(size_t count, F body)
+    {
+        if (count == 0)
+            return;
+        std::atomic<size_t> next(0);
+        auto drain = [&]
+        {
+            for (size_t i = next++; i < count; i = next++)
+                body(i);
+        };
+
+        size_t helpers = std::min(count - 1, (size_t)workers.size());
+        std::vector<std::future<void>> pending;
+        pending.reserve(helpers);
+        for (size_t i = 0; i < helpers; i++)
+            pending.push_back(submit(drain));
+
+        // the helpers use next and body from this frame, so every one of them has to
+        // finish before an exception (from here or from a helper) may leave it
+        std::exception_ptr error;
+        try
+        {
+            drain();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+            next = count; // nothing new gets picked up
+        }
+        for (std::future<void> &done : pending)
+            done.wait();
+        if (error)
+            std::rethrow_exception(error);
+        for (std::future<void> &done : pending)
+            done.get();
+    }
+
+    // process wide pool, created on first use
+    static ThreadPool &shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+};
+
+#endif
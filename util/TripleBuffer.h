@@ -0,0 +1,55 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Lock-free hand over of the latest value from one producer thread to one consumer
+// thread. Each side owns one of three slots and the third is parked in between:
+// publishing swaps the producer's slot with the parked one, reading swaps the
+// consumer's slot with it if it holds something newer. Neither side ever waits, and
+// values the consumer was too slow to see are simply overwritten.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : backIndex(0), frontIndex(1), parked(2) {}
+
+    // producer: write the next value here, then publish()
+    T &back()
+    {
+        return slots[backIndex];
+    }
+
+    void publish()
+    {
+        unsigned int previous = parked.exchange(backIndex | FRESH, std::memory_order_acq_rel);
+        backIndex = previous & INDEX;
+    }
+
+    // consumer: takes the newest published value if there is one, true if front() changed
+    bool update()
+    {
+        if (!(parked.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        unsigned int previous = parked.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & INDEX;
+        return true;
+    }
+
+    const T &front() const
+    {
+        return slots[frontIndex];
+    }
+
+private:
+    static const unsigned int INDEX = 3;
+    static const unsigned int FRESH = 4;
+
+    T slots[3];
+    // each side on its own cache line, so they do not slow each other down
+    alignas(64) unsigned int backIndex;
+    alignas(64) unsigned int frontIndex;
+    alignas(64) std::atomic<unsigned int> parked;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef UNIFORMBLOCKS_H
+#define UNIFORMBLOCKS_H
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "Shader.h"
+#include "Material.h"
+
+// binding points of the std140 uniform blocks declared by Shaders/material_*.
+// GLSL 3.30 can't say layout(binding = n), bindUniformBlocks() sets them per program
+#define FRAME_BLOCK_BINDING 0
+#define LIGHT_BLOCK_BINDING 1
+#define MATERIAL_BLOCK_BINDING 2
+
+// The C++ side of the blocks, laid out by the std140 rules: a vec3 takes 16 bytes
+// unless a float follows to fill its last 4, structs round up to 16 bytes.
+// Every block is written with one memcpy (see UniformRing)
+
+// layout(std140) uniform FrameBlock
+struct FrameBlock
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float padding;
+
+    FrameBlock(const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &viewPos)
+        : projection(projection), view(view), viewPos(viewPos), padding(0.0f) {}
+};
+
+// layout(std140) uniform LightBlock { SpotLight spotLight; }
+struct SpotLightBlock
+{
+    glm::vec3 position;
+    float padding0 = 0.0f;
+    glm::vec3 direction;
+    float padding1 = 0.0f;
+    glm::vec3 ambient;
+    float padding2 = 0.0f;
+    glm::vec3 diffuse;
+    float padding3 = 0.0f;
+    glm::vec3 specular;
+    float cutOff = 1.0f;      // cosine of the inner cone angle
+    float outerCutOff = 1.0f; // cosine of the outer cone angle
+    float constant = 1.0f;
+    float linear = 0.0f;
+    float quadratic = 0.0f;
+};
+
+// layout(std140) uniform MaterialBlock { Material material; }
+struct MaterialBlock
+{
+    glm::vec3 ambient;
+    float padding0;
+    glm::vec3 diffuse;
+    float padding1;
+    glm::vec3 specular;
+    float shininess;
+
+    explicit MaterialBlock(const Material &material)
+        : ambient(material.ambient), padding0(0.0f), diffuse(material.diffuse), padding1(0.0f),
+          specular(material.specular), shininess(material.shininess) {}
+};
+
+static_assert(sizeof(FrameBlock) == 144, "FrameBlock does not match the std140 layout");
+static_assert(sizeof(SpotLightBlock) == 96, "SpotLightBlock does not match the std140 layout");
+static_assert(sizeof(MaterialBlock) == 48, "MaterialBlock does not match the std140 layout");
+
+// points the blocks a program declares at their binding points, the ones it
+// doesn't declare are skipped
+inline void bindUniformBlocks(Shader &shader)
+{
+    shader.bindUniformBlock("FrameBlock", FRAME_BLOCK_BINDING);
+    shader.bindUniformBlock("LightBlock", LIGHT_BLOCK_BINDING);
+    shader.bindUniformBlock("MaterialBlock", MATERIAL_BLOCK_BINDING);
+}
+
+#endif
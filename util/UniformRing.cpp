@@ -0,0 +1,168 @@
+#include "UniformRing.h"
+#include "RenderContext.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+typedef void(APIENTRY *BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+namespace
+{
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+// std::min takes it by reference, so it needs a definition
+const unsigned int UniformRing::MAX_FRAMES;
+
+UniformRing::UniformRing(size_t frameBytes, unsigned int frames)
+    : buffer(0), mapped(nullptr), frames(std::min(std::max(frames, 1u), MAX_FRAMES)), current(0), used(0),
+      stalls(0), fullWarned(false)
+{
+    for (GLsync &fence : fences)
+        fence = nullptr;
+
+    GLint offsetAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    alignment = (size_t)std::max(offsetAlignment, 1);
+    // every region starts aligned too
+    this->frameBytes = alignUp(std::max(frameBytes, alignment), alignment);
+    size_t totalBytes = this->frameBytes * this->frames;
+
+    // ARB_buffer_storage is a core extension, its entry point has no suffix
+    BufferStorageProc bufferStorage = nullptr;
+    if (RenderContext::isVersionAtLeast(4, 4) || RenderContext::hasExtension("GL_ARB_buffer_storage"))
+        bufferStorage = reinterpret_cast<BufferStorageProc>(RenderContext::getProcAddress("glBufferStorage"));
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    if (bufferStorage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        bufferStorage(GL_UNIFORM_BUFFER, totalBytes, NULL, flags);
+        mapped = static_cast<unsigned char *>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, totalBytes, flags));
+        if (!mapped)
+            std::cout << "Warning: could not map the uniform ring persistently, mapping per write" << std::endl;
+    }
+    else
+    {
+        glBufferData(GL_UNIFORM_BUFFER, totalBytes, NULL, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+UniformRing::~UniformRing()
+{
+    deleteBuffers();
+}
+
+void UniformRing::deleteBuffers()
+{
+    for (GLsync &fence : fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (buffer == 0)
+        return;
+    if (mapped)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        mapped = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void UniformRing::beginFrame()
+{
+    current = (current + 1) % frames;
+    used = 0;
+
+    GLsync &fence = fences[current];
+    if (!fence)
+        return;
+    // frames - 1 frames of work are queued after it, normally it has long passed
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        stalls++;
+        do
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        while (result == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void UniformRing::endFrame()
+{
+    GLsync &fence = fences[current];
+    if (fence)
+        glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr UniformRing::write(const void *data, size_t bytes)
+{
+    size_t offset = alignUp(used, alignment);
+    if (offset + bytes > frameBytes)
+    {
+        if (!fullWarned)
+            std::cout << "ERROR::UNIFORM_RING:: the " << frameBytes << " bytes of a frame are full" << std::endl;
+        fullWarned = true;
+        return -1;
+    }
+    used = offset + bytes;
+    offset += (size_t)current * frameBytes;
+
+    if (mapped)
+    {
+        std::memcpy(mapped + offset, data, bytes);
+    }
+    else
+    {
+        // the fence of beginFrame already made sure nothing reads this range
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        void *range = glMapBufferRange(GL_UNIFORM_BUFFER, offset, bytes,
+                                       GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (range)
+        {
+            std::memcpy(range, data, bytes);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    return (GLintptr)offset;
+}
+
+void UniformRing::bindRange(GLuint binding, GLintptr offset, size_t bytes)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, bytes);
+}
+
+bool UniformRing::isPersistent() const
+{
+    return mapped != nullptr;
+}
+
+GLuint UniformRing::getBuffer() const
+{
+    return buffer;
+}
+
+size_t UniformRing::getFrameBytes() const
+{
+    return frameBytes;
+}
+
+size_t UniformRing::getStalls() const
+{
+    return stalls;
+}
@@ -0,0 +1,81 @@
+#ifndef UNIFORMRING_H
+#define UNIFORMRING_H
+
+#include <glad/glad.h> // include glad to get the required OpenGL headers
+#include <cstddef>
+
+// the GL 4.4 buffer storage flags, glad is generated for 3.3
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// One uniform buffer cut into a region per frame in flight (3 by default). A frame
+// copies its blocks into its own region, each with a single memcpy, and binds them
+// with glBindBufferRange; the region is only written again once the fence placed
+// by endFrame() says the GPU is done reading it, so no write ever waits for a draw.
+// With GL 4.4 or ARB_buffer_storage the buffer is mapped once, persistently and
+// coherently, for its whole life. Without it every write maps its range with
+// GL_MAP_UNSYNCHRONIZED_BIT, the fences keep that safe all the same.
+// GL thread only.
+class UniformRing
+{
+public:
+    // frameBytes is what one frame may write, offset alignment included
+    explicit UniformRing(size_t frameBytes = 64 * 1024, unsigned int frames = 3);
+    ~UniformRing();
+    // deletes the fences and the buffer while the context is still there, the
+    // destructor only does it when this wasn't called. nothing else works after it
+    void deleteBuffers();
+
+    UniformRing(const UniformRing &) = delete;
+    UniformRing &operator=(const UniformRing &) = delete;
+
+    // moves to the next region, waiting for the GPU if it still reads it
+    void beginFrame();
+    // fences the region of the frame, after its last draw
+    void endFrame();
+
+    // copies a block into the frame's region, returns its offset in the buffer,
+    // -1 when the region is full
+    GLintptr write(const void *data, size_t bytes);
+    template <typename T>
+    GLintptr write(const T &block)
+    {
+        return write(&block, sizeof(T));
+    }
+    // binds bytes at offset (from write) to a uniform block binding point
+    void bindRange(GLuint binding, GLintptr offset, size_t bytes);
+    // write and bind in one go
+    template <typename T>
+    void bind(GLuint binding, const T &block)
+    {
+        GLintptr offset = write(block);
+        if (offset >= 0)
+            bindRange(binding, offset, sizeof(T));
+    }
+
+    bool isPersistent() const;
+    GLuint getBuffer() const;
+    size_t getFrameBytes() const;
+    // frames beginFrame() had to wait for the GPU
+    size_t getStalls() const;
+
+private:
+    static const unsigned int MAX_FRAMES = 8;
+
+    GLuint buffer;
+    unsigned char *mapped; // the whole buffer, nullptr when not persistent
+    size_t frameBytes;
+    unsigned int frames;
+    size_t alignment;
+    unsigned int current;
+    size_t used; // bytes written into the current region
+    GLsync fences[MAX_FRAMES];
+    size_t stalls;
+    bool fullWarned;
+};
+
+#endif
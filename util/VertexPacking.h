@@ -0,0 +1,85 @@
+#ifndef VERTEXPACKING_H
+#define VERTEXPACKING_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+// Helpers to quantize vertex attributes for the compact vertex layout.
+// The matching GLSL decoders live in Shaders/material_vertex_compact.vs
+namespace VertexPacking
+{
+    // IEEE 754 binary16, round to nearest even, overflow goes to infinity
+    inline uint16_t packHalf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        int32_t exponent = (int32_t)((bits >> 23) & 0xffu) - 127 + 15;
+        uint32_t mantissa = bits & 0x7fffffu;
+
+        if (((bits >> 23) & 0xffu) == 0xffu) // inf or NaN
+            return (uint16_t)(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+        if (exponent >= 31)
+            return (uint16_t)(sign | 0x7c00u);
+        if (exponent <= 0)
+        {
+            // subnormal half (or zero)
+            if (exponent < -10)
+                return (uint16_t)sign;
+            mantissa |= 0x800000u;
+            uint32_t shift = (uint32_t)(14 - exponent);
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1u);
+            uint32_t halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half & 1u)))
+                half++;
+            return (uint16_t)(sign | half);
+        }
+
+        uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1fffu;
+        if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+            half++; // may carry into the exponent, which is still correct
+        return (uint16_t)half;
+    }
+
+    // [-1, 1] -> signed normalized 16 bit
+    inline int16_t packSnorm16(float value)
+    {
+        return (int16_t)std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+    }
+
+    // [0, 1] -> unsigned normalized 8 bit
+    inline uint8_t packUnorm8(float value)
+    {
+        return (uint8_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+    }
+
+    // unit vector -> point on the octahedron unfolded over the [-1, 1] square
+    inline glm::vec2 octahedralEncode(glm::vec3 n)
+    {
+        float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+        if (sum == 0.0f)
+            return glm::vec2(0.0f, 0.0f);
+        n /= sum;
+        if (n.z < 0.0f)
+        {
+            float x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+            float y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+            return glm::vec2(x, y);
+        }
+        return glm::vec2(n.x, n.y);
+    }
+
+    inline void packOctahedral(const glm::vec3 &n, int16_t out[2])
+    {
+        glm::vec2 encoded = octahedralEncode(n);
+        out[0] = packSnorm16(encoded.x);
+        out[1] = packSnorm16(encoded.y);
+    }
+}
+
+#endif